@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+"""Build a filesystem image from a directory of files.
+
+Takes the same options as the createfs binary. The image is written in the
+original format when everything fits in it: at most 63 directory entries and
+no file over 1023 blocks (about 4MB). Otherwise, or with --format 2, it is
+written in the extended format of FileSystem.h, which adds indirect blocks to
+the inodes and continues the directory in a chain of directory blocks.
+"""
+
+import getopt
+import os
+import struct
+import sys
+import time
+
+BLOCK_SIZE = 4096
+NAME_LEN = 32
+DENTRIES_PER_BLOCK = 63
+DIRECT_V1 = 1023
+DIRECT_V2 = 1021
+PTRS_PER_BLOCK = BLOCK_SIZE // 4
+MAX_BLOCKS_V2 = DIRECT_V2 + PTRS_PER_BLOCK + PTRS_PER_BLOCK * PTRS_PER_BLOCK
+MIN_INODES = 64
+KERNEL_MAX_INODES = 256     # FS_MAX_INODES, the most a kernel mounts from disk
+FS_MAGIC = 0x46313933
+FS_VERSION = 2
+FS_NO_BLOCK = 0xFFFFFFFF
+
+TYPE_RTC = 0        # device file, the inode picks it: 0 rtc, 1 serial port
+TYPE_DIR = 1
+TYPE_FILE = 2
+TYPE_PROC = 3       # kernel statistics file, the inode number picks the report
+
+# entries every image starts with
+SPECIAL = [(b".", TYPE_DIR, 0), (b"rtc", TYPE_RTC, 0), (b"serial", TYPE_RTC, 1),
+           (b"syscalls", TYPE_PROC, 0), (b"trace", TYPE_PROC, 1), (b"profile", TYPE_PROC, 2),
+           (b"sched", TYPE_PROC, 3), (b"irqstat", TYPE_PROC, 4)]
+
+
+def usage(out):
+    out.write("usage: createfs -i <input directory> -o <output image> [--format 1|2]\n"
+              "  -h, --help         show this message\n"
+              "  -i, --input DIR    directory holding the files\n"
+              "  -o, --output FILE  image to write\n"
+              "  -f, --format N     1 for the original format, 2 for the extended one;\n"
+              "                     by default the original one when everything fits\n")
+
+
+def blocks_of(length):
+    return (length + BLOCK_SIZE - 1) // BLOCK_SIZE
+
+
+def dentry(name, filetype, inode):
+    return name[:NAME_LEN].ljust(NAME_LEN, b"\0") + struct.pack("<II", filetype, inode) + b"\0" * 24
+
+
+def read_files(indir):
+    files = []
+    for name in sorted(os.listdir(indir)):
+        path = os.path.join(indir, name)
+        if not os.path.isfile(path):
+            continue
+        with open(path, "rb") as f:
+            files.append((name.encode()[:NAME_LEN], f.read()))   # longer names are cut, not NUL terminated
+    stamp = time.strftime("%Y-%m-%d, %H:%M:%S\n").encode()
+    files.append((b"created.txt", stamp))
+    return files
+
+
+def build(files, version):
+    num_inodes = (len(files) // MIN_INODES + 1) * MIN_INODES     # leave inodes for files the kernel creates
+    entries = [dentry(name, filetype, inode) for name, filetype, inode in SPECIAL]
+    data = []           # data blocks, in order
+    inodes = []
+    for inode, (name, contents) in enumerate(files):
+        entries.append(dentry(name, TYPE_FILE, inode))
+        nblocks = blocks_of(len(contents))
+        first = len(data)
+        for b in range(nblocks):
+            data.append(contents[b * BLOCK_SIZE:(b + 1) * BLOCK_SIZE].ljust(BLOCK_SIZE, b"\0"))
+        ptrs = list(range(first, first + nblocks))
+        slots = ptrs[:DIRECT_V2 if version == 2 else DIRECT_V1]
+        if version == 2 and nblocks > DIRECT_V2:
+            # indirect blocks follow the data of the file, which stays one run on disk
+            slots += [0] * (DIRECT_V2 - len(slots))
+            rest = ptrs[DIRECT_V2:]
+            single, rest = rest[:PTRS_PER_BLOCK], rest[PTRS_PER_BLOCK:]
+            slots.append(len(data))
+            data.append(struct.pack("<%dI" % len(single), *single).ljust(BLOCK_SIZE, b"\0"))
+            if rest:
+                tables = []
+                for t in range(0, len(rest), PTRS_PER_BLOCK):
+                    chunk = rest[t:t + PTRS_PER_BLOCK]
+                    tables.append(len(data))
+                    data.append(struct.pack("<%dI" % len(chunk), *chunk).ljust(BLOCK_SIZE, b"\0"))
+                slots.append(len(data))
+                data.append(struct.pack("<%dI" % len(tables), *tables).ljust(BLOCK_SIZE, b"\0"))
+        inodes.append(struct.pack("<I", len(contents)) + b"".join(struct.pack("<I", p) for p in slots))
+
+    # entries past the boot block go in a chain of directory blocks after the file data
+    dir_block = FS_NO_BLOCK
+    chain = [entries[i:i + DENTRIES_PER_BLOCK]
+             for i in range(DENTRIES_PER_BLOCK, len(entries), DENTRIES_PER_BLOCK)]
+    if chain:
+        dir_block = len(data)
+    for i, chunk in enumerate(chain):
+        nxt = len(data) + 1 if i + 1 < len(chain) else FS_NO_BLOCK
+        data.append((struct.pack("<I", nxt) + b"\0" * 60 + b"".join(chunk)).ljust(BLOCK_SIZE, b"\0"))
+
+    if version == 2:
+        boot = struct.pack("<IIIIII", len(entries), num_inodes, len(data), FS_MAGIC, FS_VERSION, dir_block)
+    else:
+        boot = struct.pack("<III", len(entries), num_inodes, len(data))
+    boot = boot.ljust(64, b"\0") + b"".join(entries[:DENTRIES_PER_BLOCK])
+    image = [boot.ljust(BLOCK_SIZE, b"\0")]
+    image += [node.ljust(BLOCK_SIZE, b"\0") for node in inodes]
+    image += [b"\0" * BLOCK_SIZE] * (num_inodes - len(inodes))
+    return b"".join(image + data), num_inodes
+
+
+def main(argv):
+    indir = outfile = None
+    version = 0
+    try:
+        opts, args = getopt.getopt(argv, "hi:o:f:", ["help", "input=", "output=", "format="])
+    except getopt.GetoptError as err:
+        sys.stderr.write("createfs: %s\n" % err)
+        usage(sys.stderr)
+        return 2
+    for opt, val in opts:
+        if opt in ("-h", "--help"):
+            usage(sys.stdout)
+            return 0
+        elif opt in ("-i", "--input"):
+            indir = val
+        elif opt in ("-o", "--output"):
+            outfile = val
+        elif opt in ("-f", "--format"):
+            if val not in ("1", "2"):
+                sys.stderr.write("createfs: unknown format %s\n" % val)
+                return 2
+            version = int(val)
+    if indir is None or outfile is None or args:
+        usage(sys.stderr)
+        return 2
+
+    files = read_files(indir)
+    largest = max(blocks_of(len(contents)) for _, contents in files)
+    fits_v1 = len(files) + len(SPECIAL) <= DENTRIES_PER_BLOCK and largest <= DIRECT_V1
+    if version == 0:
+        version = 1 if fits_v1 else 2
+    if version == 1 and not fits_v1:
+        sys.stderr.write("createfs: the original format holds %d entries and files up to %d bytes\n"
+                         % (DENTRIES_PER_BLOCK, DIRECT_V1 * BLOCK_SIZE))
+        return 1
+    if largest > MAX_BLOCKS_V2:
+        sys.stderr.write("createfs: a file is larger than %d bytes\n" % (MAX_BLOCKS_V2 * BLOCK_SIZE))
+        return 1
+
+    image, num_inodes = build(files, version)
+    if num_inodes > KERNEL_MAX_INODES:
+        sys.stderr.write("createfs: warning, %d inodes is more than a kernel mounts from disk\n" % num_inodes)
+    with open(outfile, "wb") as f:
+        f.write(image)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Turn a user program into the file the kernel loads.
+
+Does what the elfconvert binary does, for hosts that cannot run it. The kernel
+copies a program file as it is to 0x08048000 and jumps to the entry point in
+its ELF header, so every loadable segment is written at its virtual address
+less 0x08048000, with its bss as zeros. The first segment starts at file
+offset 0 and brings the ELF header along. The result is <exename>.converted.
+"""
+
+import struct
+import sys
+
+LOAD_BASE = 0x08048000
+PT_LOAD = 1
+ELF_MAGIC = b"\x7fELF"
+ELFCLASS32 = 1
+ELFDATA2LSB = 1
+EM_386 = 3
+
+
+def usage(out):
+    out.write("Usage: elfconvert <exename>\n")
+
+
+def convert(exe):
+    if exe[:4] != ELF_MAGIC:
+        return None, "is not an ELF file."
+    if exe[4] != ELFCLASS32 or exe[5] != ELFDATA2LSB or struct.unpack_from("<H", exe, 18)[0] != EM_386:
+        return None, "is not a compatible ELF file."
+    phoff, = struct.unpack_from("<I", exe, 28)
+    phentsize, phnum = struct.unpack_from("<HH", exe, 42)
+    image = bytearray()
+    for i in range(phnum):
+        p_type, p_offset, p_vaddr, _, p_filesz, p_memsz = struct.unpack_from("<6I", exe, phoff + i * phentsize)
+        if p_type != PT_LOAD:
+            continue
+        if p_vaddr < LOAD_BASE:
+            return None, "has a segment below 0x%08x." % LOAD_BASE
+        segment = exe[p_offset:p_offset + p_filesz].ljust(p_memsz, b"\0")
+        start = p_vaddr - LOAD_BASE
+        if len(image) < start + len(segment):
+            image.extend(b"\0" * (start + len(segment) - len(image)))
+        image[start:start + len(segment)] = segment
+    if not image:
+        return None, "has no loadable segments."
+    return bytes(image), None
+
+
+def main(argv):
+    if len(argv) != 1:
+        usage(sys.stderr)
+        return 1
+    with open(argv[0], "rb") as f:
+        exe = f.read()
+    image, err = convert(exe)
+    if image is None:
+        sys.stderr.write("%s %s\n" % (argv[0], err))
+        return 1
+    with open(argv[0] + ".converted", "wb") as f:
+        f.write(image)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -20,5 +20,11 @@ extern int32_t ece391_close (int32_t fd);
 extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 
+/*
+ * Nonzero when the wrappers enter the kernel with SYSENTER rather than
+ * INT $0x80.  Set at startup from CPUID; clear it to force INT $0x80.
+ */
+extern int32_t ece391_use_sysenter;
+
 #endif /* ECE391SYSCALL_H */
 
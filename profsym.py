@@ -0,0 +1,225 @@
+#!/usr/bin/env python3
+"""Symbolize the samples of the kernel's sampling profiler.
+
+Turn the profiler on with "profctl on", run the programs to measure, then
+"profctl dump" sends the samples on COM1 (capture it with, for example,
+qemu -serial file:com1.log). This script reads the last dump of the log and
+counts the samples of every program by function, looking kernel addresses up
+in the kernel image and user addresses up in the program's ELF file,
+<dir>/<name>.exe for each directory given with --dir (syscalls/ and fish/ by
+default). The dump format is described at profile_dump in
+student-distrib/profile.c.
+"""
+
+import bisect
+import getopt
+import os
+import shutil
+import struct
+import subprocess
+import sys
+
+USER_BASE = 0x08000000      # the 128MB program page, everything below is the kernel
+SHT_SYMTAB = 2
+SHF_EXECINSTR = 0x4
+STT_NOTYPE = 0
+STT_FUNC = 2
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def usage(out):
+    out.write("usage: profsym.py [options] <serial log, - for stdin>\n"
+              "  -h, --help           show this message\n"
+              "  -k, --kernel FILE    kernel ELF image, student-distrib/bootimg by default\n"
+              "  -d, --dir DIR        where to look for <program>.exe, may be repeated;\n"
+              "                       syscalls/ and fish/ by default\n"
+              "  -n, --top N          functions shown per program, 15 by default\n"
+              "  -p, --program NAME   show only this program\n"
+              "  -f, --function NAME  break this function down by address, with source\n"
+              "                       lines when addr2line and debug information are there\n"
+              "  -l, --labels         count by every code label, local ones included, to\n"
+              "                       split assembly functions at their loops\n")
+
+
+class Symbols:
+    """The code symbols of one ELF file, sorted by address."""
+
+    def __init__(self, path, labels):
+        self.path = path
+        self.addrs = []
+        self.names = []
+        with open(path, "rb") as f:
+            elf = f.read()
+        if elf[:4] != b"\x7fELF" or elf[4] != 1:
+            raise ValueError("%s is not a 32-bit ELF file" % path)
+        shoff, = struct.unpack_from("<I", elf, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", elf, 0x2E)
+        sections = [struct.unpack_from("<IIIIIIIIII", elf, shoff + i * shentsize) for i in range(shnum)]
+        found = {}
+        for sh in sections:
+            if sh[1] != SHT_SYMTAB:
+                continue
+            strtab = sections[sh[6]]
+            for off in range(sh[4], sh[4] + sh[5], sh[9]):
+                name, value, size, info, other, shndx = struct.unpack_from("<IIIBBH", elf, off)
+                kind = info & 0xF
+                bind = info >> 4
+                if shndx == 0 or shndx >= len(sections) or not sections[shndx][2] & SHF_EXECINSTR:
+                    continue
+                if kind not in (STT_FUNC, STT_NOTYPE):
+                    continue
+                if kind == STT_NOTYPE and bind == 0 and not labels:
+                    continue    # a local label of assembly code, inside some function
+                end = elf.index(b"\0", strtab[4] + name)
+                text = elf[strtab[4] + name:end].decode(errors="replace")
+                if text and (value not in found or kind == STT_FUNC):
+                    found[value] = text
+        for addr in sorted(found):
+            self.addrs.append(addr)
+            self.names.append(found[addr])
+
+    def lookup(self, addr):
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        if i < 0:
+            return "0x%08x" % addr, addr
+        return self.names[i], self.addrs[i]
+
+
+def parse_dump(lines):
+    """Return the sessions of the last complete dump as (pid, name, samples, user, dropped, {eip: count})."""
+    last = None
+    current = None
+    for line in lines:
+        words = line.strip().split()
+        if words[:2] == ["PROFILE", "BEGIN"]:
+            current = []
+        elif current is None:
+            continue
+        elif words[:2] == ["PROFILE", "END"]:
+            last = current
+            current = None
+        elif words[:2] == ["PROFILE", "SESSION"] and len(words) == 7:
+            current.append((int(words[2]), words[3], int(words[4]), int(words[5]), int(words[6]), {}))
+        elif len(words) == 3 and words[0] == "S" and current:
+            try:
+                eip = int(words[1], 16)
+                current[-1][5][eip] = current[-1][5].get(eip, 0) + int(words[2])
+            except ValueError:
+                pass        # a line garbled on the wire
+    return last
+
+
+def source_lines(path, addrs):
+    """Map addresses to file:line with addr2line, empty without it."""
+    tool = shutil.which("addr2line")
+    if not tool or not addrs:
+        return {}
+    try:
+        out = subprocess.run([tool, "-e", path] + ["0x%x" % a for a in addrs],
+                             capture_output=True, text=True, check=True).stdout.split("\n")
+    except (OSError, subprocess.CalledProcessError):
+        return {}
+    return {a: os.path.basename(l) for a, l in zip(addrs, out) if l and not l.startswith("??")}
+
+
+def main(argv):
+    kernel = os.path.join(HERE, "student-distrib", "bootimg")
+    dirs = []
+    top = 15
+    only = None
+    function = None
+    labels = False
+    try:
+        opts, args = getopt.getopt(argv, "hk:d:n:p:f:l",
+                                   ["help", "kernel=", "dir=", "top=", "program=", "function=", "labels"])
+        for opt, val in opts:
+            if opt in ("-h", "--help"):
+                usage(sys.stdout)
+                return 0
+            elif opt in ("-k", "--kernel"):
+                kernel = val
+            elif opt in ("-d", "--dir"):
+                dirs.append(val)
+            elif opt in ("-n", "--top"):
+                top = int(val)
+            elif opt in ("-p", "--program"):
+                only = val
+            elif opt in ("-f", "--function"):
+                function = val
+            elif opt in ("-l", "--labels"):
+                labels = True
+    except (getopt.GetoptError, ValueError) as err:
+        sys.stderr.write("profsym: %s\n" % err)
+        usage(sys.stderr)
+        return 2
+    if len(args) != 1:
+        usage(sys.stderr)
+        return 2
+    if not dirs:
+        dirs = [os.path.join(HERE, "syscalls"), os.path.join(HERE, "fish")]
+
+    if args[0] == "-":
+        sessions = parse_dump(sys.stdin.read().splitlines())
+    else:
+        with open(args[0], errors="replace") as f:
+            sessions = parse_dump(f.read().splitlines())
+    if sessions is None:
+        sys.stderr.write("profsym: no complete profile dump in %s\n" % args[0])
+        return 1
+
+    cache = {}
+
+    def symbols(path):
+        if path not in cache:
+            try:
+                cache[path] = Symbols(path, labels)
+            except (OSError, ValueError) as err:
+                sys.stderr.write("profsym: %s\n" % err)
+                cache[path] = None
+        return cache[path]
+
+    out = sys.stdout
+    for pid, name, samples, user, dropped, hist in sessions:
+        if only is not None and name != only:
+            continue
+        exe = next((os.path.join(d, name + ".exe") for d in dirs
+                    if os.path.isfile(os.path.join(d, name + ".exe"))), None)
+        out.write("\n%s (pid %d): %d samples, %d in user mode, %d dropped\n"
+                  % (name, pid, samples, user, dropped))
+        if exe is None and any(eip >= USER_BASE for eip in hist):
+            out.write("  no %s.exe found, user addresses are shown raw\n" % name)
+        counted = sum(hist.values())
+        by_function = {}
+        where = {}
+        for eip, count in hist.items():
+            path = kernel if eip < USER_BASE else exe
+            syms = symbols(path) if path else None
+            if syms:
+                func, start = syms.lookup(eip)
+            else:
+                func, start = "0x%08x" % eip, eip
+            key = ("[k] " if eip < USER_BASE else "") + func
+            by_function[key] = by_function.get(key, 0) + count
+            where.setdefault(func, []).append((eip, count, path, start))
+        ranked = sorted(by_function.items(), key=lambda kv: (-kv[1], kv[0]))
+        for key, count in ranked[:top]:
+            out.write("  %7d %6.1f%%  %s\n" % (count, 100.0 * count / counted, key))
+        if len(ranked) > top:
+            rest = sum(c for _, c in ranked[top:])
+            out.write("  %7d %6.1f%%  (%d more functions)\n" % (rest, 100.0 * rest / counted, len(ranked) - top))
+        if function is not None and function in where:
+            spots = sorted(where[function])
+            total = sum(c for _, c, _, _ in spots)
+            path = spots[0][2]
+            lines = source_lines(path, [e for e, _, _, _ in spots]) if path else {}
+            out.write("\n  %s, %d samples by address:\n" % (function, total))
+            for eip, count, _, start in spots:
+                out.write("  %08x  +0x%-5x %7d %6.1f%%  %s\n" % (eip, eip - start, count,
+                                                               100.0 * count / total, lines.get(eip, "")))
+    out.write("\n[k] marks kernel functions, run on behalf of the program\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -2,24 +2,377 @@
 #include "lib.h"
 #include "types.h"
 #include "systemcall.h"
+#include "pagecache.h"
+#include "blk.h"
+#include "scheduler.h"
+#include "proc.h"
+#include "serial.h"
+static uint32_t block_used[FS_MAX_DATABLOCKS / 32];     // free-block bitmap, 1 if the data block holds file data
+static uint32_t block_dirty[FS_MAX_IMAGE_BLOCKS / 32];  // image blocks changed since the last fs_sync
+static uint32_t max_datablocks;                         // data blocks that fit below the limit given to filesystem_init
+static uint8_t (*fs_meta)[BLOCK_SIZE];                  // boot block and inodes of an image on disk, given to filesystem_init_disk
+static blk_request_t meta_req[1 + FS_MAX_INODES];      // disk transfers of the blocks in fs_meta
+static uint32_t fs_extended;                            // 1 if the image is in the version 2 format
+static uint8_t block_maps[FS_MAX_DATABLOCKS];           // mmap pages mapping each data block of a resident image
+
+/* 
+ *fs_check_format
+ * DESCRIPTION: tell the original format from the extended one by the boot block
+ * INPUTS: boot -- the boot block
+ * OUTPUTS:None
+ * RETURN VALUE: return 0 for a format this kernel mounts, -1 for a newer version
+ * SIDE EFFECTS: sets fs_extended
+ */
+static int32_t fs_check_format(bootblock_t* boot){
+    if(boot->magic != FS_MAGIC){
+        fs_extended = 0;    // the original format, the field is part of its reserved zeros
+        return 0;
+    }
+    if(boot->version > FS_VERSION){
+        return -1;
+    }
+    fs_extended = (boot->version >= 2);
+    return 0;
+}
+
 /* 
  *init_filesystem
  * DESCRIPTION: initialize the file system
- * INPUTS: starting_addr
+ * INPUTS: starting_addr -- address of the image
+ *         limit_addr -- first address the image may not grow into
  * OUTPUTS:None
- * RETURN VALUE: return 0 for success, return -1 for failure
- * SIDE EFFECTS: Set the pointer pointing to the bootblock
+ * RETURN VALUE: return 0 for success, return -1 for failure or if the image already runs past limit_addr
+ * SIDE EFFECTS: Set the pointer pointing to the bootblock, build the extents and the free-block bitmap
  */
-int32_t filesystem_init(uint32_t starting_addr){
+int32_t filesystem_init(uint32_t starting_addr, uint32_t limit_addr){
+    bootblock_t* boot = (bootblock_t*)starting_addr;
+    datablock_t* base;
     if(starting_addr == NULL){                               //check the validity of the address
         return -1;
     }
     else{
-        bootblock_ptr = (bootblock_t*)starting_addr;         //valid address
+        if(fs_check_format(boot) == -1){
+            return -1;
+        }
+        base = (datablock_t*)((inode_t*)((void*)boot + BLOCK_SIZE) + boot->num_inodes);
+        if((uint32_t)(base + boot->num_datablocks) > limit_addr){
+            return -1;      // the image overlaps what lies above it, the kernel stacks
+        }
+        bootblock_ptr = boot;                                //valid address
+        datablock_base = base;
+        // new data blocks are appended after the image, up to the limit
+        max_datablocks = (limit_addr - (uint32_t)datablock_base) / BLOCK_SIZE;
+        if(max_datablocks > FS_MAX_DATABLOCKS){
+            max_datablocks = FS_MAX_DATABLOCKS;
+        }
+        pcache_init(NULL);     // a resident image is never read through the cache
+        build_extents();
+        build_free_map();
         return 0;
     }
 }
 
+/* 
+ *fs_disk_writeback
+ * DESCRIPTION: fs_writeback of an image on disk. Only the boot block and the inodes are
+ *              written from memory, data blocks are written back from the page cache.
+ * INPUTS: block -- image block number, data -- its contents
+ * OUTPUTS:None
+ * RETURN VALUE: return 0 if the write was queued, -1 otherwise
+ * SIDE EFFECTS: the write goes out when fs_sync runs the block queue
+ */
+static int32_t fs_disk_writeback(uint32_t block, const uint8_t* data){
+    if(block > FS_MAX_INODES){
+        return -1;
+    }
+    meta_req[block].sector = block * BLK_SECTORS_PER_BLOCK;
+    meta_req[block].count = BLK_SECTORS_PER_BLOCK;
+    meta_req[block].buf = (uint8_t*)data;
+    meta_req[block].dir = BLK_WRITE;
+    return blk_submit(&meta_req[block]);
+}
+
+/* 
+ *filesystem_init_disk
+ * DESCRIPTION: initialize the file system from an image at the start of the disk. The boot
+ *              block and the inodes are read into memory, and data blocks are read through the
+ *              page cache as they are used, so the image does not have to fit in memory.
+ *              Both are kept in the memory given, which is only needed when there is no
+ *              resident image.
+ * INPUTS: mem_start -- 4KB aligned address of free memory
+ *         mem_limit -- first address past it
+ * OUTPUTS:None
+ * RETURN VALUE: return 0 for success, return -1 if there is no disk, it holds no image, or
+ *               the memory cannot hold its inodes and the page cache
+ * SIDE EFFECTS: sets fs_writeback, so fs_sync writes to the disk
+ */
+int32_t filesystem_init_disk(uint32_t mem_start, uint32_t mem_limit){
+    uint32_t i, disk_blocks = blk_sectors() / BLK_SECTORS_PER_BLOCK;
+    bootblock_t* boot = (bootblock_t*)mem_start;
+    fs_meta = (uint8_t (*)[BLOCK_SIZE])mem_start;
+    if(disk_blocks == 0 || mem_limit < mem_start + BLOCK_SIZE || blk_rw(0, BLK_SECTORS_PER_BLOCK, fs_meta[0], BLK_READ) == -1){
+        return -1;
+    }
+    if(boot->num_inodes == 0 || boot->num_inodes > FS_MAX_INODES || 1 + boot->num_inodes + boot->num_datablocks > disk_blocks
+            || fs_check_format(boot) == -1 || (!fs_extended && boot->num_dir_entries > dir_entries_num_bootlock)){
+        return -1;  // not a filesystem image, or one too new
+    }
+    if((mem_limit - mem_start) / BLOCK_SIZE < 1 + boot->num_inodes + PCACHE_NUM){
+        return -1;  // the cache blocks follow the inodes
+    }
+    // queue every inode block at once, they are neighbours and go out in one command
+    for(i = 1; i <= boot->num_inodes; i++){
+        meta_req[i].sector = i * BLK_SECTORS_PER_BLOCK;
+        meta_req[i].count = BLK_SECTORS_PER_BLOCK;
+        meta_req[i].buf = fs_meta[i];
+        meta_req[i].dir = BLK_READ;
+        if(blk_submit(&meta_req[i]) == -1){
+            meta_req[i].status = BLK_ERROR;
+        }
+    }
+    blk_run();
+    for(i = 1; i <= boot->num_inodes; i++){
+        if(meta_req[i].status != BLK_DONE){
+            return -1;
+        }
+    }
+    bootblock_ptr = boot;
+    datablock_base = NULL;      // data blocks are only on disk
+    max_datablocks = disk_blocks - 1 - boot->num_inodes;
+    if(max_datablocks > FS_MAX_DATABLOCKS){
+        max_datablocks = FS_MAX_DATABLOCKS;
+    }
+    fs_writeback = fs_disk_writeback;
+    pcache_init(fs_meta[1 + boot->num_inodes]);     // indirect and directory blocks are read through it from here on
+    build_extents();
+    build_free_map();
+    return 0;
+}
+
+/* 
+ *meta_block
+ * DESCRIPTION: get an indirect or directory block. An image in memory hands out the block
+ *              itself; on disk it comes through the page cache, filed under FS_META_INODE.
+ * INPUTS: data_block -- data block number
+ * OUTPUTS:None
+ * RETURN VALUE: address of the block, NULL if it is out of range or could not be read. On disk
+ *               the address is only good until the next page cache call.
+ * SIDE EFFECTS: None
+ */
+static uint8_t* meta_block(uint32_t data_block){
+    if(data_block >= bootblock_ptr->num_datablocks){
+        return NULL;
+    }
+    if(datablock_base != NULL){
+        return (uint8_t*)(datablock_base + data_block);
+    }
+    return pcache_get(FS_META_INODE, data_block);
+}
+
+/* 
+ *meta_block_dirty
+ * DESCRIPTION: remember that an indirect or directory block changed
+ * INPUTS: data_block -- data block number
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+static void meta_block_dirty(uint32_t data_block){
+    if(datablock_base != NULL){
+        mark_dirty(FS_DATA_BLOCK(data_block));
+    }else{
+        pcache_mark_dirty(FS_META_INODE, data_block);
+    }
+}
+
+/* 
+ *alloc_metablock
+ * DESCRIPTION: take a zeroed data block for an indirect or directory block
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: the data block number, -1 if the filesystem is full
+ * SIDE EFFECTS: the block is dirty
+ */
+static int32_t alloc_metablock(){
+    int32_t data_block = alloc_datablock();
+    if(data_block == -1){
+        return -1;
+    }
+    if(datablock_base == NULL && pcache_zero(FS_META_INODE, data_block) == NULL){
+        block_used[data_block >> 5] &= ~(1 << (data_block & 31));
+        return -1;
+    }
+    meta_block_dirty(data_block);
+    return data_block;
+}
+
+/* 
+ *free_metablock
+ * DESCRIPTION: give an indirect or directory block back to the bitmap
+ * INPUTS: data_block -- data block number
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: drops the cached copy, the block may be handed out again as file data
+ */
+static void free_metablock(uint32_t data_block){
+    if(data_block < FS_MAX_DATABLOCKS){
+        block_used[data_block >> 5] &= ~(1 << (data_block & 31));
+        pcache_forget(FS_META_INODE, data_block);
+    }
+}
+
+/* 
+ *dentry_at
+ * DESCRIPTION: find a directory entry, in the boot block or further down the directory chain
+ * INPUTS: index -- entry number
+ * OUTPUTS:None
+ * RETURN VALUE: address of the entry, NULL if the index is out of range or the chain is broken.
+ *               An entry in the chain is only good until the next page cache call.
+ * SIDE EFFECTS: None
+ */
+static dentry_t* dentry_at(uint32_t index){
+    uint32_t block, hops = 0;
+    dirblock_t* dir;
+    if(index >= bootblock_ptr->num_dir_entries){
+        return NULL;
+    }
+    if(index < dir_entries_num_bootlock){
+        return &bootblock_ptr->dir_entries[index];
+    }
+    if(!fs_extended){
+        return NULL;
+    }
+    index -= dir_entries_num_bootlock;
+    for(block = bootblock_ptr->dir_block; (dir = (dirblock_t*)meta_block(block)) != NULL; block = dir->next){
+        if(index < dir_entries_num_bootlock){
+            return &dir->dir_entries[index];
+        }
+        index -= dir_entries_num_bootlock;
+        if(++hops >= bootblock_ptr->num_datablocks){
+            break;  // the chain loops
+        }
+    }
+    return NULL;
+}
+
+/* 
+ *mark_used
+ * DESCRIPTION: mark one data block used in the free-block bitmap
+ * INPUTS: data_block -- data block number
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+static void mark_used(uint32_t data_block){
+    if(data_block < FS_MAX_DATABLOCKS){
+        block_used[data_block >> 5] |= 1 << (data_block & 31);
+    }
+}
+
+/* 
+ *build_free_map
+ * DESCRIPTION: mark every data block used by a regular file in the free-block bitmap
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: fills block_used and clears block_dirty. Blocks listed by inodes that no
+ *               directory entry names are free.
+ */
+void build_free_map(){
+    uint32_t i, block, num_block, inode, hops = 0;
+    inode_t* inode_ptr;
+    dentry_t* entry;
+    dirblock_t* dir;
+    uint32_t* table;
+    memset(block_used, 0, sizeof(block_used));
+    memset(block_dirty, 0, sizeof(block_dirty));
+    for(i = 0; i < bootblock_ptr->num_dir_entries; i++){
+        if((entry = dentry_at(i)) == NULL){
+            break;
+        }
+        if(entry->filetype != 2 || entry->inode_num >= bootblock_ptr->num_inodes){
+            continue;   // only regular files own data blocks
+        }
+        inode = entry->inode_num;
+        inode_ptr = (inode_t*)((void*)bootblock_ptr + BLOCK_SIZE) + inode;
+        num_block = inode_ptr->length / BLOCK_SIZE + (inode_ptr->length % BLOCK_SIZE != 0);
+        if(num_block > fs_max_file_blocks()){
+            continue;   // corrupt length
+        }
+        for(block = 0; block < num_block; block++){
+            mark_used(get_datablock_num(inode, block));
+        }
+        // and the indirect blocks holding the block numbers
+        if(fs_extended && num_block > FS_DIRECT_V2){
+            mark_used(inode_ptr->block_num[FS_INDIRECT_SLOT]);
+        }
+        if(fs_extended && num_block > FS_DIRECT_V2 + FS_PTRS_PER_BLOCK){
+            mark_used(inode_ptr->block_num[FS_DINDIRECT_SLOT]);
+            num_block -= FS_DIRECT_V2 + FS_PTRS_PER_BLOCK;
+            for(block = 0; block * FS_PTRS_PER_BLOCK < num_block; block++){
+                if((table = (uint32_t*)meta_block(inode_ptr->block_num[FS_DINDIRECT_SLOT])) != NULL){
+                    mark_used(table[block]);
+                }
+            }
+        }
+    }
+    for(block = bootblock_ptr->dir_block; fs_extended && (dir = (dirblock_t*)meta_block(block)) != NULL; block = dir->next){
+        mark_used(block);
+        if(++hops >= bootblock_ptr->num_datablocks){
+            break;  // the chain loops
+        }
+    }
+}
+
+/* 
+ *build_extents
+ * DESCRIPTION: merge the block list of every inode into runs of physically consecutive
+ *              data blocks, so a page cache miss can read ahead to the end of the run
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: fills extent_pool, extent_first and extent_num. An inode whose runs do not
+ *               fit in the pool keeps extent_num 0 and gets no read-ahead.
+ */
+void build_extents(){
+    uint32_t inode, block, num_block, used = 0;
+    int32_t data_block;
+    inode_t* inode_ptr;
+    extent_t* ext;
+    for(inode = 0; inode < EXTENT_INODE_MAX; inode++){
+        extent_num[inode] = 0;
+        if(inode >= bootblock_ptr->num_inodes){
+            continue;
+        }
+        inode_ptr = (inode_t*)((void*)bootblock_ptr + BLOCK_SIZE) + inode;
+        num_block = inode_ptr->length / BLOCK_SIZE + (inode_ptr->length % BLOCK_SIZE != 0);
+        if(num_block > fs_max_file_blocks()){
+            continue;   // corrupt length, no extents
+        }
+        extent_first[inode] = used;
+        for(block = 0; block < num_block; block++){
+            data_block = get_datablock_num(inode, block);
+            if(extent_num[inode] > 0){
+                ext = &extent_pool[used - 1];
+                if(ext->data_block + ext->count == (uint32_t)data_block){
+                    ext->count++;   // continues the last run
+                    continue;
+                }
+            }
+            if(used == EXTENT_POOL_SIZE){
+                extent_num[inode] = 0;  // out of room, leave this inode uncached
+                used = extent_first[inode];
+                break;
+            }
+            extent_pool[used].file_block = block;
+            extent_pool[used].data_block = data_block;
+            extent_pool[used].count = 1;
+            used++;
+            extent_num[inode]++;
+        }
+    }
+}
+
 /* 
  *read_dentry_by_name
  * DESCRIPTION: fill the directory entry with given filename
@@ -34,9 +387,17 @@ int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry){
     }
     //non-exist file, return -1
     int i,j;
+    dentry_t* entry;
     for(i=0;i<bootblock_ptr->num_dir_entries;i++){                       //go through each directory entry
         int file_found =1;                                               //set the found flag
-        dentry_t cur_dentry = bootblock_ptr->dir_entries[i];
+        sched_hold();                                                    // an entry in the chain lives in the page cache
+        entry = dentry_at(i);
+        if(entry == NULL){
+            sched_release();
+            return -1;
+        }
+        dentry_t cur_dentry = *entry;
+        sched_release();
         for(j=0;j<filename_len;j++){                                     //go through each character in filename
             if(fname[j]!=cur_dentry.filename[j]){
                 file_found = 0;
@@ -48,7 +409,6 @@ int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry){
                 
         }
         if(file_found){
-            curfile = cur_dentry;                                        //store it as a global variable
             for(j=0;j<filename_len;j++){
                 dentry->filename[j] = cur_dentry.filename[j];
             }
@@ -57,8 +417,11 @@ int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry){
             return 0;
         }
     }
-    //fill in dentry with the file name, file type, inode number of the file
-    return -1;
+    // the statistics files and the serial port are there even when the image has no entry for them
+    if(proc_lookup(fname, dentry) == 0){
+        return 0;
+    }
+    return serial_lookup(fname, dentry);
 }
 
 /* 
@@ -75,33 +438,87 @@ int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry){
         return -1;
     } 
     int i;
-    curdirectory = bootblock_ptr->dir_entries[index];                     //go to the directory of given index
+    sched_hold();                                                          // an entry in the chain lives in the page cache
+    dentry_t* entry = dentry_at(index);                                    //go to the directory of given index
+    if(entry == NULL){
+        sched_release();
+        return -1;
+    }
     for(i=0;i<filename_len;i++){                                         
-        dentry->filename[i]=curdirectory.filename[i];
+        dentry->filename[i]=entry->filename[i];
     }
-    dentry->filetype = curdirectory.filetype;
-    dentry->inode_num = curdirectory.inode_num;                           //copy info into dentry
+    dentry->filetype = entry->filetype;
+    dentry->inode_num = entry->inode_num;                                 //copy info into dentry
+    sched_release();
     return 0;
 }
 
+/* 
+ *read_image
+ * DESCRIPTION: copy file bytes straight out of a filesystem image in memory. Whole runs of
+ *              physically consecutive data blocks go with one memcpy each; an inode without
+ *              extents is copied one block at a time.
+ * INPUTS: inode, offset, buf, length -- the bytes, which must lie within the file
+ * OUTPUTS:None
+ * RETURN VALUE: the number of bytes copied
+ * SIDE EFFECTS: None
+ */
+static uint32_t read_image(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
+    uint32_t copied = 0;
+    uint32_t run_bytes;
+    uint32_t block;
+    uint8_t* data;
+    extent_t* ext;
+    uint32_t i;
+    if(inode >= EXTENT_INODE_MAX || extent_num[inode] == 0){
+        // no extents for this inode, copy one block at a time
+        while(copied < length){
+            if((data = get_datablock(inode, (offset + copied) / BLOCK_SIZE)) == NULL){
+                break;
+            }
+            run_bytes = BLOCK_SIZE - (offset + copied) % BLOCK_SIZE;
+            if(run_bytes > length - copied){
+                run_bytes = length - copied;
+            }
+            memcpy(buf + copied, data + (offset + copied) % BLOCK_SIZE, run_bytes);
+            copied += run_bytes;
+        }
+        return copied;
+    }
+    // find the run holding the start block, then copy whole runs with one memcpy each
+    ext = &extent_pool[extent_first[inode]];
+    for(i = 0; i < extent_num[inode] && offset / BLOCK_SIZE >= ext[i].file_block + ext[i].count; i++);
+    while(copied < length && i < extent_num[inode]){
+        block = (offset + copied) / BLOCK_SIZE;
+        if(block >= ext[i].file_block + ext[i].count){
+            i++;    // runs are in file order, the next one starts at this block
+            continue;
+        }
+        run_bytes = (ext[i].file_block + ext[i].count) * BLOCK_SIZE - (offset + copied);
+        if(run_bytes > length - copied){
+            run_bytes = length - copied;
+        }
+        memcpy(buf + copied, (uint8_t*)(datablock_base + ext[i].data_block + (block - ext[i].file_block))
+               + (offset + copied) % BLOCK_SIZE, run_bytes);
+        copied += run_bytes;
+    }
+    return copied;
+}
+
 /* 
  *read_data
  * DESCRIPTION: read bytes (begin at the offset) in the file (indicated by inode) and return the number of bytes read and placed in the buffer
  * INPUTS: inode, offset, buf, length
  * OUTPUTS:None
- * RETURN VALUE: return the number of bytes read for success, return -1 for failure
+ * RETURN VALUE: return the number of bytes read for success, 0 at the end of the file, return -1 for failure
  * SIDE EFFECTS: more bytes are read
  */
 int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
     inode_t* inode_ptr;
-    uint32_t block;
-    uint32_t num_block;
-    uint8_t* start_addr;
-    uint8_t* cur_buf = buf;
-    uint32_t rem_length = length;
-    datablock_t* datablock_addr;
-    datablock_t* start_block;
     uint32_t read_length;
+    uint32_t copied = 0;
+    uint32_t run_bytes;
+    uint8_t* page;
     if(inode >= bootblock_ptr->num_inodes){
         return -1;  //invalid inode number, return -1
     }
@@ -109,52 +526,61 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
         return -1;  // invalid buf
     }
     inode_ptr = (inode_t*)((void*)bootblock_ptr + BLOCK_SIZE) + inode;
+    if(offset >= inode_ptr -> length){
+        return 0;   // at or past the end of the file
+    }
     if((inode_ptr -> length - offset) < length){
         read_length = inode_ptr -> length - offset;
     }else{
         read_length = length;
     }
     //read up to length(3rd argument) bytes starting from position offset(2nd argument)
-    block = offset / BLOCK_SIZE;    // get the start data block position
-    if(inode_ptr->length % BLOCK_SIZE){ // get the number of block info from inode
-        num_block = (inode_ptr->length / BLOCK_SIZE) + 1;
-    }else{
-        num_block = (inode_ptr->length / BLOCK_SIZE);
+    if(datablock_base != NULL){
+        return read_image(inode, offset, buf, read_length);    // the image is resident, the cache would only add a copy
     }
-    if(block >= num_block){ // check data block bound
-        return -1;
+    // from the disk every block comes through the page cache, which no other process may touch meanwhile
+    sched_hold();
+    while(copied < read_length){
+        if((page = pcache_get(inode, (offset + copied) / BLOCK_SIZE)) == NULL){
+            break;
+        }
+        run_bytes = BLOCK_SIZE - (offset + copied) % BLOCK_SIZE;
+        if(run_bytes > read_length - copied){
+            run_bytes = read_length - copied;
+        }
+        memcpy(buf + copied, page + (offset + copied) % BLOCK_SIZE, run_bytes);
+        copied += run_bytes;
     }
-    datablock_addr = (datablock_t*)((inode_t*)((void*)bootblock_ptr + BLOCK_SIZE) + bootblock_ptr->num_inodes);
-    start_block = datablock_addr + inode_ptr->block_num[block];
-    start_addr = (uint8_t*)start_block + offset % BLOCK_SIZE;
-    // get the start read position
-    if(read_length <= (BLOCK_SIZE - offset % BLOCK_SIZE)){    // only read the start block
-        memcpy(cur_buf, (uint8_t*)start_addr, read_length);
-        return read_length;
-    }else{
-        memcpy(cur_buf, (uint8_t*)start_addr, BLOCK_SIZE - offset % BLOCK_SIZE);  // read the start block
-        rem_length = read_length - BLOCK_SIZE + (offset % BLOCK_SIZE);  // update the remaining length to read
-        cur_buf = cur_buf + BLOCK_SIZE - offset % BLOCK_SIZE;   // update the position to store in the buf
-        block++;    // update the data block position
+    sched_release();
+    return copied;   // return length read
+}
+
+/* 
+ *run_length
+ * DESCRIPTION: count the blocks from a file block to the end of its run of physically
+ *              consecutive data blocks, using the extents
+ * INPUTS: inode, block
+ * OUTPUTS:None
+ * RETURN VALUE: blocks left in the run including block, 1 if the inode has no extents,
+ *               0 if block is past the end of the file
+ * SIDE EFFECTS: None
+ */
+uint32_t run_length(uint32_t inode, uint32_t block){
+    extent_t* ext;
+    uint32_t i;
+    if(get_datablock_num(inode, block) == -1){
+        return 0;
     }
-    while (rem_length > 0){    // read until there is no remaining length to read 
-        if(block >= num_block){ // check block bound
-            return cur_buf - buf;
-        }
-        start_block = datablock_addr + inode_ptr->block_num[block];
-        start_addr = (uint8_t*)start_block;
-        // update start read position
-        if(rem_length < BLOCK_SIZE){   // last block to be read
-            memcpy(cur_buf, (uint8_t*)start_addr, rem_length);
-            return cur_buf - buf + rem_length;
-        }else{  // read the entire block and then update the remaining length, buf position, and block info
-            memcpy(cur_buf, (uint8_t*)start_addr, BLOCK_SIZE);
-            rem_length = rem_length - BLOCK_SIZE;
-            cur_buf = cur_buf + BLOCK_SIZE;
-            block++;
+    if(inode >= EXTENT_INODE_MAX || extent_num[inode] == 0){
+        return 1;
+    }
+    ext = &extent_pool[extent_first[inode]];
+    for(i = 0; i < extent_num[inode]; i++){
+        if(block < ext[i].file_block + ext[i].count){
+            return ext[i].file_block + ext[i].count - block;
         }
     }
-    return cur_buf - buf;   // return length read
+    return 1;
 }
 
 /* 
@@ -163,15 +589,15 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
  * INPUTS: fname
  * OUTPUTS:None
  * RETURN VALUE: return 0 for success, return -1 for failure
- * SIDE EFFECTS: do nothing because we have a read-only file system
+ * SIDE EFFECTS: None, the read position lives in the fd and open sets it to 0
  */
 int32_t directory_open(const uint8_t* fname){
-   int32_t result = read_dentry_by_name(fname,&curdirectory);       // check the validity of filename
+   dentry_t dentry;
+   int32_t result = read_dentry_by_name(fname,&dentry);             // check the validity of filename
    if(result<0){
     return -1;
    }
-   if(curdirectory.filetype==1){                                    // 1 means the directory type number
-    cur_directory_read_idx = 0;                                     // set the index to 0
+   if(dentry.filetype==1){                                          // 1 means the directory type number
     return 0;
    }
    return -1;
@@ -195,18 +621,50 @@ int32_t directory_close(int32_t fd){
  * INPUTS: fd, buf, nbytes
  * OUTPUTS:None
  * RETURN VALUE: return 0 for success, return -1 for failure
- * SIDE EFFECTS: do nothing because we have a read-only file system
+ * SIDE EFFECTS: advances the fd's file_pos, which counts directory entries
  */
 int32_t directory_read(int32_t fd, void* buf, int32_t nbytes){
+    dentry_t dentry;
     if(!buf) return -1;                                                            // invalid buffer
-    if(cur_directory_read_idx==bootblock_ptr->num_dir_entries) return 0;           // at the last directory entry, just return
-    int32_t result = read_dentry_by_index(cur_directory_read_idx,&curdirectory);   // check index validity
+    fd_t* file = &get_curr_pcb()->fd_arr[fd];                                      // each fd keeps its own position
+    if(file->file_pos==bootblock_ptr->num_dir_entries) return 0;                   // at the last directory entry, just return
+    int32_t result = read_dentry_by_index(file->file_pos,&dentry);                 // check index validity
     if(result<0) return -1;                                                        // failed reading index
-    cur_directory_read_idx ++;
-    memcpy(buf,curdirectory.filename,filename_len);                                // copy the filename to buffer
+    file->file_pos ++;
+    memcpy(buf,dentry.filename,filename_len);                                      // copy the filename to buffer
     return filename_len;
 }
 
+/* 
+ *directory_getdents
+ * DESCRIPTION: fill a buffer with as many directory entries as fit, each with its file
+ *              type, inode and size, starting at the fd's position
+ * INPUTS: fd, buf, nbytes
+ * OUTPUTS:None
+ * RETURN VALUE: return the number of bytes filled, 0 at the end of the directory,
+ *               -1 for failure or if not even one entry fits
+ * SIDE EFFECTS: advances the fd's file_pos by the number of entries returned
+ */
+int32_t directory_getdents(int32_t fd, void* buf, int32_t nbytes){
+    dentry_t dentry;
+    dirent_t* ent = (dirent_t*)buf;
+    int32_t count = 0;
+    if(!buf) return -1;                                                            // invalid buffer
+    fd_t* file = &get_curr_pcb()->fd_arr[fd];
+    if(file->file_pos==bootblock_ptr->num_dir_entries) return 0;                   // already at the end
+    if(nbytes < (int32_t)sizeof(dirent_t)) return -1;                              // room for one entry at least
+    while((count + 1) * (int32_t)sizeof(dirent_t) <= nbytes && file->file_pos < bootblock_ptr->num_dir_entries){
+        if(read_dentry_by_index(file->file_pos,&dentry) < 0) return -1;
+        memcpy(ent[count].filename,dentry.filename,filename_len);
+        ent[count].filetype = dentry.filetype;
+        ent[count].inode_num = dentry.inode_num;
+        ent[count].length = (dentry.filetype == 2) ? get_filelen(dentry.inode_num) : 0;   // 2 is a regular file
+        file->file_pos ++;
+        count ++;
+    }
+    return count * sizeof(dirent_t);
+}
+
 /* 
  *directory_write
  * DESCRIPTION: NONE
@@ -228,7 +686,8 @@ int32_t directory_write(int32_t fd, const void* buf, int32_t nbytes){
  * SIDE EFFECTS: if the filename exists, just return (for checkpoint 6.2)
  */
 int32_t file_open(const uint8_t* fname){
-    uint32_t result = read_dentry_by_name(fname, &curfile);     //check validity of filename
+    dentry_t dentry;
+    int32_t result = read_dentry_by_name(fname, &dentry);       //check validity of filename
     if(result < 0) return -1;
     return 0;
 }
@@ -257,22 +716,675 @@ int32_t file_read(int32_t fd, void* buf, int32_t nbytes){
     if(!buf) return -1;                                                                                       // invalid buffer
     
     pcb_t* curr_pcb = get_curr_pcb();                                                                         // get the current pcb pointer
-    int32_t result = read_data(curr_pcb -> fd_arr[fd].inode, curr_pcb -> fd_arr[fd].file_pos, buf, nbytes);   // check if we can read
-    if(result < 0) return -1;                                                                                 // fail reading
-    curr_pcb -> fd_arr[fd].file_pos += result;                                                                // update the read position in pcb
+    fd_t* file = &curr_pcb -> fd_arr[fd];
+    uint32_t len = get_filelen(file -> inode);
+    uint32_t pos = file -> file_pos;
+    int32_t result = 0;
+    int32_t rest;
+    uint8_t* page = NULL;
+    int sequential = (file -> seq_pos == file -> file_pos);
+    sched_hold();                                                                                             // the remembered slot must not be reused under us
+    if(nbytes > 0 && pos < len){
+        if(datablock_base != NULL){
+            page = get_datablock(file -> inode, pos / BLOCK_SIZE);                                            // the image is resident, copy from it
+        }else if(sequential){
+            // continue in the remembered cache slot if it still holds the block
+            page = pcache_slot_data(file -> seq_slot, file -> inode, pos / BLOCK_SIZE);
+        }
+    }
+    if(page != NULL){
+        result = BLOCK_SIZE - pos % BLOCK_SIZE;
+        if((uint32_t)result > len - pos) result = len - pos;
+        if(result > nbytes) result = nbytes;
+        memcpy(buf, page + pos % BLOCK_SIZE, result);
+        if(result < nbytes && pos + result < len){
+            rest = read_data(file -> inode, pos + result, (uint8_t*)buf + result, nbytes - result);    // the rest starts on a block boundary
+            if(rest > 0) result += rest;
+        }
+    }else{
+        result = read_data(file -> inode, pos, buf, nbytes);                                                  // check if we can read
+        if(result < 0){
+            sched_release();
+            return -1;                                                                                        // fail reading
+        }
+    }
+    file -> seq_reads = sequential ? file -> seq_reads + 1 : 0;
+    file -> file_pos += result;                                                                               // update the read position in pcb
+    if(datablock_base == NULL){
+        // remember the slot the next read starts in, it is checked against the block on use
+        file -> seq_slot = pcache_lookup(file -> inode, file -> file_pos / BLOCK_SIZE);
+    }
+    file -> seq_pos = file -> file_pos;
+    sched_release();
     return result;  
 }
 
+/* 
+ *set_datablock_num
+ * DESCRIPTION: record the data block holding one block of a file. Files grow a block at a
+ *              time, so the indirect block covering a block is allocated along with the first
+ *              block it covers.
+ * INPUTS: inode -- number of inode
+ *         block -- index of the block within the file, the current number of blocks
+ *         data_block -- data block number
+ * OUTPUTS:None
+ * RETURN VALUE: return 0 for success, -1 if an indirect block could not be allocated
+ * SIDE EFFECTS: the indirect blocks changed are dirty, the inode is marked by the caller
+ */
+static int32_t set_datablock_num(uint32_t inode, uint32_t block, uint32_t data_block){
+    inode_t* inode_ptr = (inode_t*)((void*)bootblock_ptr + BLOCK_SIZE) + inode;
+    uint32_t* table;
+    int32_t top, ind;
+    if(!fs_extended || block < FS_DIRECT_V2){
+        if(block >= inode_maxnum_datablock){
+            return -1;
+        }
+        inode_ptr->block_num[block] = data_block;
+        return 0;
+    }
+    block -= FS_DIRECT_V2;
+    if(block < FS_PTRS_PER_BLOCK){
+        if(block == 0){
+            if((ind = alloc_metablock()) == -1){
+                return -1;
+            }
+            inode_ptr->block_num[FS_INDIRECT_SLOT] = ind;
+        }
+        ind = inode_ptr->block_num[FS_INDIRECT_SLOT];
+    }else{
+        block -= FS_PTRS_PER_BLOCK;
+        if(block >= FS_PTRS_PER_BLOCK * FS_PTRS_PER_BLOCK){
+            return -1;
+        }
+        if(block == 0){
+            if((top = alloc_metablock()) == -1){
+                return -1;
+            }
+            inode_ptr->block_num[FS_DINDIRECT_SLOT] = top;
+        }
+        top = inode_ptr->block_num[FS_DINDIRECT_SLOT];
+        if(block % FS_PTRS_PER_BLOCK == 0){
+            // allocate before looking at the top block, the allocation may evict it
+            if((ind = alloc_metablock()) == -1 || (table = (uint32_t*)meta_block(top)) == NULL){
+                if(ind != -1){
+                    free_metablock(ind);
+                }
+                if(block == 0){
+                    free_metablock(top);
+                }
+                return -1;
+            }
+            table[block / FS_PTRS_PER_BLOCK] = ind;
+            meta_block_dirty(top);
+        }
+        if((table = (uint32_t*)meta_block(top)) == NULL){
+            return -1;
+        }
+        ind = table[block / FS_PTRS_PER_BLOCK];
+        block %= FS_PTRS_PER_BLOCK;
+    }
+    if((table = (uint32_t*)meta_block(ind)) == NULL){
+        return -1;
+    }
+    table[block] = data_block;
+    meta_block_dirty(ind);
+    return 0;
+}
+
+/* 
+ *free_file_blocks
+ * DESCRIPTION: give the data blocks of the last blocks of a file back to the bitmap, along with
+ *              the indirect blocks no block below first needs
+ * INPUTS: inode -- number of inode
+ *         first -- first block to free, the new number of blocks
+ *         last -- the old number of blocks
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: the caller shortens the file and drops the cached blocks
+ */
+static void free_file_blocks(uint32_t inode, uint32_t first, uint32_t last){
+    inode_t* inode_ptr = (inode_t*)((void*)bootblock_ptr + BLOCK_SIZE) + inode;
+    uint32_t block, base = FS_DIRECT_V2 + FS_PTRS_PER_BLOCK;
+    int32_t data_block;
+    uint32_t* table;
+    for(block = first; block < last; block++){
+        if((data_block = get_datablock_num(inode, block)) != -1 && data_block < FS_MAX_DATABLOCKS){
+            block_used[data_block >> 5] &= ~(1 << (data_block & 31));
+        }
+    }
+    if(!fs_extended){
+        return;
+    }
+    if(first <= FS_DIRECT_V2 && last > FS_DIRECT_V2){
+        free_metablock(inode_ptr->block_num[FS_INDIRECT_SLOT]);
+    }
+    if(last > base){
+        // indirect blocks under the double indirect block, from the first one no longer needed
+        block = (first > base) ? (first - base + FS_PTRS_PER_BLOCK - 1) / FS_PTRS_PER_BLOCK : 0;
+        for(; block < (last - base + FS_PTRS_PER_BLOCK - 1) / FS_PTRS_PER_BLOCK; block++){
+            if((table = (uint32_t*)meta_block(inode_ptr->block_num[FS_DINDIRECT_SLOT])) != NULL){
+                free_metablock(table[block]);
+            }
+        }
+        if(first <= base){
+            free_metablock(inode_ptr->block_num[FS_DINDIRECT_SLOT]);
+        }
+    }
+}
+
+/* 
+ *chain_block
+ * DESCRIPTION: find the directory block holding an entry past the boot block
+ * INPUTS: index -- entry number, at least dir_entries_num_bootlock
+ * OUTPUTS:None
+ * RETURN VALUE: the data block number, FS_NO_BLOCK if the chain is shorter
+ * SIDE EFFECTS: None
+ */
+static uint32_t chain_block(uint32_t index){
+    uint32_t block = bootblock_ptr->dir_block;
+    dirblock_t* dir;
+    for(index = index / dir_entries_num_bootlock - 1; index > 0; index--){
+        if((dir = (dirblock_t*)meta_block(block)) == NULL){
+            return FS_NO_BLOCK;
+        }
+        block = dir->next;
+    }
+    return block;
+}
+
+/* 
+ *add_dirblock
+ * DESCRIPTION: add a directory block to the end of the chain for an entry that starts it
+ * INPUTS: index -- number of the new entry
+ * OUTPUTS:None
+ * RETURN VALUE: return 0 for success, -1 if the filesystem is full
+ * SIDE EFFECTS: links the block from the boot block or from the last directory block
+ */
+static int32_t add_dirblock(uint32_t index){
+    int32_t block = alloc_metablock();
+    dirblock_t* dir;
+    if(block == -1 || (dir = (dirblock_t*)meta_block(block)) == NULL){
+        return -1;
+    }
+    dir->next = FS_NO_BLOCK;
+    if(index == dir_entries_num_bootlock){
+        bootblock_ptr->dir_block = block;
+        mark_dirty(0);
+    }else if((dir = (dirblock_t*)meta_block(chain_block(index - 1))) != NULL){
+        dir->next = block;
+        meta_block_dirty(chain_block(index - 1));
+    }else{
+        free_metablock(block);
+        return -1;
+    }
+    return 0;
+}
+
+/* 
+ *write_block
+ * DESCRIPTION: change bytes of one block of a file. An image in memory is changed in place
+ *              along with the cached copy; on disk the cached copy is the only copy until it
+ *              is written back.
+ * INPUTS: inode -- number of inode
+ *         block -- index of the block within the file
+ *         offset -- byte offset within the block
+ *         data -- bytes to write, NULL to write zeros
+ *         length -- number of bytes
+ *         fresh -- 1 if the data block was just allocated, so its old contents do not matter
+ * OUTPUTS:None
+ * RETURN VALUE: return 0 for success, return -1 if the block could not be read
+ * SIDE EFFECTS: marks the block dirty
+ */
+static int32_t write_block(uint32_t inode, uint32_t block, uint32_t offset, const uint8_t* data, uint32_t length, uint32_t fresh){
+    uint8_t* page;
+    if(datablock_base != NULL){
+        page = get_datablock(inode, block);
+    }else if(fresh || (offset == 0 && length == BLOCK_SIZE)){
+        page = pcache_zero(inode, block);  // nothing on disk worth reading
+    }else{
+        page = pcache_get(inode, block);
+    }
+    if(page == NULL){
+        return -1;
+    }
+    if(data != NULL){
+        memcpy(page + offset, data, length);
+    }else{
+        memset(page + offset, 0, length);
+    }
+    if(datablock_base != NULL){
+        mark_dirty(FS_DATA_BLOCK(get_datablock_num(inode, block)));
+    }else{
+        pcache_mark_dirty(inode, block);
+    }
+    return 0;
+}
+
+/* 
+ *write_data
+ * DESCRIPTION: write bytes to a file at an offset, allocating data blocks as the file grows.
+ *              A gap between the end of the file and the offset reads as zeros.
+ * INPUTS: inode, offset, buf, length
+ * OUTPUTS:None
+ * RETURN VALUE: return the number of bytes written, -1 if nothing could be written
+ * SIDE EFFECTS: the inode is marked dirty once per call, so a large append costs one inode
+ *               writeback at the next fs_sync, not one per block
+ */
+int32_t write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length){
+    uint32_t pos = offset, block, run_bytes, old_length, fresh;
+    uint32_t written = 0;
+    int32_t data_block;
+    inode_t* inode_ptr;
+    if(!buf) return -1;
+    if(inode >= bootblock_ptr->num_inodes || inode >= FS_MAX_INODES) return -1;
+    inode_ptr = (inode_t*)((void*)bootblock_ptr + BLOCK_SIZE) + inode;
+    sched_hold();   // the cache and the inode must not change under us
+    if(pos > inode_ptr->length && file_resize(inode, pos) == -1){
+        sched_release();
+        return -1;  // the gap before pos reads as zeros
+    }
+    while(written < length){
+        block = pos / BLOCK_SIZE;
+        if(block >= fs_max_file_blocks()){
+            break;  // the inode has no more block slots
+        }
+        fresh = 0;
+        if(pos % BLOCK_SIZE == 0 && pos >= inode_ptr->length){
+            if((data_block = alloc_datablock()) == -1){
+                break;  // out of space
+            }
+            if(set_datablock_num(inode, block, data_block) == -1){
+                block_used[data_block >> 5] &= ~(1 << (data_block & 31));
+                break;  // no room for an indirect block
+            }
+            extent_num[inode] = 0;  // the runs are stale until the next fs_sync
+            fresh = 1;
+        }
+        run_bytes = BLOCK_SIZE - pos % BLOCK_SIZE;
+        if(run_bytes > length - written){
+            run_bytes = length - written;
+        }
+        // grow first, the block must be part of the file to be written
+        old_length = inode_ptr->length;
+        if(pos + run_bytes > inode_ptr->length){
+            inode_ptr->length = pos + run_bytes;
+        }
+        if(write_block(inode, block, pos % BLOCK_SIZE, buf + written, run_bytes, fresh) == -1){
+            if(fresh){
+                free_file_blocks(inode, block, block + 1);  // while the block is still part of the file
+            }
+            inode_ptr->length = old_length;
+            break;
+        }
+        pos += run_bytes;
+        written += run_bytes;
+    }
+    if(written > 0){
+        mark_dirty(FS_INODE_BLOCK(inode));
+    }
+    sched_release();
+    return (written == 0 && length > 0) ? -1 : (int32_t)written;
+}
+
 /* 
  *file_write
- * DESCRIPTION: write to the file
- * INPUTS: idx, buf, nbytes
+ * DESCRIPTION: write to the file at the fd's position
+ * INPUTS: fd, buf, nbytes
  * OUTPUTS:None
- * RETURN VALUE: return -1
- * SIDE EFFECTS: nothing because we are using the read-only filesystem
+ * RETURN VALUE: return the number of bytes written, -1 if nothing could be written
+ * SIDE EFFECTS: advances the fd's position
  */
 int32_t file_write(int32_t fd, const void* buf, int32_t nbytes){
-    return -1;
+    int32_t written;
+    if(!buf || nbytes < 0) return -1;
+    fd_t* file = &get_curr_pcb()->fd_arr[fd];
+    written = write_data(file->inode, file->file_pos, buf, nbytes);
+    if(written > 0){
+        file->file_pos += written;
+    }
+    return written;
+}
+
+/* 
+ *mark_dirty
+ * DESCRIPTION: remember that a block of the image changed and must be written back
+ * INPUTS: block -- image block number, 0 is the boot block
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void mark_dirty(uint32_t block){
+    if(block < FS_MAX_IMAGE_BLOCKS){
+        block_dirty[block >> 5] |= 1 << (block & 31);
+    }
+}
+
+/* 
+ *alloc_datablock
+ * DESCRIPTION: take a free data block from the bitmap and zero it. When every block of the
+ *              image is in use the image grows by one block. A block on disk is zeroed by
+ *              whoever first writes it, see write_block.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: the data block number, -1 if the filesystem is full
+ * SIDE EFFECTS: may raise num_datablocks in the boot block
+ */
+int32_t alloc_datablock(){
+    uint32_t i;
+    for(i = 0; i < max_datablocks; i++){
+        if(block_used[i >> 5] == 0xFFFFFFFF && (i & 31) == 0){
+            i += 31;    // a full word
+            continue;
+        }
+        if(!(block_used[i >> 5] & (1 << (i & 31)))){
+            break;
+        }
+    }
+    if(i >= max_datablocks){
+        return -1;
+    }
+    if(i >= bootblock_ptr->num_datablocks){
+        bootblock_ptr->num_datablocks = i + 1;  // the scan is in order, so this is the next block past the end
+        mark_dirty(0);
+    }
+    block_used[i >> 5] |= 1 << (i & 31);
+    if(datablock_base != NULL){
+        memset(datablock_base + i, 0, BLOCK_SIZE);
+    }
+    return i;
+}
+
+/* 
+ *fs_free_blocks
+ * DESCRIPTION: count the data blocks alloc_datablock may still hand out
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: the number of free data blocks
+ * SIDE EFFECTS: None
+ */
+uint32_t fs_free_blocks(){
+    uint32_t i, count = 0;
+    for(i = 0; i < max_datablocks; i++){
+        if(!(block_used[i >> 5] & (1 << (i & 31)))){
+            count++;
+        }
+    }
+    return count;
+}
+
+/* 
+ *file_resize
+ * DESCRIPTION: set the length of a file, freeing blocks past the new end or adding zeroed ones
+ * INPUTS: inode -- number of inode
+ *         length -- new length in bytes
+ * OUTPUTS:None
+ * RETURN VALUE: return 0 for success, return -1 for failure, including a shrink that would
+ *               free a block some process has mapped with mmap
+ * SIDE EFFECTS: the bytes between the old and new end read as zeros
+ */
+int32_t file_resize(uint32_t inode, uint32_t length){
+    inode_t* inode_ptr;
+    uint32_t block, old_length, old_blocks, new_blocks;
+    int32_t data_block;
+    int32_t failed = 0;
+    if(inode >= bootblock_ptr->num_inodes || inode >= FS_MAX_INODES) return -1;
+    new_blocks = length / BLOCK_SIZE + (length % BLOCK_SIZE != 0);
+    if(new_blocks > fs_max_file_blocks()) return -1;
+    inode_ptr = (inode_t*)((void*)bootblock_ptr + BLOCK_SIZE) + inode;
+    old_length = inode_ptr->length;
+    old_blocks = old_length / BLOCK_SIZE + (old_length % BLOCK_SIZE != 0);
+    sched_hold();
+    if(length < old_length){
+        // a program may still read the blocks through mmap, they cannot be handed out again
+        for(block = new_blocks; block < old_blocks; block++){
+            if((data_block = get_datablock_num(inode, block)) != -1 && data_block < FS_MAX_DATABLOCKS && block_maps[data_block]){
+                sched_release();
+                return -1;
+            }
+        }
+        free_file_blocks(inode, new_blocks, old_blocks);
+        // clear past the new end so a later grow reads zeros
+        if(length % BLOCK_SIZE){
+            failed = write_block(inode, new_blocks - 1, length % BLOCK_SIZE, NULL, BLOCK_SIZE - length % BLOCK_SIZE, 0);
+        }
+        inode_ptr->length = length;
+        pcache_invalidate(inode, new_blocks);  // the freed blocks may be handed out again
+    }else if(length > old_length){
+        if(old_length % BLOCK_SIZE){
+            failed = write_block(inode, old_blocks - 1, old_length % BLOCK_SIZE, NULL, BLOCK_SIZE - old_length % BLOCK_SIZE, 0);
+        }
+        // the file grows a block at a time, so a failure keeps the blocks that were added
+        for(block = old_blocks; block < new_blocks; block++){
+            if((data_block = alloc_datablock()) == -1){
+                break;
+            }
+            if(set_datablock_num(inode, block, data_block) == -1){
+                block_used[data_block >> 5] &= ~(1 << (data_block & 31));
+                break;
+            }
+            inode_ptr->length = (block + 1) * BLOCK_SIZE;
+            write_block(inode, block, 0, NULL, BLOCK_SIZE, 1);
+        }
+        if(block == new_blocks){
+            inode_ptr->length = length;
+        }
+    }
+    extent_num[inode] = 0;  // the runs are stale until the next fs_sync
+    mark_dirty(FS_INODE_BLOCK(inode));
+    sched_release();
+    return (inode_ptr->length == length && failed == 0) ? 0 : -1;
+}
+
+/* 
+ *file_create
+ * DESCRIPTION: create an empty regular file
+ * INPUTS: fname
+ * OUTPUTS:None
+ * RETURN VALUE: return 0 for success, return -1 if the name is taken or invalid, or no
+ *               directory entry or inode is free
+ * SIDE EFFECTS: adds a directory entry to the boot block
+ */
+int32_t file_create(const uint8_t* fname){
+    dentry_t dentry;
+    dentry_t* entry;
+    uint32_t i, inode, len, index;
+    uint8_t inode_taken[FS_MAX_INODES];
+    len = strlen((int8_t*)fname);
+    if(len == 0 || len > filename_len || read_dentry_by_name(fname, &dentry) == 0){
+        return -1;
+    }
+    index = bootblock_ptr->num_dir_entries;
+    if(!fs_extended && index >= dir_entries_num_bootlock){
+        return -1;
+    }
+    sched_hold();
+    // an inode is free when no regular file names it
+    memset(inode_taken, 0, sizeof(inode_taken));
+    for(i = 0; i < index && (entry = dentry_at(i)) != NULL; i++){
+        if(entry->filetype == 2 && entry->inode_num < FS_MAX_INODES){
+            inode_taken[entry->inode_num] = 1;
+        }
+    }
+    for(inode = 0; inode < bootblock_ptr->num_inodes && inode < FS_MAX_INODES && inode_taken[inode]; inode++);
+    if(inode == bootblock_ptr->num_inodes || inode == FS_MAX_INODES || (index >= dir_entries_num_bootlock
+            && (index - dir_entries_num_bootlock) % dir_entries_num_bootlock == 0 && add_dirblock(index) == -1)){
+        sched_release();
+        return -1;
+    }
+    ((inode_t*)((void*)bootblock_ptr + BLOCK_SIZE) + inode)->length = 0;
+    extent_num[inode] = 0;
+    pcache_invalidate(inode, 0);    // left over from whoever had the inode before
+    mark_dirty(FS_INODE_BLOCK(inode));
+    bootblock_ptr->num_dir_entries++;
+    entry = dentry_at(index);
+    memset(entry, 0, sizeof(dentry_t));
+    memcpy(entry->filename, fname, len);
+    entry->filetype = 2;    // regular file
+    entry->inode_num = inode;
+    if(index >= dir_entries_num_bootlock){
+        meta_block_dirty(chain_block(index));
+    }
+    mark_dirty(0);
+    sched_release();
+    return 0;
+}
+
+/* 
+ *fs_sync
+ * DESCRIPTION: write every dirty block of the image back through fs_writeback. With no
+ *              writeback set the image only lives in memory, and syncing just rebuilds the
+ *              extents that writes left stale. An image on disk also gets the dirty data
+ *              blocks of the page cache, and all of the writes go out as one sweep.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: the number of blocks written back, -1 if the writeback failed
+ * SIDE EFFECTS: clears the dirty bits of the blocks written
+ */
+int32_t fs_sync(){
+    uint32_t block;
+    int32_t count = 0, written;
+    uint32_t num_blocks = 1 + bootblock_ptr->num_inodes + bootblock_ptr->num_datablocks;
+    sched_hold();
+    for(block = 0; block < num_blocks && block < FS_MAX_IMAGE_BLOCKS; block++){
+        if(!(block_dirty[block >> 5] & (1 << (block & 31)))){
+            continue;
+        }
+        if(fs_writeback != NULL && fs_writeback(block, (uint8_t*)bootblock_ptr + block * BLOCK_SIZE) == -1){
+            sched_release();
+            return -1;
+        }
+        block_dirty[block >> 5] &= ~(1 << (block & 31));
+        count++;
+    }
+    if(datablock_base == NULL){
+        // runs the queue, so the boot block and inode writes queued above go out with the data
+        written = pcache_flush();
+        for(block = 0; block <= bootblock_ptr->num_inodes; block++){
+            if(meta_req[block].dir == BLK_WRITE && meta_req[block].status == BLK_ERROR){
+                meta_req[block].status = BLK_DONE;
+                mark_dirty(block);      // try again at the next fs_sync
+                written = -1;
+            }
+        }
+        if(written == -1){
+            sched_release();
+            return -1;
+        }
+        count += written;
+    }
+    build_extents();
+    sched_release();
+    return count;
+}
+
+/* 
+ *get_datablock_num
+ * DESCRIPTION: find the data block holding one block of a file
+ * INPUTS: inode -- number of inode
+ *         block -- index of the block within the file
+ * OUTPUTS: None
+ * RETURN VALUE: the data block number, -1 if the inode or block is out of range
+ * SIDE EFFECTS: None
+ */
+int32_t get_datablock_num(uint32_t inode, uint32_t block){
+    inode_t* inode_ptr;
+    uint32_t* table;
+    if(inode == FS_META_INODE){
+        // indirect and directory blocks are cached by their data block number
+        return (block < bootblock_ptr->num_datablocks) ? (int32_t)block : -1;
+    }
+    if(inode >= bootblock_ptr->num_inodes){
+        return -1;      // invalid inode number
+    }
+    inode_ptr = (inode_t*)((void*)bootblock_ptr + BLOCK_SIZE) + inode;
+    if(block >= inode_ptr->length / BLOCK_SIZE + (inode_ptr->length % BLOCK_SIZE != 0) || block >= fs_max_file_blocks()){
+        return -1;      // past the last block of the file
+    }
+    if(!fs_extended || block < FS_DIRECT_V2){
+        return inode_ptr->block_num[block];
+    }
+    block -= FS_DIRECT_V2;
+    if(block < FS_PTRS_PER_BLOCK){
+        table = (uint32_t*)meta_block(inode_ptr->block_num[FS_INDIRECT_SLOT]);
+    }else{
+        block -= FS_PTRS_PER_BLOCK;
+        if((table = (uint32_t*)meta_block(inode_ptr->block_num[FS_DINDIRECT_SLOT])) == NULL){
+            return -1;
+        }
+        table = (uint32_t*)meta_block(table[block / FS_PTRS_PER_BLOCK]);
+        block %= FS_PTRS_PER_BLOCK;
+    }
+    return (table == NULL) ? -1 : (int32_t)table[block];
+}
+
+/* 
+ *fs_max_file_blocks
+ * DESCRIPTION: get the most blocks one file may have, which depends on the format mounted
+ * INPUTS: None
+ * OUTPUTS: None
+ * RETURN VALUE: the number of blocks
+ * SIDE EFFECTS: None
+ */
+uint32_t fs_max_file_blocks(){
+    return fs_extended ? FS_MAX_BLOCKS_V2 : inode_maxnum_datablock;
+}
+
+/* 
+ *get_datablock
+ * DESCRIPTION: find the data block holding one block of a file in the filesystem image
+ * INPUTS: inode -- number of inode
+ *         block -- index of the block within the file
+ * OUTPUTS: None
+ * RETURN VALUE: address of the data block, NULL if the inode or block is out of range or the
+ *               image is on disk, where data blocks are only reachable through the page cache
+ * SIDE EFFECTS: None
+ */
+uint8_t* get_datablock(uint32_t inode, uint32_t block){
+    int32_t data_block = get_datablock_num(inode, block);
+    if(data_block == -1 || datablock_base == NULL){
+        return NULL;
+    }
+    return (uint8_t*)(datablock_base + data_block);
+}
+
+/* 
+ *fs_map_block
+ * DESCRIPTION: count a mapping of a data block of a resident image, so file_resize does not
+ *              free the block while a program can still read it. Other addresses, such as
+ *              bounce pages, are not counted.
+ * INPUTS: addr -- address of the 4KB page being mapped
+ * OUTPUTS: None
+ * RETURN VALUE: 0 for success, -1 if the block is mapped too many times already
+ * SIDE EFFECTS: None
+ */
+int32_t fs_map_block(const uint8_t* addr){
+    uint32_t data_block = (uint32_t)(addr - (uint8_t*)datablock_base) / BLOCK_SIZE;
+    if(datablock_base == NULL || addr < (uint8_t*)datablock_base || data_block >= FS_MAX_DATABLOCKS){
+        return 0;
+    }
+    if(block_maps[data_block] == 0xFF){
+        return -1;
+    }
+    block_maps[data_block]++;
+    return 0;
+}
+
+/* 
+ *fs_unmap_block
+ * DESCRIPTION: drop a mapping counted by fs_map_block
+ * INPUTS: addr -- address of the 4KB page that was mapped
+ * OUTPUTS: None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void fs_unmap_block(const uint8_t* addr){
+    uint32_t data_block = (uint32_t)(addr - (uint8_t*)datablock_base) / BLOCK_SIZE;
+    if(datablock_base == NULL || addr < (uint8_t*)datablock_base || data_block >= FS_MAX_DATABLOCKS){
+        return;
+    }
+    if(block_maps[data_block] > 0){
+        block_maps[data_block]--;
+    }
 }
 
 /* 
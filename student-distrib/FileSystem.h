@@ -1,4 +1,4 @@
-#ifndef _FILESTSTEM_H
+#ifndef _FILESYSTEM_H
 #define _FILESYSTEM_H
 
 #include "types.h"
@@ -10,6 +10,27 @@
 #define dir_entries_num_bootlock    63
 #define inode_maxnum_datablock      1023
 #define BLOCK_SIZE                  4096
+#define FS_MAX_INODES               256     // inodes that can be written, and that an image on disk may have
+#define EXTENT_INODE_MAX            FS_MAX_INODES   // inodes with an extent list
+#define EXTENT_POOL_SIZE            4096    // runs shared by all inodes
+#define FS_MAX_DATABLOCKS           65536   // most data blocks the image may grow to, 256MB
+#define FS_MAX_IMAGE_BLOCKS         (1 + FS_MAX_INODES + FS_MAX_DATABLOCKS)
+#define FS_INODE_BLOCK(inode)       (1 + (inode))                                  // image block of an inode
+#define FS_DATA_BLOCK(block)        (1 + bootblock_ptr->num_inodes + (block))      // image block of a data block
+
+/* Extended format, version 2. The original format has zeros where the boot block keeps
+ * FS_MAGIC. Version 2 keeps the last two block slots of an inode for a single and a double
+ * indirect block, each a data block of FS_PTRS_PER_BLOCK block numbers, and continues the
+ * directory past the boot block in a chain of directory blocks. */
+#define FS_MAGIC                    0x46313933      // "391F"
+#define FS_VERSION                  2               // newest version this kernel mounts
+#define FS_NO_BLOCK                 0xFFFFFFFF      // end of a directory chain
+#define FS_DIRECT_V2                1021            // direct block slots of a version 2 inode
+#define FS_INDIRECT_SLOT            1021            // slot of the single indirect block
+#define FS_DINDIRECT_SLOT           1022            // slot of the double indirect block
+#define FS_PTRS_PER_BLOCK           (BLOCK_SIZE / 4)
+#define FS_MAX_BLOCKS_V2            (FS_DIRECT_V2 + FS_PTRS_PER_BLOCK + FS_PTRS_PER_BLOCK * FS_PTRS_PER_BLOCK)
+#define FS_META_INODE               0x7FFFFFFF      // page cache key of indirect and directory blocks, by data block
 
 
 /*------necessary structs------*/
@@ -29,30 +50,76 @@ typedef struct inode{
 
 // struct for boot block (first block in filesystem)
 typedef struct bootblock{
-    uint32_t num_dir_entries;
+    uint32_t num_dir_entries;       // entries in the boot block and the directory chain together
     uint32_t num_inodes;
     uint32_t num_datablocks;
-    uint8_t reserved[reserved_bootblock];
+    uint32_t magic;                 // FS_MAGIC in the extended format, 0 in the original one
+    uint32_t version;               // format version when magic is set
+    uint32_t dir_block;             // first data block of the directory chain, FS_NO_BLOCK if none
+    uint8_t reserved[reserved_bootblock - 12];
     dentry_t dir_entries[dir_entries_num_bootlock];
 }bootblock_t;
 
+// struct for a directory block, holding the entries past the boot block in version 2
+typedef struct dirblock{
+    uint32_t next;                  // next data block of the chain, FS_NO_BLOCK at the end
+    uint8_t reserved[reserved_bootblock + 8];
+    dentry_t dir_entries[dir_entries_num_bootlock];
+}dirblock_t;
+
+// struct for one entry returned by getdents
+typedef struct dirent{
+    uint8_t filename[filename_len];
+    uint32_t filetype;
+    uint32_t inode_num;
+    uint32_t length;        // file size in bytes, 0 for the directory and rtc
+}dirent_t;
+
+// struct filled by stat and fstat
+typedef struct stat{
+    uint32_t length;        // file size in bytes, 0 for the directory and rtc
+    uint32_t filetype;      // 0 rtc, 1 directory, 2 regular file
+    uint32_t inode_num;
+}stat_t;
+
 // struct for data blocks
 typedef struct datablock{
     uint8_t data_arr[BLOCK_SIZE];
 }datablock_t;
 
+// run of physically consecutive data blocks in one file
+typedef struct extent{
+    uint32_t file_block;    // first block of the run within the file
+    uint32_t data_block;    // data block number holding file_block
+    uint32_t count;         // number of blocks in the run
+}extent_t;
+
 /*------global variables------*/
 // pointer to the first block (boot block), indicating the starting address of the file system
 bootblock_t* bootblock_ptr;
-// current file open
-dentry_t curfile;
-// current directory 
-dentry_t curdirectory;
-// current directory index, used by directory read
-uint32_t cur_directory_read_idx;
+// hands one dirty block of the image to backing storage, NULL while the image only lives in memory.
+// A disk only queues the write, and fs_sync runs the queue.
+int32_t (*fs_writeback)(uint32_t block, const uint8_t* data);
+// first data block of the image, set by filesystem_init, NULL when the image is on disk
+datablock_t* datablock_base;
+// runs of every inode, built by filesystem_init
+extent_t extent_pool[EXTENT_POOL_SIZE];
+// index of the first run of an inode in extent_pool
+uint32_t extent_first[EXTENT_INODE_MAX];
+// number of runs of an inode, 0 if it has none
+uint32_t extent_num[EXTENT_INODE_MAX];
 
 // initialize file system
-int32_t filesystem_init(uint32_t starting_addr);
+int32_t filesystem_init(uint32_t starting_addr, uint32_t limit_addr);
+
+// initialize file system from an image on disk, keeping its inodes and the page cache in the memory given
+int32_t filesystem_init_disk(uint32_t mem_start, uint32_t mem_limit);
+
+// build the free-block bitmap from the inodes of regular files
+void build_free_map();
+
+// build the extent lists of all inodes
+void build_extents();
 
 // helper function for file read --- reading the filename
 int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry);
@@ -72,6 +139,9 @@ int32_t file_close(int32_t idx);
 // write to a file
 int32_t file_write();
 
+// write bytes to a file at an offset, growing it as needed
+int32_t write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length);
+
 // read a file
 int32_t file_read();
 
@@ -87,7 +157,46 @@ int32_t directory_open();
 // read a directory
 int32_t directory_read();
 
+// read as many directory entries as fit, with type, inode and size
+int32_t directory_getdents(int32_t fd, void* buf, int32_t nbytes);
+
 // get the size of a file (in bytes)
 extern uint32_t get_filelen(uint32_t inode_num);
 
-#endif /* _FILESTSTEM_H */
+// get the data block number of one block of a file
+int32_t get_datablock_num(uint32_t inode, uint32_t block);
+
+// most blocks one file may have in the mounted format
+uint32_t fs_max_file_blocks();
+
+// get the address of one data block of a file in the image
+extern uint8_t* get_datablock(uint32_t inode, uint32_t block);
+
+// count an mmap page mapping a data block of a resident image
+int32_t fs_map_block(const uint8_t* addr);
+
+// drop a mapping counted by fs_map_block
+void fs_unmap_block(const uint8_t* addr);
+
+// count the blocks left in the run holding a file block
+uint32_t run_length(uint32_t inode, uint32_t block);
+
+// mark a block of the image as changed
+void mark_dirty(uint32_t block);
+
+// take a zeroed data block from the free-block bitmap
+int32_t alloc_datablock();
+
+// count the data blocks still free
+uint32_t fs_free_blocks();
+
+// set the length of a file, freeing or adding blocks
+int32_t file_resize(uint32_t inode, uint32_t length);
+
+// create an empty regular file
+int32_t file_create(const uint8_t* fname);
+
+// write the dirty blocks of the image back
+int32_t fs_sync();
+
+#endif /* _FILESYSTEM_H */
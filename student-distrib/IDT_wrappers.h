@@ -1,6 +1,5 @@
 #ifndef INTERRUPT_H
 #define INTERRUPT_H
-#define ASM 1
 
 #include "x86_desc.h"
 
@@ -32,7 +31,17 @@ void keyboard_handler(void);
 void rtc_handler(void);
 //interrupt handler for PIT
 void pit_handler(void);
+//interrupt handler for the ATA disk
+void ata_handler(void);
+//interrupt handler for the COM1 serial port
+void serial_handler(void);
+//spurious interrupt of the local APIC
+void apic_spurious_handler(void);
 //interrupt handler for system calls
 void systemcall_handler(void);
+//sysenter entry for system calls
+void sysenter_handler(void);
+//local APIC timer of the processors other than the booting one
+void smp_timer_handler(void);
 
 #endif /* INTERRUPT_H */
@@ -0,0 +1,493 @@
+#include "apic.h"
+#include "lib.h"
+#include "i8259.h"
+#include "i8253.h"
+#include "paging.h"
+
+#define ISA_IRQ_NUM             16
+#define EBDA_SEGMENT_PTR        0x40E       // BIOS data area word holding the EBDA segment
+#define BASE_MEM_KB_PTR         0x413       // BIOS data area word holding the base memory size
+#define BIOS_ROM_START          0xE0000
+#define BIOS_ROM_END            0x100000
+#define IMCR_SELECT             0x22        // routes the 8259 past the APIC on old MP boards
+#define IMCR_DATA               0x23
+
+uint32_t apic_on = 0;
+uint32_t apic_cpu_num = 0;
+uint8_t apic_cpu_ids[APIC_MAX_CPUS];
+
+static uint32_t lapic_base = APIC_DEFAULT_BASE;
+static uint32_t ioapic_base = 0;                // 0 until one is found
+static uint32_t ioapic_gsi_base = 0;            // first global interrupt of the IOAPIC
+static uint32_t ioapic_inputs = 0;
+static uint32_t irq_gsi[ISA_IRQ_NUM];           // global interrupt of each ISA IRQ
+static uint32_t irq_flags[ISA_IRQ_NUM];         // its IOAPIC_LEVEL and IOAPIC_LOW bits
+static uint32_t imcr_present = 0;               // the MP tables ask for the IMCR to be switched
+static uint32_t apic_slice_count = 0;           // timer counts in 1/PIT_HZ second
+static uint32_t apic_timer_count = 0;           // what the timer counts down from now
+
+static inline uint32_t lapic_read(uint32_t reg){
+    return *(volatile uint32_t*)(lapic_base + reg);
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value){
+    *(volatile uint32_t*)(lapic_base + reg) = value;
+}
+
+static inline uint32_t ioapic_read(uint32_t reg){
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_INDEX) = reg;
+    return *(volatile uint32_t*)(ioapic_base + IOAPIC_DATA);
+}
+
+static inline void ioapic_write(uint32_t reg, uint32_t value){
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_INDEX) = reg;
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_DATA) = value;
+}
+
+/*
+ *table_sum
+ * DESCRIPTION: add up the bytes of a firmware table, which sum to 0 when it is intact
+ * INPUTS: p -- the table
+ *         len -- its length in bytes
+ * OUTPUTS:None
+ * RETURN VALUE: the low byte of the sum
+ * SIDE EFFECTS: None
+ */
+static uint8_t table_sum(const uint8_t* p, uint32_t len){
+    uint8_t sum = 0;
+    while(len-- > 0){
+        sum += *p++;
+    }
+    return sum;
+}
+
+/*
+ *table_scan
+ * DESCRIPTION: look for a signature on the 16 byte boundaries of a memory range
+ * INPUTS: start, end -- the range
+ *         sig -- the signature
+ *         len -- its length
+ *         size -- bytes of the structure that must sum to 0, 0 to read it from byte 8
+ *                 in 16 byte units as the MP floating pointer does
+ * OUTPUTS:None
+ * RETURN VALUE: the structure, NULL if it is not there
+ * SIDE EFFECTS: None
+ */
+static const uint8_t* table_scan(uint32_t start, uint32_t end, const int8_t* sig, uint32_t len, uint32_t size){
+    const uint8_t* p;
+    for(p = (const uint8_t*)start; (uint32_t)p + len <= end; p += 16){
+        if(strncmp((const int8_t*)p, sig, len) == 0 &&
+           table_sum(p, size != 0 ? size : p[8] * 16) == 0){
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/*
+ *table_find
+ * DESCRIPTION: look for a signature where the firmware leaves its pointers: the first KB
+ *              of the EBDA, the last KB of base memory and the BIOS ROM
+ * INPUTS: sig, len, size -- as for table_scan
+ * OUTPUTS:None
+ * RETURN VALUE: the structure, NULL if it is not there
+ * SIDE EFFECTS: None
+ */
+static const uint8_t* table_find(const int8_t* sig, uint32_t len, uint32_t size){
+    const uint8_t* p = NULL;
+    uint32_t ebda = *(uint16_t*)EBDA_SEGMENT_PTR << 4;
+    uint32_t base_end = *(uint16_t*)BASE_MEM_KB_PTR * 1024;
+    if(ebda != 0){
+        p = table_scan(ebda, ebda + 1024, sig, len, size);
+    }
+    if(p == NULL && base_end >= 1024){
+        p = table_scan(base_end - 1024, base_end, sig, len, size);
+    }
+    if(p == NULL){
+        p = table_scan(BIOS_ROM_START, BIOS_ROM_END, sig, len, size);
+    }
+    return p;
+}
+
+/*
+ *inti_flags
+ * DESCRIPTION: turn the polarity and trigger bits of an MADT override or MP interrupt
+ *              entry, which share their encoding, into IOAPIC bits. ISA interrupts are
+ *              active high and edge triggered unless the entry says otherwise.
+ * INPUTS: flags -- bits 0-1 the polarity, 3 for active low; bits 2-3 the trigger, 3 for level
+ * OUTPUTS:None
+ * RETURN VALUE: IOAPIC_LOW and IOAPIC_LEVEL bits
+ * SIDE EFFECTS: None
+ */
+static uint32_t inti_flags(uint32_t flags){
+    uint32_t bits = 0;
+    if((flags & 0x3) == 0x3){
+        bits |= IOAPIC_LOW;
+    }
+    if(((flags >> 2) & 0x3) == 0x3){
+        bits |= IOAPIC_LEVEL;
+    }
+    return bits;
+}
+
+/*
+ *add_cpu
+ * DESCRIPTION: remember an enabled processor, once
+ * INPUTS: id -- its local APIC id
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+static void add_cpu(uint8_t id){
+    uint32_t i;
+    for(i = 0; i < apic_cpu_num; i++){
+        if(apic_cpu_ids[i] == id){
+            return;
+        }
+    }
+    if(apic_cpu_num < APIC_MAX_CPUS){
+        apic_cpu_ids[apic_cpu_num++] = id;
+    }
+}
+
+/*
+ *madt_parse
+ * DESCRIPTION: read the processors, the IOAPIC and the ISA overrides from the ACPI MADT,
+ *              found through the RSDP and the RSDT
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: 0 if an IOAPIC was found, -1 otherwise
+ * SIDE EFFECTS: fills the tables of this file
+ */
+static int32_t madt_parse(){
+    const uint8_t* rsdp = table_find("RSD PTR ", 8, 20);
+    const uint8_t *rsdt, *madt = NULL, *p, *end;
+    uint32_t i, n;
+    if(rsdp == NULL){
+        return -1;
+    }
+    rsdt = (const uint8_t*)*(uint32_t*)(rsdp + 16);
+    if(strncmp((const int8_t*)rsdt, "RSDT", 4) != 0 || table_sum(rsdt, *(uint32_t*)(rsdt + 4)) != 0){
+        return -1;
+    }
+    n = (*(uint32_t*)(rsdt + 4) - 36) / 4;
+    for(i = 0; i < n && madt == NULL; i++){
+        p = (const uint8_t*)*(uint32_t*)(rsdt + 36 + 4 * i);
+        if(strncmp((const int8_t*)p, "APIC", 4) == 0 && table_sum(p, *(uint32_t*)(p + 4)) == 0){
+            madt = p;
+        }
+    }
+    if(madt == NULL){
+        return -1;
+    }
+    lapic_base = *(uint32_t*)(madt + 36);
+    end = madt + *(uint32_t*)(madt + 4);
+    for(p = madt + 44; p + 2 <= end && p[1] != 0; p += p[1]){
+        if(p[0] == 0 && (*(uint32_t*)(p + 4) & 0x1)){
+            add_cpu(p[3]);                              // an enabled processor
+        }else if(p[0] == 1 && ioapic_base == 0){
+            ioapic_base = *(uint32_t*)(p + 4);          // the first IOAPIC, which takes the ISA lines
+            ioapic_gsi_base = *(uint32_t*)(p + 8);
+        }else if(p[0] == 2 && p[2] == 0 && p[3] < ISA_IRQ_NUM){
+            irq_gsi[p[3]] = *(uint32_t*)(p + 4);        // an ISA IRQ wired to another input
+            irq_flags[p[3]] = inti_flags(*(uint16_t*)(p + 8));
+        }
+    }
+    return ioapic_base != 0 ? 0 : -1;
+}
+
+/*
+ *mp_parse
+ * DESCRIPTION: read the processors, the IOAPIC and the ISA interrupt wiring from the MP
+ *              configuration table, for machines without ACPI
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: 0 if an IOAPIC was found, -1 otherwise
+ * SIDE EFFECTS: fills the tables of this file
+ */
+static int32_t mp_parse(){
+    const uint8_t* mpfp = table_find("_MP_", 4, 0);
+    const uint8_t *cfg, *p;
+    uint32_t i, n, isa_buses = 0;
+    if(mpfp == NULL){
+        return -1;
+    }
+    imcr_present = mpfp[12] & 0x80;
+    cfg = (const uint8_t*)*(uint32_t*)(mpfp + 4);
+    if(cfg == NULL){
+        // one of the default configurations: the standard addresses and wiring
+        ioapic_base = IOAPIC_DEFAULT_BASE;
+        return 0;
+    }
+    if(strncmp((const int8_t*)cfg, "PCMP", 4) != 0 || table_sum(cfg, *(uint16_t*)(cfg + 4)) != 0){
+        return -1;
+    }
+    lapic_base = *(uint32_t*)(cfg + 0x24);
+    n = *(uint16_t*)(cfg + 0x22);
+    p = cfg + 0x2C;
+    for(i = 0; i < n; i++){
+        if(p[0] == 0){
+            if(p[3] & 0x1){
+                add_cpu(p[1]);
+            }
+            p += 20;
+            continue;
+        }
+        if(p[0] == 1 && strncmp((const int8_t*)p + 2, "ISA", 3) == 0 && p[1] < 32){
+            isa_buses |= 1 << p[1];
+        }else if(p[0] == 2 && (p[3] & 0x1) && ioapic_base == 0){
+            ioapic_base = *(uint32_t*)(p + 4);
+        }else if(p[0] == 3 && p[1] == 0 && p[4] < 32 && (isa_buses & (1 << p[4])) && p[5] < ISA_IRQ_NUM){
+            irq_gsi[p[5]] = p[7];                       // the pin of the IOAPIC, its inputs start at 0
+            irq_flags[p[5]] = inti_flags(*(uint16_t*)(p + 2));
+        }else if(p[0] > 4){
+            break;                                      // an entry of unknown length
+        }
+        p += 8;
+    }
+    return ioapic_base != 0 ? 0 : -1;
+}
+
+/*
+ *apic_probe
+ * DESCRIPTION: find the local APIC and an IOAPIC in the ACPI MADT or else the MP tables.
+ *              Both live in memory that paging does not map, so this runs before it.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: 0 if both were found, -1 to stay with the 8259
+ * SIDE EFFECTS: prints what it found
+ */
+int32_t apic_probe(){
+    uint32_t i;
+    uint8_t bsp;
+    if(!(cpuid_edx(1) & (1 << CPUID_APIC_BIT))){
+        printf("No local APIC, using the 8259\n");
+        return -1;
+    }
+    for(i = 0; i < ISA_IRQ_NUM; i++){
+        irq_gsi[i] = i;
+        irq_flags[i] = 0;
+    }
+    if(madt_parse() != 0 && mp_parse() != 0){
+        printf("No IOAPIC in the ACPI or MP tables, using the 8259\n");
+        return -1;
+    }
+    // the booting processor goes first, it is the one reading its own id
+    bsp = *(volatile uint32_t*)(lapic_base + APIC_ID) >> 24;
+    add_cpu(bsp);
+    for(i = 0; i < apic_cpu_num && apic_cpu_ids[i] != bsp; i++);
+    apic_cpu_ids[i] = apic_cpu_ids[0];
+    apic_cpu_ids[0] = bsp;
+    printf("APIC at 0x%x, IOAPIC at 0x%x, %d processors\n", lapic_base, ioapic_base, apic_cpu_num);
+    return 0;
+}
+
+/*
+ *apic_timer_calibrate
+ * DESCRIPTION: count the local APIC timer over one tick of the PIT, which still runs at
+ *              PIT_HZ from i8253_init
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: sets apic_slice_count, leaves the timer masked
+ */
+static void apic_timer_calibrate(){
+    lapic_write(APIC_TIMER_DIVIDE, APIC_DIVIDE_16);
+    lapic_write(APIC_LVT_TIMER, APIC_LVT_MASKED | APIC_IRQ_VECTOR);
+    pit_wait_reload();
+    lapic_write(APIC_TIMER_INIT, 0xFFFFFFFF);
+    pit_wait_reload();
+    apic_slice_count = 0xFFFFFFFF - lapic_read(APIC_TIMER_CURRENT);
+    lapic_write(APIC_TIMER_INIT, 0);
+}
+
+/*
+ *apic_init
+ * DESCRIPTION: enable the local APIC, mask the 8259, give every IRQ the 8259 had enabled
+ *              to the IOAPIC on the same vector, and start the local APIC timer in place
+ *              of the PIT. Called with interrupts off, after paging is on.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: 0
+ * SIDE EFFECTS: maps the APIC registers, sets apic_on
+ */
+int32_t apic_init(){
+    uint32_t i;
+    uint64_t base;
+    map_mmio(lapic_base);
+    map_mmio(ioapic_base);
+    base = rdmsr(MSR_APIC_BASE);
+    wrmsr(MSR_APIC_BASE, (uint32_t)base | MSR_APIC_BASE_ENABLE, (uint32_t)(base >> 32));
+    lapic_write(APIC_SVR, APIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    lapic_write(APIC_TPR, 0);
+    if(imcr_present){
+        outb(0x70, IMCR_SELECT);
+        outb(0x01, IMCR_DATA);
+    }
+    ioapic_inputs = ((ioapic_read(IOAPIC_VERSION) >> 16) & 0xFF) + 1;
+    for(i = 0; i < ioapic_inputs; i++){
+        ioapic_write(IOAPIC_REDIR + 2 * i, IOAPIC_MASKED);
+    }
+    // the 8259 stays programmed but silent
+    outb(0xFF, MASTER_8259_DATA_PORT);
+    outb(0xFF, SLAVE_8259_DATA_PORT);
+    // pit_elapsed reads the local APIC timer once apic_on is set, so time it against
+    // the PIT before that
+    apic_timer_calibrate();
+    apic_on = 1;
+    // IRQ2 is the cascade and IRQ0 gives way to the local APIC timer
+    for(i = 1; i < ISA_IRQ_NUM; i++){
+        if(i != 2 && !((i < 8 ? master_mask : slave_mask) & (1 << (i & 7)))){
+            apic_enable_irq(i);
+        }
+    }
+    pit_set_hz(pit_slice_ticks * PIT_HZ);
+    return 0;
+}
+
+/*
+ *apic_init_ap
+ * DESCRIPTION: enable the local APIC of a processor other than the booting one and
+ *              start its timer at PIT_HZ on APIC_AP_TIMER_VECTOR, which only drives its
+ *              scheduling. Device interrupts all go to the booting processor.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: the first tick may come as soon as interrupts are on
+ */
+void apic_init_ap(){
+    uint64_t base = rdmsr(MSR_APIC_BASE);
+    wrmsr(MSR_APIC_BASE, (uint32_t)base | MSR_APIC_BASE_ENABLE, (uint32_t)(base >> 32));
+    lapic_write(APIC_SVR, APIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    lapic_write(APIC_TPR, 0);
+    // apic_timer_count is the booting processor's rate, this one keeps its own
+    lapic_write(APIC_TIMER_DIVIDE, APIC_DIVIDE_16);
+    lapic_write(APIC_LVT_TIMER, APIC_TIMER_PERIODIC | APIC_AP_TIMER_VECTOR);
+    lapic_write(APIC_TIMER_INIT, apic_slice_count);
+}
+
+/*
+ *apic_send_ipi
+ * DESCRIPTION: send an interprocessor interrupt and wait until the local APIC has sent it
+ * INPUTS: apic_id -- the processor it goes to
+ *         icr -- delivery mode, level and vector, the low word of the command register
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void apic_send_ipi(uint8_t apic_id, uint32_t icr){
+    lapic_write(APIC_ICR_HIGH, (uint32_t)apic_id << 24);
+    lapic_write(APIC_ICR_LOW, icr);                 // writing the low word sends it
+    while(lapic_read(APIC_ICR_LOW) & APIC_ICR_PENDING);
+}
+
+/*
+ *apic_delay_us
+ * DESCRIPTION: spin for about us microseconds, counting the local APIC timer down. It
+ *              works with interrupts off, which the boot code needs, but only once
+ *              apic_init has started the timer.
+ * INPUTS: us -- microseconds
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void apic_delay_us(uint32_t us){
+    uint32_t per_us = apic_slice_count / (1000000 / PIT_HZ);
+    uint32_t left, prev, now, step;
+    if(per_us == 0){
+        per_us = 1;
+    }
+    left = us * per_us;
+    prev = lapic_read(APIC_TIMER_CURRENT);
+    while(left > 0){
+        now = lapic_read(APIC_TIMER_CURRENT);
+        // the timer reloads from apic_timer_count when it reaches 0
+        step = now <= prev ? prev - now : prev + apic_timer_count - now;
+        left = step < left ? left - step : 0;
+        prev = now;
+    }
+}
+
+/*
+ *apic_enable_irq
+ * DESCRIPTION: unmask an ISA IRQ at its IOAPIC input, delivered to the booting processor
+ *              on the vector the 8259 would have used
+ * INPUTS: irq_num -- 0 to 15
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void apic_enable_irq(uint32_t irq_num){
+    uint32_t pin;
+    if(irq_num >= ISA_IRQ_NUM || irq_gsi[irq_num] < ioapic_gsi_base){
+        return;
+    }
+    pin = irq_gsi[irq_num] - ioapic_gsi_base;
+    if(pin >= ioapic_inputs){
+        return;
+    }
+    ioapic_write(IOAPIC_REDIR + 2 * pin + 1, (uint32_t)apic_cpu_ids[0] << 24);
+    ioapic_write(IOAPIC_REDIR + 2 * pin, irq_flags[irq_num] | (APIC_IRQ_VECTOR + irq_num));
+}
+
+/*
+ *apic_disable_irq
+ * DESCRIPTION: mask an ISA IRQ at its IOAPIC input
+ * INPUTS: irq_num -- 0 to 15
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void apic_disable_irq(uint32_t irq_num){
+    uint32_t pin;
+    if(irq_num >= ISA_IRQ_NUM || irq_gsi[irq_num] < ioapic_gsi_base){
+        return;
+    }
+    pin = irq_gsi[irq_num] - ioapic_gsi_base;
+    if(pin >= ioapic_inputs){
+        return;
+    }
+    ioapic_write(IOAPIC_REDIR + 2 * pin, ioapic_read(IOAPIC_REDIR + 2 * pin) | IOAPIC_MASKED);
+}
+
+/*
+ *apic_send_eoi
+ * DESCRIPTION: tell the local APIC the interrupt in service is handled, one register
+ *              write in place of the 8259's port writes
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void apic_send_eoi(){
+    lapic_write(APIC_EOI, 0);
+}
+
+/*
+ *apic_timer_set_hz
+ * DESCRIPTION: run the local APIC timer periodically, interrupting on the PIT's vector
+ * INPUTS: hz -- a multiple of PIT_HZ
+ * OUTPUTS:None
+ * RETURN VALUE: the count the timer reloads with, its counts per interrupt
+ * SIDE EFFECTS: restarts the timer
+ */
+uint32_t apic_timer_set_hz(uint32_t hz){
+    apic_timer_count = apic_slice_count / (hz / PIT_HZ);
+    lapic_write(APIC_TIMER_DIVIDE, APIC_DIVIDE_16);
+    lapic_write(APIC_LVT_TIMER, APIC_TIMER_PERIODIC | APIC_IRQ_VECTOR);
+    lapic_write(APIC_TIMER_INIT, apic_timer_count);
+    return apic_timer_count;
+}
+
+/*
+ *apic_timer_elapsed
+ * DESCRIPTION: how far the timer has counted since it reloaded, that is since it last
+ *              raised its interrupt
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: timer counts
+ * SIDE EFFECTS: None
+ */
+uint32_t apic_timer_elapsed(){
+    return apic_timer_count - lapic_read(APIC_TIMER_CURRENT);
+}
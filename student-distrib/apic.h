@@ -0,0 +1,92 @@
+#ifndef _APIC_H
+#define _APIC_H
+
+/*
+Local APIC and IOAPIC. apic_probe finds them in the ACPI MADT, or the MP
+tables when there is no MADT, while memory is still addressed physically;
+apic_init then moves the device interrupts from the 8259 to the IOAPIC, on the
+same vectors, and the scheduling tick from the PIT to the local APIC timer.
+Without an APIC, or with apic=0 on the command line, the 8259 and the PIT stay
+in charge.
+*/
+#define APIC_MAX_CPUS           8           // processors remembered from the tables
+#define APIC_DEFAULT_BASE       0xFEE00000  // local APIC registers unless the tables say otherwise
+#define IOAPIC_DEFAULT_BASE     0xFEC00000
+#define APIC_IRQ_VECTOR         0x20        // vector of ISA IRQ 0, as the 8259 is programmed
+#define APIC_AP_TIMER_VECTOR    0x30        // timer of the other processors
+#define APIC_SPURIOUS_VECTOR    0xFF
+
+// local APIC registers, byte offsets from its base
+#define APIC_ID                 0x20
+#define APIC_TPR                0x80
+#define APIC_EOI                0xB0
+#define APIC_SVR                0xF0
+#define APIC_ICR_LOW            0x300
+#define APIC_ICR_HIGH           0x310
+#define APIC_LVT_TIMER          0x320
+#define APIC_TIMER_INIT         0x380
+#define APIC_TIMER_CURRENT      0x390
+#define APIC_TIMER_DIVIDE       0x3E0
+
+#define APIC_SVR_ENABLE         0x100
+#define APIC_LVT_MASKED         0x10000
+#define APIC_TIMER_PERIODIC     0x20000
+#define APIC_DIVIDE_16          0x3
+#define APIC_ICR_INIT           0x4500      // INIT, level asserted
+#define APIC_ICR_STARTUP        0x4600      // STARTUP, the vector is the page of the entry code
+#define APIC_ICR_PENDING        0x1000      // delivery status, set until the IPI is sent
+
+// IOAPIC registers, reached through its index and data windows
+#define IOAPIC_INDEX            0x00
+#define IOAPIC_DATA             0x10
+#define IOAPIC_VERSION          0x01
+#define IOAPIC_REDIR            0x10        // two registers per input from here
+
+#define IOAPIC_LEVEL            0x8000      // level triggered, edge when clear
+#define IOAPIC_LOW              0x2000      // active low, high when clear
+#define IOAPIC_MASKED           0x10000
+
+#define MSR_APIC_BASE           0x1B
+#define MSR_APIC_BASE_ENABLE    0x800
+#define CPUID_APIC_BIT          9
+
+#ifndef ASM
+
+#include "types.h"
+
+// 1 once the device interrupts and the tick go through the APICs
+extern uint32_t apic_on;
+
+// processors found in the tables, by local APIC id, the booting one first
+extern uint32_t apic_cpu_num;
+extern uint8_t apic_cpu_ids[APIC_MAX_CPUS];
+
+// look for the APICs in the firmware tables, before paging is on
+int32_t apic_probe();
+
+// take over the device interrupts and the tick from the 8259 and the PIT
+int32_t apic_init();
+
+// enable the local APIC of a processor started by smp_init, and its timer
+void apic_init_ap();
+
+// send an interprocessor interrupt, icr is the low word of the command register
+void apic_send_ipi(uint8_t apic_id, uint32_t icr);
+
+// spin for about us microseconds on the local APIC timer, once it is running
+void apic_delay_us(uint32_t us);
+
+// the 8259 calls, while apic_on is set
+void apic_enable_irq(uint32_t irq_num);
+void apic_disable_irq(uint32_t irq_num);
+void apic_send_eoi();
+
+// run the local APIC timer hz times a second, returns its initial count
+uint32_t apic_timer_set_hz(uint32_t hz);
+
+// timer counts since the timer last raised its interrupt
+uint32_t apic_timer_elapsed();
+
+#endif /* ASM */
+
+#endif /* _APIC_H */
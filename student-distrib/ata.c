@@ -0,0 +1,427 @@
+#include "ata.h"
+#include "lib.h"
+#include "i8259.h"
+#include "trace.h"
+
+uint32_t ata_sectors;
+volatile int32_t ata_busy;
+volatile int32_t ata_result;
+
+static uint32_t ata_drive;                  // 0 for the master, 1 for the slave
+static uint16_t bm_base;                    // bus master registers, 0 to move data with PIO
+static ata_prd_t ata_prdt[ATA_PRD_NUM] __attribute__ ((aligned(512)));  // 512 bytes aligned, so it never crosses 64KB
+static uint32_t xfer_dir;                   // BLK_READ or BLK_WRITE for the command in flight
+static uint32_t xfer_dma;                   // 1 if the command in flight uses DMA
+static uint32_t xfer_left;                  // sectors the PIO command still moves
+static blk_request_t* xfer_req;             // request whose buffer takes the next PIO sector
+static uint32_t xfer_off;                   // sector within xfer_req
+
+/*
+ *pci_read
+ * DESCRIPTION: read a register from the configuration space of a device on PCI bus 0
+ * INPUTS: dev, func, reg
+ * OUTPUTS:None
+ * RETURN VALUE: the 32-bit register
+ * SIDE EFFECTS: None
+ */
+static uint32_t pci_read(uint32_t dev, uint32_t func, uint32_t reg){
+    outl(PCI_ENABLE | (dev << 11) | (func << 8) | (reg & 0xFC), PCI_CONFIG_ADDRESS);
+    return inl(PCI_CONFIG_DATA);
+}
+
+/*
+ *pci_write
+ * DESCRIPTION: write a register in the configuration space of a device on PCI bus 0
+ * INPUTS: dev, func, reg, value
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+static void pci_write(uint32_t dev, uint32_t func, uint32_t reg, uint32_t value){
+    outl(PCI_ENABLE | (dev << 11) | (func << 8) | (reg & 0xFC), PCI_CONFIG_ADDRESS);
+    outl(value, PCI_CONFIG_DATA);
+}
+
+/*
+ *find_bus_master
+ * DESCRIPTION: look for an IDE controller on PCI bus 0 and turn on its bus mastering
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: the I/O port of the bus master registers, 0 if there is no such controller
+ * SIDE EFFECTS: None
+ */
+static uint16_t find_bus_master(){
+    uint32_t dev, func, bar;
+    for(dev = 0; dev < PCI_DEVICE_NUM; dev++){
+        for(func = 0; func < PCI_FUNCTION_NUM; func++){
+            if((pci_read(dev, func, 0) & 0xFFFF) == 0xFFFF){
+                if(func == 0) break;    // no device in this slot
+                continue;
+            }
+            if((pci_read(dev, func, PCI_CLASS_REG) >> 16) != PCI_CLASS_IDE){
+                continue;
+            }
+            bar = pci_read(dev, func, PCI_BAR4_REG);
+            if(!(bar & 1)){
+                continue;   // the bus master registers live in I/O space
+            }
+            // the upper half is the status register, writing zeros there changes nothing
+            pci_write(dev, func, PCI_COMMAND_REG, (pci_read(dev, func, PCI_COMMAND_REG) & 0xFFFF) | PCI_CMD_IO | PCI_CMD_MASTER);
+            return bar & 0xFFFC;
+        }
+    }
+    return 0;
+}
+
+/*
+ *ata_delay
+ * DESCRIPTION: wait the 400ns a drive needs before its status is valid after a select
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+static void ata_delay(){
+    int i;
+    for(i = 0; i < 4; i++){
+        inb(ATA_CONTROL);
+    }
+}
+
+/*
+ *ata_wait_idle
+ * DESCRIPTION: poll until the drive is not busy
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: the status, -1 if the drive stayed busy
+ * SIDE EFFECTS: None
+ */
+static int32_t ata_wait_idle(){
+    uint32_t i, status;
+    for(i = 0; i < ATA_POLL_LIMIT; i++){
+        status = inb(ATA_CONTROL);
+        if(!(status & ATA_SR_BSY)){
+            return status;
+        }
+    }
+    return -1;
+}
+
+/*
+ *ata_wait_drq
+ * DESCRIPTION: poll until the drive is ready to move a sector
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: 0 on success, -1 if the drive reported an error or stayed busy
+ * SIDE EFFECTS: None
+ */
+static int32_t ata_wait_drq(){
+    uint32_t i, status;
+    for(i = 0; i < ATA_POLL_LIMIT; i++){
+        status = inb(ATA_CONTROL);
+        if(status & ATA_SR_BSY){
+            continue;
+        }
+        if(status & (ATA_SR_ERR | ATA_SR_DF)){
+            return -1;
+        }
+        if(status & ATA_SR_DRQ){
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ *pio_sector
+ * DESCRIPTION: move the next sector of a PIO command through the data port
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: advances to the next sector, and to the next request of the chain
+ *               when this one is full
+ */
+static void pio_sector(){
+    uint16_t* data = (uint16_t*)(xfer_req->buf + xfer_off * BLK_SECTOR_SIZE);
+    uint32_t words = BLK_SECTOR_SIZE / 2;
+    if(xfer_dir == BLK_READ){
+        asm volatile ("rep insw" : "+D"(data), "+c"(words) : "d"(ATA_DATA) : "memory");
+    }else{
+        asm volatile ("rep outsw" : "+S"(data), "+c"(words) : "d"(ATA_DATA) : "memory");
+    }
+    xfer_left--;
+    if(++xfer_off == xfer_req->count){
+        xfer_req = xfer_req->next;
+        xfer_off = 0;
+    }
+}
+
+/*
+ *build_prdt
+ * DESCRIPTION: describe the buffers of a request chain in the physical region descriptor
+ *              table, splitting them at 64KB boundaries
+ * INPUTS: seg -- first request of the chain
+ * OUTPUTS:None
+ * RETURN VALUE: 0 on success, -1 if the chain needs more than ATA_PRD_NUM entries
+ * SIDE EFFECTS: None
+ */
+static int32_t build_prdt(blk_request_t* seg){
+    uint32_t n = 0, addr, left, piece;
+    for(; seg != NULL; seg = seg->next){
+        addr = (uint32_t)seg->buf;
+        left = seg->count * BLK_SECTOR_SIZE;
+        while(left > 0){
+            if(n == ATA_PRD_NUM){
+                return -1;
+            }
+            piece = ATA_PRD_MAX_BYTES - (addr & (ATA_PRD_MAX_BYTES - 1));   // up to the next 64KB boundary
+            if(piece > left){
+                piece = left;
+            }
+            ata_prdt[n].addr = addr;
+            ata_prdt[n].bytes = piece & 0xFFFF;
+            ata_prdt[n].flags = 0;
+            addr += piece;
+            left -= piece;
+            n++;
+        }
+    }
+    if(n == 0){
+        return -1;
+    }
+    ata_prdt[n - 1].flags = ATA_PRD_EOT;
+    return 0;
+}
+
+/*
+ *ata_init
+ * DESCRIPTION: identify a drive on the primary channel and look for the bus master
+ *              registers of its controller
+ * INPUTS: drive -- 0 for the master, 1 for the slave
+ *         use_dma -- 0 to move every sector with PIO even if DMA is available
+ * OUTPUTS:None
+ * RETURN VALUE: 0 if the drive was found, -1 otherwise
+ * SIDE EFFECTS: sets ata_sectors and unmasks the channel interrupt
+ */
+int32_t ata_init(uint32_t drive, uint32_t use_dma){
+    uint16_t id[BLK_SECTOR_SIZE / 2];
+    uint32_t i;
+    ata_sectors = 0;
+    ata_busy = 0;
+    ata_drive = drive & 1;
+    outb(ATA_CONTROL_NIEN, ATA_CONTROL);            // poll while probing
+    if(inb(ATA_COMMAND) == 0xFF){
+        return -1;                                  // floating bus, no drives
+    }
+    outb(0xA0 | (ata_drive << 4), ATA_DRIVE);
+    ata_delay();
+    outb(0, ATA_SECCOUNT);
+    outb(0, ATA_LBA_LOW);
+    outb(0, ATA_LBA_MID);
+    outb(0, ATA_LBA_HIGH);
+    outb(ATA_CMD_IDENTIFY, ATA_COMMAND);
+    if(inb(ATA_COMMAND) == 0 || ata_wait_idle() == -1){
+        return -1;                                  // no drive
+    }
+    if(inb(ATA_LBA_MID) != 0 || inb(ATA_LBA_HIGH) != 0){
+        return -1;                                  // an ATAPI drive, not a disk
+    }
+    if(ata_wait_drq() == -1){
+        return -1;
+    }
+    for(i = 0; i < BLK_SECTOR_SIZE / 2; i++){
+        id[i] = inw(ATA_DATA);
+    }
+    ata_sectors = id[60] | ((uint32_t)id[61] << 16);   // LBA28 sector count
+    if(ata_sectors > ATA_LBA28_LIMIT){
+        ata_sectors = ATA_LBA28_LIMIT;
+    }
+    bm_base = use_dma ? find_bus_master() : 0;
+    inb(ATA_COMMAND);
+    outb(0, ATA_CONTROL);                           // completions come as interrupts from now on
+    enable_irq(ATA_IRQ_NUM);
+    return 0;
+}
+
+/*
+ *ata_start
+ * DESCRIPTION: start a read or write of consecutive sectors. The data goes to or comes from
+ *              the buffers of a chain of requests in order, with one DMA transfer when the
+ *              controller has bus mastering, else one sector per interrupt.
+ * INPUTS: lba -- first sector
+ *         count -- sectors to move, the sum of the counts of the chain
+ *         dir -- BLK_READ or BLK_WRITE
+ *         seg -- first request of the chain
+ * OUTPUTS:None
+ * RETURN VALUE: 0 if the command started, -1 otherwise
+ * SIDE EFFECTS: sets ata_busy until the interrupt handler finishes the command. Called with
+ *               interrupts off.
+ */
+int32_t ata_start(uint32_t lba, uint32_t count, uint32_t dir, blk_request_t* seg){
+    if(ata_sectors == 0 || ata_busy || count == 0 || count > BLK_MAX_SECTORS || lba + count > ata_sectors){
+        return -1;
+    }
+    if(ata_wait_idle() == -1){
+        return -1;
+    }
+    xfer_dir = dir;
+    xfer_left = count;
+    xfer_req = seg;
+    xfer_off = 0;
+    xfer_dma = (bm_base != 0 && build_prdt(seg) == 0);
+    ata_result = 0;
+    ata_busy = 1;
+    outb(ATA_DRIVE_LBA | (ata_drive << 4) | ((lba >> 24) & 0x0F), ATA_DRIVE);
+    outb(count & 0xFF, ATA_SECCOUNT);               // 256 sectors is sent as 0
+    outb(lba & 0xFF, ATA_LBA_LOW);
+    outb((lba >> 8) & 0xFF, ATA_LBA_MID);
+    outb((lba >> 16) & 0xFF, ATA_LBA_HIGH);
+    if(xfer_dma){
+        outb(0, bm_base + BM_COMMAND);
+        outl((uint32_t)ata_prdt, bm_base + BM_PRDT);
+        outb(BM_SR_ERR | BM_SR_IRQ, bm_base + BM_STATUS);   // writing 1 clears them
+        outb(dir == BLK_READ ? BM_CMD_READ : 0, bm_base + BM_COMMAND);
+        outb(dir == BLK_READ ? ATA_CMD_READ_DMA : ATA_CMD_WRITE_DMA, ATA_COMMAND);
+        outb((dir == BLK_READ ? BM_CMD_READ : 0) | BM_CMD_START, bm_base + BM_COMMAND);
+        return 0;
+    }
+    outb(dir == BLK_READ ? ATA_CMD_READ_PIO : ATA_CMD_WRITE_PIO, ATA_COMMAND);
+    if(dir == BLK_WRITE){
+        // the drive asks for the first sector without an interrupt
+        if(ata_wait_drq() == -1){
+            ata_busy = 0;
+            ata_result = -1;
+            return -1;
+        }
+        pio_sector();
+    }
+    ata_delay();                                    // the status is valid for ata_poll after 400ns
+    return 0;
+}
+
+/*
+ *ata_cancel
+ * DESCRIPTION: give up on the command in flight and reset the channel
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: the command fails with ata_result -1
+ */
+void ata_cancel(){
+    if(bm_base != 0){
+        outb(0, bm_base + BM_COMMAND);
+    }
+    outb(0x04, ATA_CONTROL);                        // software reset
+    ata_delay();
+    outb(0, ATA_CONTROL);
+    ata_wait_idle();
+    ata_result = -1;
+    ata_busy = 0;
+}
+
+/*
+ *ata_ready
+ * DESCRIPTION: tell whether the drive is done with the part of the command in flight it
+ *              interrupts for: a DMA command is over, a PIO read has a sector ready, a
+ *              PIO write wants the next sector or took the last one
+ * INPUTS: status -- the alternate status, which does not acknowledge the drive
+ *         bm_status -- the bus master status, for a DMA command
+ * OUTPUTS:None
+ * RETURN VALUE: 1 if it is, 0 otherwise
+ * SIDE EFFECTS: None
+ */
+static int32_t ata_ready(uint32_t status, uint32_t bm_status){
+    if(status & ATA_SR_BSY){
+        return 0;
+    }
+    if(status & (ATA_SR_ERR | ATA_SR_DF)){
+        return 1;
+    }
+    if(xfer_dma){
+        return (bm_status & (BM_SR_IRQ | BM_SR_ERR)) != 0;
+    }
+    if(xfer_dir == BLK_READ || xfer_left != 0){
+        return (status & ATA_SR_DRQ) != 0;
+    }
+    return !(status & ATA_SR_DRQ);
+}
+
+/*
+ *ata_service
+ * DESCRIPTION: move the command in flight along if the drive is ready. A DMA command is
+ *              done; a PIO command moves its next sector, and is done after the last one.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: clears ata_busy when the command finished or failed. Called with
+ *               interrupts off.
+ */
+static void ata_service(){
+    uint32_t status, bm_status = 0;
+    if(xfer_dma){
+        bm_status = inb(bm_base + BM_STATUS);
+    }
+    if(!ata_ready(inb(ATA_CONTROL), bm_status)){
+        return;                                     // latched while an earlier command was polled
+    }
+    if(xfer_dma){
+        outb(xfer_dir == BLK_READ ? BM_CMD_READ : 0, bm_base + BM_COMMAND);    // stop the engine
+    }
+    status = inb(ATA_COMMAND);                      // reading the status acknowledges the drive
+    if(xfer_dma){
+        outb(BM_SR_ERR | BM_SR_IRQ, bm_base + BM_STATUS);
+        if((bm_status & BM_SR_ERR) || (status & (ATA_SR_ERR | ATA_SR_DF))){
+            ata_result = -1;
+        }
+        ata_busy = 0;
+    }else if(status & (ATA_SR_ERR | ATA_SR_DF)){
+        ata_result = -1;
+        ata_busy = 0;
+    }else if(xfer_dir == BLK_READ){
+        pio_sector();                               // the drive has the next sector ready
+        if(xfer_left == 0){
+            ata_busy = 0;
+        }
+    }else if(xfer_left == 0){
+        ata_busy = 0;                               // the drive took the last sector written
+    }else{
+        pio_sector();
+    }
+}
+
+/*
+ *ata_poll
+ * DESCRIPTION: move the command in flight along without its interrupt, for a caller
+ *              that has interrupts off. The interrupt may still come later; the handler
+ *              then finds the drive not ready for the command in flight, or none, and
+ *              leaves it alone.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: 1 while the command is still in flight, 0 once it is over
+ * SIDE EFFECTS: called with interrupts off
+ */
+int32_t ata_poll(){
+    if(ata_busy){
+        ata_service();
+        ata_delay();                                // let the status catch up with a sector just moved
+    }
+    return ata_busy;
+}
+
+/*
+ *ata_int_handler
+ * DESCRIPTION: handle the primary channel interrupt
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: clears ata_busy when the command finished or failed
+ */
+void ata_int_handler(){
+    TRACE(TRACE_IRQ, ATA_IRQ_NUM);
+    if(ata_busy){
+        ata_service();
+    }else{
+        inb(ATA_COMMAND);                           // nothing in flight, a cancelled or polled command
+    }
+    send_eoi(ATA_IRQ_NUM);
+}
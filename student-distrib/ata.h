@@ -0,0 +1,93 @@
+#ifndef _ATA_H
+#define _ATA_H
+
+#include "types.h"
+#include "blk.h"
+
+/* Ports of the primary ATA channel */
+#define ATA_DATA            0x1F0
+#define ATA_ERROR           0x1F1
+#define ATA_SECCOUNT        0x1F2
+#define ATA_LBA_LOW         0x1F3
+#define ATA_LBA_MID         0x1F4
+#define ATA_LBA_HIGH        0x1F5
+#define ATA_DRIVE           0x1F6
+#define ATA_COMMAND         0x1F7   // status when read
+#define ATA_CONTROL         0x3F6   // alternate status when read
+
+/* Status bits */
+#define ATA_SR_ERR          0x01
+#define ATA_SR_DRQ          0x08
+#define ATA_SR_DF           0x20
+#define ATA_SR_BSY          0x80
+
+/* Commands */
+#define ATA_CMD_READ_PIO    0x20
+#define ATA_CMD_WRITE_PIO   0x30
+#define ATA_CMD_READ_DMA    0xC8
+#define ATA_CMD_WRITE_DMA   0xCA
+#define ATA_CMD_IDENTIFY    0xEC
+
+#define ATA_CONTROL_NIEN    0x02    // mask the drive interrupt
+#define ATA_DRIVE_LBA       0xE0    // drive register bits for LBA addressing
+#define ATA_IRQ_NUM         14      // primary channel interrupt line
+#define ATA_POLL_LIMIT      100000  // status reads before a polled wait gives up
+#define ATA_LBA28_LIMIT     0x10000000
+
+/* Bus master IDE registers, offsets from BAR4 of the controller */
+#define BM_COMMAND          0x0
+#define BM_STATUS           0x2
+#define BM_PRDT             0x4
+#define BM_CMD_START        0x01
+#define BM_CMD_READ         0x08    // the controller writes memory, a disk read
+#define BM_SR_ERR           0x02
+#define BM_SR_IRQ           0x04
+#define ATA_PRD_NUM         64      // entries of the physical region descriptor table
+#define ATA_PRD_MAX_BYTES   0x10000 // one entry moves at most 64KB and may not cross a 64KB boundary
+#define ATA_PRD_EOT         0x8000  // last entry of the table
+
+/* PCI configuration space, used to find the bus master registers */
+#define PCI_CONFIG_ADDRESS  0xCF8
+#define PCI_CONFIG_DATA     0xCFC
+#define PCI_ENABLE          0x80000000
+#define PCI_CLASS_REG       0x08
+#define PCI_COMMAND_REG     0x04
+#define PCI_BAR4_REG        0x20
+#define PCI_CLASS_IDE       0x0101  // mass storage, IDE
+#define PCI_CMD_IO          0x01
+#define PCI_CMD_MASTER      0x04
+#define PCI_DEVICE_NUM      32
+#define PCI_FUNCTION_NUM    8
+
+// one physical region descriptor, a piece of the buffers a DMA command moves
+typedef struct ata_prd{
+    uint32_t addr;          // physical address
+    uint16_t bytes;         // 0 means 64KB
+    uint16_t flags;         // ATA_PRD_EOT on the last entry
+}__attribute__ ((packed)) ata_prd_t;
+
+// sectors of the drive, 0 if ata_init found none
+extern uint32_t ata_sectors;
+
+// 1 while a command is in flight, cleared by the interrupt handler
+extern volatile int32_t ata_busy;
+
+// outcome of the last command, 0 or -1
+extern volatile int32_t ata_result;
+
+// find the drive and the bus master registers
+int32_t ata_init(uint32_t drive, uint32_t use_dma);
+
+// start moving count sectors between the disk and the buffers of a request chain
+int32_t ata_start(uint32_t lba, uint32_t count, uint32_t dir, blk_request_t* seg);
+
+// give up on the command in flight
+void ata_cancel();
+
+// do what the interrupt handler would if the drive is ready, with interrupts off
+int32_t ata_poll();
+
+// handle the primary channel interrupt
+void ata_int_handler();
+
+#endif /* _ATA_H */
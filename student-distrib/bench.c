@@ -0,0 +1,386 @@
+#include "bench.h"
+#include "lib.h"
+#include "x86_desc.h"
+#include "FileSystem.h"
+#include "systemcall.h"
+#include "serial.h"
+
+#define BENCH_OVERHEAD_RUNS 64      // empty rdtsc pairs timed to find the timing overhead
+#define BENCH_COPY_SIZE     0x10000 // largest copy, the size of the copy buffers
+#define BENCH_SWITCH_PID_A  0       // pids whose pages the context switch maps, nothing runs yet
+#define BENCH_SWITCH_PID_B  1
+
+static uint8_t bench_src[BENCH_COPY_SIZE];
+static uint8_t bench_dst[BENCH_COPY_SIZE];
+static uint32_t bench_samples[BENCH_MAX_REPS];
+static uint8_t bench_text[BENCH_TERM_BYTES];
+static uint32_t bench_inode;                        // file read by read_data_4k
+static int8_t bench_parent = -1;                    // stand-in parent of exec_halt
+static uint32_t bench_saved_esp0;                   // tss.esp0 before ctx_switch
+static uint32_t bench_main_esp;                     // saved stack of the side not running
+static uint32_t bench_partner_esp;
+static uint32_t bench_stack[BENCH_STACK_SIZE / 4];  // stack of the context switch partner
+
+// save the callee-saved registers, store esp in *save_esp and resume the stack next_esp
+void bench_swap(uint32_t* save_esp, uint32_t next_esp);
+asm(
+    ".pushsection .text         \n"
+    "bench_swap:                \n"
+    "    movl 4(%esp), %eax     \n"
+    "    movl 8(%esp), %ecx     \n"
+    "    pushl %ebp             \n"
+    "    pushl %ebx             \n"
+    "    pushl %esi             \n"
+    "    pushl %edi             \n"
+    "    movl %esp, (%eax)      \n"
+    "    movl %ecx, %esp        \n"
+    "    popl %edi              \n"
+    "    popl %esi              \n"
+    "    popl %ebx              \n"
+    "    popl %ebp              \n"
+    "    ret                    \n"
+    ".popsection                \n"
+);
+
+static void bench_memcpy_64(){
+    memcpy(bench_dst, bench_src, 64);
+}
+
+static void bench_memcpy_4k(){
+    memcpy(bench_dst, bench_src, BLOCK_SIZE);
+}
+
+static void bench_memcpy_64k(){
+    memcpy(bench_dst, bench_src, BENCH_COPY_SIZE);
+}
+
+/*
+ *bench_read_setup
+ * DESCRIPTION: pick the file read_data_4k reads, fish or else shell, which are more
+ *              than a block long in every image
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: 0, -1 if neither is there
+ * SIDE EFFECTS: None
+ */
+static int32_t bench_read_setup(){
+    dentry_t dentry;
+    if(read_dentry_by_name((uint8_t*)"fish", &dentry) < 0 && read_dentry_by_name((uint8_t*)"shell", &dentry) < 0){
+        return -1;
+    }
+    bench_inode = dentry.inode_num;
+    return 0;
+}
+
+static void bench_read_data_4k(){
+    read_data(bench_inode, 0, bench_dst, BLOCK_SIZE);
+}
+
+static void bench_dentry_hit(){
+    dentry_t dentry;
+    read_dentry_by_name((uint8_t*)"shell", &dentry);
+}
+
+static void bench_dentry_miss(){
+    dentry_t dentry;
+    read_dentry_by_name((uint8_t*)"nosuchfile", &dentry);
+}
+
+/*
+ *bench_exec_setup
+ * DESCRIPTION: make a process for exec_halt to run execbench from. It is never entered,
+ *              it only owns the terminal so execute treats the child as its foreground
+ *              child and halt comes back here instead of starting a shell.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: 0, -1 if execbench is missing or no pid is free
+ * SIDE EFFECTS: curr_pid is the stand-in until bench_exec_teardown
+ */
+static int32_t bench_exec_setup(){
+    dentry_t dentry;
+    pcb_t* pcb;
+    uint32_t flags;
+    if(read_dentry_by_name((uint8_t*)"execbench", &dentry) < 0){
+        return -1;
+    }
+    cli_and_save(flags);
+    if((bench_parent = get_pid()) < 0){
+        restore_flags(flags);
+        return -1;
+    }
+    pcb = get_pcb(bench_parent);
+    init_pcb(pcb, bench_parent);
+    strcpy(pcb->name, "bench");
+    pcb->tid = curr_terminal_running;
+    pcb->active = 1;
+    map_program(bench_parent);
+    curr_pid = bench_parent;
+    terminal[curr_terminal_running].active = 1;
+    terminal[curr_terminal_running].curr_pid = bench_parent;
+    restore_flags(flags);
+    return 0;
+}
+
+static void bench_exec_halt(){
+    execute((uint8_t*)"execbench child");
+}
+
+/*
+ *bench_exec_teardown
+ * DESCRIPTION: free the stand-in parent and give the terminal back to the first shell
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+static void bench_exec_teardown(){
+    uint32_t flags;
+    cli_and_save(flags);
+    terminal[curr_terminal_running].active = 0;
+    terminal[curr_terminal_running].curr_pid = -1;
+    curr_pid = -1;
+    del_pid(bench_parent);
+    bench_parent = -1;
+    restore_flags(flags);
+}
+
+static void bench_term_write(){
+    terminal_write(STD_OUT_NUM, bench_text, BENCH_TERM_BYTES);
+}
+
+/*
+ *bench_switch_work
+ * DESCRIPTION: what the scheduler does to the machine on a switch to pid: map its
+ *              program and video pages, flushing the TLB each time, and set the
+ *              kernel stack of the TSS
+ * INPUTS: pid -- the pid switched to
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+static void bench_switch_work(uint32_t pid){
+    map_program(pid);
+    vidmap_paging();
+    tss.ss0 = KERNEL_DS;
+    tss.esp0 = (uint32_t)&bench_stack[BENCH_STACK_SIZE / 4 - 1];
+}
+
+// the other side of ctx_switch, switched to and back once per run
+static void bench_partner(){
+    for(;;){
+        bench_switch_work(BENCH_SWITCH_PID_B);
+        bench_swap(&bench_partner_esp, bench_main_esp);
+    }
+}
+
+/*
+ *bench_switch_setup
+ * DESCRIPTION: lay out the partner's stack as bench_swap leaves it, so the first switch
+ *              to it returns into bench_partner
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: 0
+ * SIDE EFFECTS: None
+ */
+static int32_t bench_switch_setup(){
+    uint32_t* sp = &bench_stack[BENCH_STACK_SIZE / 4];
+    bench_saved_esp0 = tss.esp0;
+    *--sp = 0;                                  // return address of bench_partner, never used
+    *--sp = (uint32_t)bench_partner;
+    sp -= 4;                                    // ebp, ebx, esi and edi
+    bench_partner_esp = (uint32_t)sp;
+    return 0;
+}
+
+static void bench_ctx_switch(){
+    bench_switch_work(BENCH_SWITCH_PID_A);
+    bench_swap(&bench_main_esp, bench_partner_esp);
+}
+
+static void bench_switch_teardown(){
+    tss.esp0 = bench_saved_esp0;
+}
+
+static void bench_tlb_flush(){
+    flush_tlb();
+    // walk the page tables again for the pages touched right after a switch
+    *(volatile uint8_t*)bench_src;
+    *(volatile uint8_t*)(VIDEO);
+}
+
+static bench_t bench_table[] = {
+    {"memcpy_64", NULL, bench_memcpy_64, NULL, 64, 1},
+    {"memcpy_4k", NULL, bench_memcpy_4k, NULL, BLOCK_SIZE, 1},
+    {"memcpy_64k", NULL, bench_memcpy_64k, NULL, BENCH_COPY_SIZE, 1},
+    {"read_data_4k", bench_read_setup, bench_read_data_4k, NULL, BLOCK_SIZE, 0},
+    {"dentry_hit", NULL, bench_dentry_hit, NULL, 0, 0},
+    {"dentry_miss", NULL, bench_dentry_miss, NULL, 0, 0},
+    {"exec_halt", bench_exec_setup, bench_exec_halt, bench_exec_teardown, 0, 0},
+    {"term_write", NULL, bench_term_write, NULL, BENCH_TERM_BYTES, 0},
+    {"ctx_switch", bench_switch_setup, bench_ctx_switch, bench_switch_teardown, 0, 1},
+    {"tlb_flush", NULL, bench_tlb_flush, NULL, 0, 1},
+};
+
+#define BENCH_NUM (sizeof(bench_table) / sizeof(bench_t))
+
+/*
+ *bench_selected
+ * DESCRIPTION: check whether the bench= list names a benchmark, as "all", its name or
+ *              a prefix of its name
+ * INPUTS: list -- names separated by commas
+ *         name -- the benchmark
+ * OUTPUTS:None
+ * RETURN VALUE: 1 if it is named, 0 otherwise
+ * SIDE EFFECTS: None
+ */
+static int32_t bench_selected(const int8_t* list, const int8_t* name){
+    const int8_t* end;
+    uint32_t len;
+    while(*list != '\0'){
+        for(end = list; *end != ',' && *end != '\0'; end++);
+        len = end - list;
+        if(len == 3 && strncmp(list, "all", len) == 0){
+            return 1;
+        }
+        if(len > 0 && len <= strlen(name) && strncmp(list, name, len) == 0){
+            return 1;
+        }
+        list = (*end == ',') ? end + 1 : end;
+    }
+    return 0;
+}
+
+/*
+ *bench_overhead
+ * DESCRIPTION: find the cycles two back to back rdtsc take, which every sample
+ *              includes and has taken off
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: the fewest cycles seen
+ * SIDE EFFECTS: None
+ */
+static uint32_t bench_overhead(){
+    uint32_t i, cycles, least = 0xFFFFFFFF;
+    uint32_t flags;
+    uint64_t t0;
+    cli_and_save(flags);
+    for(i = 0; i < BENCH_OVERHEAD_RUNS; i++){
+        t0 = rdtsc();
+        cycles = (uint32_t)(rdtsc() - t0);
+        if(cycles < least){
+            least = cycles;
+        }
+    }
+    restore_flags(flags);
+    return least;
+}
+
+/*
+ *bench_time
+ * DESCRIPTION: run a benchmark warmup times untimed, then reps times timed, keeping
+ *              the cycles of each timed run less the timing overhead, sorted
+ * INPUTS: b -- the benchmark
+ *         reps -- timed runs
+ *         overhead -- from bench_overhead
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: fills bench_samples
+ */
+static void bench_time(bench_t* b, uint32_t reps, uint32_t overhead){
+    uint32_t i, j, cycles, flags;
+    uint64_t t0, t1;
+    for(i = 0; i < BENCH_WARMUP + reps; i++){
+        if(b->irq_off){
+            cli_and_save(flags);
+        }
+        t0 = rdtsc();
+        b->run();
+        t1 = rdtsc();
+        if(b->irq_off){
+            restore_flags(flags);
+        }
+        if(i < BENCH_WARMUP){
+            continue;
+        }
+        cycles = (uint32_t)(t1 - t0);
+        cycles = (cycles > overhead) ? cycles - overhead : 0;
+        // insertion sort, the samples come in mostly in order
+        for(j = i - BENCH_WARMUP; j > 0 && bench_samples[j - 1] > cycles; j--){
+            bench_samples[j] = bench_samples[j - 1];
+        }
+        bench_samples[j] = cycles;
+    }
+}
+
+// send " key=value" on COM1
+static void bench_put(const int8_t* key, uint32_t value){
+    int8_t digits[11];
+    serial_puts(" ");
+    serial_puts(key);
+    serial_puts("=");
+    serial_puts(itoa(value, digits, 10));
+}
+
+/*
+ *bench_run
+ * DESCRIPTION: time the benchmarks the list names and report every one on COM1 as
+ *                BENCH BEGIN overhead=<cycles> reps=<n> warmup=<n>
+ *                BENCH <name> min=<c> median=<c> p99=<c> max=<c> bytes=<n>
+ *                BENCH <name> skipped
+ *                BENCH END
+ *              in cycles with the timing overhead taken off, bytes being what a run
+ *              moves, and on the screen
+ * INPUTS: list -- the bench= option
+ *         reps -- timed runs of each benchmark, BENCH_REPS if 0
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: called at boot with interrupts on and no process yet
+ */
+void bench_run(const int8_t* list, uint32_t reps){
+    uint32_t i, overhead;
+    bench_t* b;
+    if(reps == 0){
+        reps = BENCH_REPS;
+    }
+    if(reps > BENCH_MAX_REPS){
+        reps = BENCH_MAX_REPS;
+    }
+    for(i = 0; i < BENCH_COPY_SIZE; i++){
+        bench_src[i] = (uint8_t)i;
+    }
+    for(i = 0; i < BENCH_TERM_BYTES; i++){
+        bench_text[i] = ((i + 1) % 64 == 0) ? '\n' : 'a' + i % 26;
+    }
+    overhead = bench_overhead();
+    serial_puts("BENCH BEGIN");
+    bench_put("overhead", overhead);
+    bench_put("reps", reps);
+    bench_put("warmup", BENCH_WARMUP);
+    serial_puts("\n");
+    for(i = 0; i < BENCH_NUM; i++){
+        b = &bench_table[i];
+        if(!bench_selected(list, b->name)){
+            continue;
+        }
+        serial_puts("BENCH ");
+        serial_puts(b->name);
+        if(b->setup != NULL && b->setup() != 0){
+            serial_puts(" skipped\n");
+            printf("bench %s: skipped\n", b->name);
+            continue;
+        }
+        bench_time(b, reps, overhead);
+        if(b->teardown != NULL){
+            b->teardown();
+        }
+        bench_put("min", bench_samples[0]);
+        bench_put("median", bench_samples[reps / 2]);
+        bench_put("p99", bench_samples[reps * 99 / 100]);
+        bench_put("max", bench_samples[reps - 1]);
+        bench_put("bytes", b->bytes);
+        serial_puts("\n");
+        printf("bench %s: min %u median %u p99 %u cycles\n", b->name, bench_samples[0],
+                bench_samples[reps / 2], bench_samples[reps * 99 / 100]);
+    }
+    serial_puts("BENCH END\n");
+}
@@ -0,0 +1,32 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include "types.h"
+
+/*
+In-kernel microbenchmarks, run at boot before the first shell when bench= names
+them on the command line: "bench=all", or names separated by commas, where a
+name also picks every benchmark it is a prefix of ("bench=memcpy,dentry").
+Results go to COM1, one "BENCH name=... min=... median=... p99=..." line each.
+*/
+#define BENCH_LIST_LEN      64      // longest bench= list
+#define BENCH_REPS          256     // timed runs of a benchmark, benchreps= changes it
+#define BENCH_MAX_REPS      1024
+#define BENCH_WARMUP        16      // untimed runs first, to fill caches and the TLB
+#define BENCH_TERM_BYTES    1024    // written to the terminal per run
+#define BENCH_STACK_SIZE    4096    // stack of the context switch partner
+
+// one benchmark
+typedef struct bench{
+    const int8_t* name;
+    int32_t (*setup)();     // 0 to go on, -1 to skip the benchmark; NULL for none
+    void (*run)();          // the work timed
+    void (*teardown)();     // NULL for none
+    uint32_t bytes;         // moved by a run, 0 if it is not a copy
+    uint8_t irq_off;        // 1 to time it with interrupts off
+}bench_t;
+
+// run the benchmarks named in list, reps timed runs each
+void bench_run(const int8_t* list, uint32_t reps);
+
+#endif /* _BENCH_H */
@@ -0,0 +1,160 @@
+#include "blk.h"
+#include "ata.h"
+#include "lib.h"
+#include "scheduler.h"
+#include "i8253.h"
+#include "smp.h"
+
+#define BLK_WAIT_MS     5000    // milliseconds before a command is given up
+
+static blk_request_t* blk_queue;    // requests not issued yet, in sector order
+
+uint32_t blk_requests;
+uint32_t blk_commands;
+uint32_t blk_merges;
+
+/*
+ *blk_sectors
+ * DESCRIPTION: get the size of the disk
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: sectors the disk holds, 0 if there is no disk
+ * SIDE EFFECTS: None
+ */
+uint32_t blk_sectors(){
+    return ata_sectors;
+}
+
+/*
+ *blk_submit
+ * DESCRIPTION: queue a request behind every queued request with a lower or equal sector,
+ *              so blk_run sweeps the disk once and finds mergeable neighbours next to
+ *              each other. Nothing moves until blk_run.
+ * INPUTS: req -- the request, which must stay put until its status leaves BLK_PENDING
+ * OUTPUTS:None
+ * RETURN VALUE: 0 on success, -1 if there is no disk or the request does not fit on it
+ * SIDE EFFECTS: sets the status of the request to BLK_PENDING
+ */
+int32_t blk_submit(blk_request_t* req){
+    blk_request_t** link;
+    uint32_t flags;
+    if(req == NULL || req->count == 0 || req->count > BLK_MAX_SECTORS || req->sector + req->count > ata_sectors){
+        return -1;
+    }
+    req->status = BLK_PENDING;
+    cli_and_save(flags);
+    link = &blk_queue;
+    while(*link != NULL && (*link)->sector <= req->sector){
+        link = &(*link)->next;
+    }
+    req->next = *link;
+    *link = req;
+    blk_requests++;
+    restore_flags(flags);
+    return 0;
+}
+
+/*
+ *blk_wait
+ * DESCRIPTION: wait until the command in flight finishes. A caller with interrupts on
+ *              sleeps until the interrupt handler finishes it; one with interrupts off,
+ *              like load_program or the boot filesystem, polls the drive instead, so
+ *              its cli section stays whole. So do the other processors, since the
+ *              disk interrupts only the booting one.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: 0 if the command succeeded, -1 if it failed or never finished
+ * SIDE EFFECTS: None
+ */
+static int32_t blk_wait(){
+    uint32_t flags;
+    uint64_t deadline;
+    cli_and_save(flags);
+    // by the clock, as other interrupts and a faster PIT would wake us sooner
+    deadline = rdtsc() + (uint64_t)BLK_WAIT_MS * tsc_khz;
+    while(ata_busy){
+        if(rdtsc() >= deadline){
+            ata_cancel();   // the interrupt never came
+            break;
+        }
+        if((flags & EFLAGS_IF) && smp_cpu_index() == 0){
+            asm volatile ("sti; hlt; cli" : : : "memory");  // sti takes effect after hlt starts, so no wakeup is lost
+        }else{
+            ata_poll();
+        }
+    }
+    restore_flags(flags);
+    return ata_result;
+}
+
+/*
+ *blk_run
+ * DESCRIPTION: issue the queued requests in sector order and wait for each command. A
+ *              command takes the head of the queue and every following request in the
+ *              same direction that starts where the previous one ends, up to BLK_MERGE_MAX
+ *              requests and BLK_MAX_SECTORS sectors, so blocks that are neighbours on disk
+ *              move in one command even when their buffers are not neighbours in memory.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: the status of every request becomes BLK_DONE or BLK_ERROR. The caller keeps
+ *               the cpu until the queue is empty, see sched_hold.
+ */
+void blk_run(){
+    blk_request_t *first, *last, *req;
+    uint32_t count, num, flags;
+    int32_t result;
+    if(blk_queue == NULL){
+        return;
+    }
+    sched_hold();
+    while(blk_queue != NULL){
+        cli_and_save(flags);
+        first = last = blk_queue;
+        count = first->count;
+        num = 1;
+        while(last->next != NULL && num < BLK_MERGE_MAX && last->next->dir == first->dir
+                && last->next->sector == last->sector + last->count && count + last->next->count <= BLK_MAX_SECTORS){
+            last = last->next;
+            count += last->count;
+            num++;
+        }
+        blk_queue = last->next;
+        last->next = NULL;
+        blk_commands++;
+        blk_merges += num - 1;
+        result = ata_start(first->sector, count, first->dir, first);
+        restore_flags(flags);
+        if(result == 0){
+            result = blk_wait();
+        }
+        for(req = first; req != NULL; req = first){
+            first = req->next;
+            req->next = NULL;
+            req->status = (result == 0) ? BLK_DONE : BLK_ERROR;
+        }
+    }
+    sched_release();
+}
+
+/*
+ *blk_rw
+ * DESCRIPTION: read or write sectors and wait until the drive is done, along with
+ *              anything else that was queued
+ * INPUTS: sector, count, buf, dir
+ * OUTPUTS:None
+ * RETURN VALUE: 0 on success, -1 on failure
+ * SIDE EFFECTS: None
+ */
+int32_t blk_rw(uint32_t sector, uint32_t count, uint8_t* buf, uint32_t dir){
+    blk_request_t req;
+    req.sector = sector;
+    req.count = count;
+    req.buf = buf;
+    req.dir = dir;
+    if(blk_submit(&req) == -1){
+        return -1;
+    }
+    blk_run();
+    return (req.status == BLK_DONE) ? 0 : -1;
+}
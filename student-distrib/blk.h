@@ -0,0 +1,47 @@
+#ifndef _BLK_H
+#define _BLK_H
+
+#include "types.h"
+
+#define BLK_SECTOR_SIZE         512
+#define BLK_SECTORS_PER_BLOCK   8           // sectors in one 4KB filesystem block
+#define BLK_MERGE_MAX           32          // requests merged into one drive command
+#define BLK_MAX_SECTORS         256         // sectors one drive command may move
+#define BLK_READ                0
+#define BLK_WRITE               1
+#define BLK_PENDING             1           // status of a request that is queued or in flight
+#define BLK_DONE                0           // status of a request that completed
+#define BLK_ERROR               -1          // status of a request the drive failed
+
+// one transfer between the disk and a buffer in kernel memory, owned by the caller
+typedef struct blk_request{
+    uint32_t sector;                // first sector on the disk
+    uint32_t count;                 // number of sectors
+    uint8_t* buf;                   // count * BLK_SECTOR_SIZE bytes, identity mapped
+    uint32_t dir;                   // BLK_READ or BLK_WRITE
+    volatile int32_t status;        // BLK_PENDING, BLK_DONE or BLK_ERROR
+    struct blk_request* next;       // next request in the queue or in the same command
+}blk_request_t;
+
+// requests handed to blk_submit
+extern uint32_t blk_requests;
+
+// drive commands issued
+extern uint32_t blk_commands;
+
+// requests that rode along in a command started for an earlier one
+extern uint32_t blk_merges;
+
+// sectors the disk holds, 0 if there is no disk
+uint32_t blk_sectors();
+
+// queue a request in sector order
+int32_t blk_submit(blk_request_t* req);
+
+// issue every queued request and wait until the drive finished them
+void blk_run();
+
+// read or write sectors and wait for it
+int32_t blk_rw(uint32_t sector, uint32_t count, uint8_t* buf, uint32_t dir);
+
+#endif /* _BLK_H */
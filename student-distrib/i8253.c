@@ -1,18 +1,61 @@
 #include "i8253.h"
+#include "trace.h"
+#include "profile.h"
+#include "apic.h"
 
+uint32_t pit_slice_ticks = 1;
+static uint32_t pit_ticks = 0;         // ticks into the current time slice
+static uint64_t pit_last_tick = 0;     // time stamp counter at the last tick, 0 for none yet
+uint32_t pit_tick_count = 0;
+uint64_t pit_tick_cycles = 0;
+uint64_t pit_tick_max = 0;
+uint32_t pit_divisor = FREQUENCY / PIT_HZ;
+uint32_t tsc_khz = 0;
 /* 
  *i8253_int
- * DESCRIPTION: initialize Intel 8253 Programmable Interval Timer (PIT)
+ * DESCRIPTION: initialize Intel 8253 Programmable Interval Timer (PIT) and time the
+ *              time stamp counter over one of its ticks. Called with interrupts off.
  * INPUTS: None
  * OUTPUTS:None
  * RETURN VALUE: None
- * SIDE EFFECTS: Initialize the PIT
+ * SIDE EFFECTS: Initialize the PIT, sets tsc_khz
  */
 void i8253_init(){
-    int32_t freq = FREQUENCY / DIVIDE_COUNTER; // interrupt every 10ms
+    uint64_t start;
+    pit_set_hz(PIT_HZ);                                 // interrupt every 10ms
+    pit_wait_reload();
+    start = rdtsc();
+    pit_wait_reload();
+    tsc_khz = (uint32_t)(rdtsc() - start) / (1000 / PIT_HZ);
+    // the output for PIT channel 0 is connected to the PIC IRQ 0
+    enable_irq(0);                
+    return;
+}
+
+/* 
+ *pit_set_hz
+ * DESCRIPTION: program channel 0 to interrupt hz times a second. The scheduler is
+ *              still called once every 1/PIT_HZ seconds.
+ * INPUTS: hz -- a multiple of PIT_HZ
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: reprograms the PIT, or the local APIC timer once it has taken over
+ */
+void pit_set_hz(uint32_t hz){
+    int32_t freq = FREQUENCY / hz;
     int32_t freq_low  = freq &  MASK;                 
     int32_t freq_high = freq >> RIGHT_SHIFT_8;       
+    uint32_t flags;
 
+    cli_and_save(flags);
+    pit_slice_ticks = hz / PIT_HZ;
+    pit_ticks = 0;
+    pit_stat_clear();                                   // the old period says nothing about the new one
+    if(apic_on){
+        pit_divisor = apic_timer_set_hz(hz);
+        restore_flags(flags);
+        return;
+    }
     // send command to the port     
     // bit 6 and 7 (select channel):  0 0 -> channel 0 
     // bit 4 and 5 (Access mode):     1 1 -> lobyte/hibyte 
@@ -22,16 +65,96 @@ void i8253_init(){
     outb(0x34, CMD_REG);  
     outb(freq_low, CHANNEL_0);
     outb(freq_high,CHANNEL_0);
-    // the output for PIT channel 0 is connected to the PIC IRQ 0
-    enable_irq(0);                
-    return;
+    pit_divisor = freq;
+    restore_flags(flags);
+}
+
+/* 
+ *pit_stat_clear
+ * DESCRIPTION: start timing the ticks again from the next one
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void pit_stat_clear(){
+    uint32_t flags;
+    cli_and_save(flags);
+    pit_last_tick = 0;
+    pit_tick_count = 0;
+    pit_tick_cycles = 0;
+    pit_tick_max = 0;
+    restore_flags(flags);
 }
 
-void pit_int_handler(){
+/* 
+ *pit_elapsed
+ * DESCRIPTION: how long ago channel 0 last reached zero and raised IRQ0. In mode 2 the
+ *              counter reloads at zero and counts down, so this is the divisor less
+ *              the count latched now. The local APIC timer is asked instead once it
+ *              drives the tick.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: clocks of the tick source since the last interrupt was raised, out of
+ *               pit_divisor per tick
+ * SIDE EFFECTS: latches the counter, call with interrupts off
+ */
+uint32_t pit_elapsed(){
+    uint32_t count;
+    if(apic_on){
+        return apic_timer_elapsed();
+    }
+    outb(0x00, CMD_REG);                                // latch channel 0
+    count = inb(CHANNEL_0);
+    count |= inb(CHANNEL_0) << RIGHT_SHIFT_8;
+    return count <= pit_divisor ? pit_divisor - count : 0;
+}
+
+/*
+ *pit_wait_reload
+ * DESCRIPTION: spin until the tick source reloads its count, which happens every tick
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: call with interrupts off
+ */
+void pit_wait_reload(){
+    uint32_t prev = pit_elapsed(), elapsed;
+    while((elapsed = pit_elapsed()) >= prev){
+        prev = elapsed;
+    }
+}
+
+/* 
+ *pit_int_handler
+ * DESCRIPTION: time the tick against the last one, take a profiler sample if it is
+ *              on, and give the scheduler the cpu at the end of every time slice. A
+ *              longest interval well over the mean means the tick was held up, by
+ *              interrupts left off or by a slow handler.
+ * INPUTS: frame -- the interrupt frame, frame[0] is the interrupted EIP and frame[1] its CS
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: may switch to another process
+ */
+void pit_int_handler(uint32_t* frame){
+    uint64_t now = rdtsc();
+    TRACE(TRACE_IRQ, 0);
     send_eoi(0);
     cli();
-    // implement scheduler only when terminal 2 or terminal 3 is running 
-    if(terminal[1].active == 1 || terminal[2].active == 1){
+    if(pit_last_tick != 0){
+        pit_tick_count++;
+        pit_tick_cycles += now - pit_last_tick;
+        if(now - pit_last_tick > pit_tick_max){
+            pit_tick_max = now - pit_last_tick;
+        }
+    }
+    pit_last_tick = now;
+    if(profile_on){
+        profile_sample(frame[0], frame[1]);
+    }
+    if(++pit_ticks >= pit_slice_ticks){
+        pit_ticks = 0;
+        // the scheduler returns right away unless another process is runnable
         scheduler();
     }
     sti();
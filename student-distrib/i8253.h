@@ -12,8 +12,35 @@
 #define MASK                    0Xff
 #define RIGHT_SHIFT_8           8
 #define DIVIDE_COUNTER          100
+#define PIT_HZ                  DIVIDE_COUNTER  // normal rate, one time slice per tick
+
+// PIT interrupts per time slice, more than 1 while the profiler speeds the PIT up
+extern uint32_t pit_slice_ticks;
+
+// ticks timed since the rate was set or the figures cleared, and the cycles between them
+extern uint32_t pit_tick_count;
+extern uint64_t pit_tick_cycles;
+extern uint64_t pit_tick_max;
+
+// what the tick source counts down from, its clocks per tick
+extern uint32_t pit_divisor;
+
+// time stamp counter cycles per millisecond, timed against the PIT at boot
+extern uint32_t tsc_khz;
 
 // initialize PIT
 void i8253_init();
 
+// run the PIT at hz, a multiple of PIT_HZ, keeping the time slice
+void pit_set_hz(uint32_t hz);
+
+// clocks since the tick source last raised IRQ0
+uint32_t pit_elapsed();
+
+// spin until the next tick starts
+void pit_wait_reload();
+
+// forget the tick timing
+void pit_stat_clear();
+
 #endif /* _I8253_H */
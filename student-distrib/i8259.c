@@ -1,6 +1,7 @@
 
 #include "i8259.h"
 #include "lib.h"
+#include "apic.h"
 
 /* Interrupt masks to determine which interrupts are enabled and disabled */
 uint8_t master_mask; /* IRQs 0-7  */
@@ -39,10 +40,15 @@ void i8259_init(void) {
  * INPUTS: irq_num
  * OUTPUTS:None
  * RETURN VALUE: None
- * SIDE EFFECTS: based on the irq number, unmask interrupt on Master or Slave PIC accordingly
+ * SIDE EFFECTS: based on the irq number, unmask interrupt on Master or Slave PIC accordingly,
+ *               or at the IOAPIC once it has taken over
  */
 void enable_irq(uint32_t irq_num) {  
     if(irq_num<0 || irq_num>15) return;           
+    if(apic_on){
+        apic_enable_irq(irq_num);
+        return;
+    }
     if(irq_num < 8){                                //Check if the irq comes from master or slave
         master_mask &= ~(1 << irq_num);             //enable the master pic, 1 is 0000 0001 
         outb(master_mask,MASTER_8259_DATA_PORT);
@@ -60,10 +66,15 @@ void enable_irq(uint32_t irq_num) {
  * INPUTS: irq_num
  * OUTPUTS:None
  * RETURN VALUE: None
- * SIDE EFFECTS: based on the irq number, mask interrupt on Master or Slave PIC accordingly
+ * SIDE EFFECTS: based on the irq number, mask interrupt on Master or Slave PIC accordingly,
+ *               or at the IOAPIC once it has taken over
  */
 void disable_irq(uint32_t irq_num) {     
     if(irq_num<0 || irq_num>15) return;        
+    if(apic_on){
+        apic_disable_irq(irq_num);
+        return;
+    }
     if(irq_num < 8){                                //Check if the irq comes from master or slave
         master_mask |= (1 << irq_num);              //disable the master pic, 1 is 0000 0001
         outb(master_mask,MASTER_8259_DATA_PORT);
@@ -81,9 +92,14 @@ void disable_irq(uint32_t irq_num) {
  * INPUTS: irq_num
  * OUTPUTS:None
  * RETURN VALUE: None
- * SIDE EFFECTS: based on the irq number, send end-of-interrupt signal to Master or Slave PIC accordingly
+ * SIDE EFFECTS: based on the irq number, send end-of-interrupt signal to Master or Slave PIC accordingly,
+ *               or to the local APIC once it has taken over
  */
 void send_eoi(uint32_t irq_num) {
+    if(apic_on){
+        apic_send_eoi();
+        return;
+    }
     if(irq_num >= 8){     
         outb(EOI|(irq_num-8),SLAVE_8259_COMMAND_PORT);  
 // check if the irq comes from master or slave, if irq from slave, send eoi to both pics.  
@@ -25,6 +25,10 @@
  * to declare the interrupt finished */
 #define EOI                 0x60
 
+/* IRQs masked on each PIC, also what the IOAPIC takes over */
+extern uint8_t master_mask;
+extern uint8_t slave_mask;
+
 /* Externally-visible functions */
 
 /* Initialize both PICs */
@@ -1,5 +1,20 @@
 
 #include "idt.h"
+#include "smp.h"
+
+/* 
+ *exception_spin
+ * DESCRIPTION: stop the program that faulted here for good. The kernel lock is let go
+ *              first, so the other processors, and this one's interrupts, carry on.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: never returns
+ * SIDE EFFECTS: None
+ */
+static void exception_spin(){
+    smp_unlock();
+    while(1);
+}
 
 /* 
  *exception_handler
@@ -7,69 +22,76 @@
  * INPUTS: interrupt index for exceptions
  * OUTPUTS:exception messages 
  * RETURN VALUE: None
- * SIDE EFFECTS: exception messages displayed on the screen
+ * SIDE EFFECTS: exception messages displayed on the screen, the trace sent on COM1
  */
 void exception_handler(int interrupt_idx){
+    if(interrupt_idx == 14){
+        TRACE(TRACE_PAGE_FAULT, read_cr2());
+    }else{
+        TRACE(TRACE_EXCEPTION, interrupt_idx);
+    }
+    // none of the cases below return, send the events that led here while they can be
+    TRACE_DUMP();
     switch(interrupt_idx){
         case 0: printf("Divide-by-zero Error\n");
-            while(1);
+            exception_spin();
             break;
         case 1: printf("Debug\n");
-            while(1);
+            exception_spin();
             break;
         case 2: printf("Non-maskable Interrupt\n");
-            while(1);
+            exception_spin();
             break;
         case 3: printf("Breakpoint\n");
-            while(1);
+            exception_spin();
             break;
         case 4: printf("Overflow\n");
-            while(1);
+            exception_spin();
             break;
         case 5: printf("Bound Range Exceeded\n");
-            while(1);
+            exception_spin();
             break;
         case 6: printf("Invalid Opcode\n");
-            while(1);
+            exception_spin();
             break;
         case 7: printf("Device Not Available\n");
-            while(1);
+            exception_spin();
             break;
         case 8: printf("Double Fault\n");
-            while(1);
+            exception_spin();
             break;
         case 9: printf("Coprocessor Segment Overrun\n");
-            while(1);
+            exception_spin();
             break;
         case 10: printf("Invalid TSS\n");
-            while(1);
+            exception_spin();
             break;
         case 11: printf("Segment Not Present\n");
-            while(1);
+            exception_spin();
             break;
         case 12: printf("Stack-Segment Fault\n");
-            while(1);
+            exception_spin();
             break;
         case 13: printf("General Protection Fault\n");
-            while(1);
+            exception_spin();
             break;
         case 14: printf("Page Fault\n");
-            while(1);
+            exception_spin();
             break;
         case 16: printf("x87 Floating-Point Exception\n");
-            while(1);
+            exception_spin();
             break;
         case 17: printf("Alignment Check\n");
-            while(1);
+            exception_spin();
             break;
         case 18: printf("Machine Check\n");
-            while(1);
+            exception_spin();
             break;
         case 19: printf("SIMD Floating-Point Exception\n");
-            while(1);
+            exception_spin();
             break;
         default: printf("Unknown Exception\n");
-            while(1);
+            exception_spin();
     }
 }
 
@@ -129,8 +151,16 @@ void idt_init(){
     SET_IDT_ENTRY(idt[0x20], pit_handler);
 // set Keyboard Interrupt entry in the IDT table
     SET_IDT_ENTRY(idt[0x21], keyboard_handler);
+// set COM1 Interrupt entry in the IDT table, IRQ 4
+    SET_IDT_ENTRY(idt[0x24], serial_handler);
 // set RTC Interrupt entry in the IDT table
     SET_IDT_ENTRY(idt[0x28], rtc_handler);
+// set ATA Interrupt entry in the IDT table, IRQ 14
+    SET_IDT_ENTRY(idt[0x2E], ata_handler);
+// set the timer entry of the other processors in the IDT table
+    SET_IDT_ENTRY(idt[APIC_AP_TIMER_VECTOR], smp_timer_handler);
+// set the local APIC spurious interrupt entry in the IDT table
+    SET_IDT_ENTRY(idt[0xFF], apic_spurious_handler);
 // set System Call entry in the IDT table
     SET_IDT_ENTRY(idt[0x80], systemcall_handler);
 }
@@ -6,6 +6,7 @@
 #include "types.h"
 #include "IDT_wrappers.h"
 #include "systemcall.h"
+#include "trace.h"
 #define NUM_EXCP  32
 
 // print out the exception messages based on the vector
@@ -0,0 +1,186 @@
+#include "irqstat.h"
+#include "lib.h"
+#include "i8253.h"
+
+#ifdef IRQSTAT_ENABLE
+
+irqoff_site_t irqoff_sites[IRQSTAT_SITES];
+uint32_t irqoff_windows = 0;
+uint32_t irqoff_dropped = 0;
+uint64_t irqoff_max = 0;
+irqoff_site_t* irqoff_max_from = NULL;
+const int8_t* irqoff_max_to = NULL;
+uint32_t irqoff_max_to_line = 0;
+irq_stat_t irq_stats[IRQSTAT_IRQS];
+
+static uint64_t irqoff_start = 0;              // when the open window started, 0 for none
+static const int8_t* irqoff_name = NULL;       // where it started
+static uint32_t irqoff_num = 0;
+static uint64_t irq_entered[IRQSTAT_IRQS];     // when each line's handler was last entered
+
+// EFLAGS now, to tell whether interrupts are on
+static inline uint32_t read_eflags(void) {
+    uint32_t flags;
+    asm volatile ("pushfl; popl %0" : "=r"(flags));
+    return flags;
+}
+
+/*
+ *irqoff_begin
+ * DESCRIPTION: open a window: interrupts went off at name:num. A window still open is
+ *              one that iret closed without telling us, so it is forgotten.
+ * INPUTS: name -- source file, or "irq"
+ *         num -- line, or the interrupt line
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: called with interrupts off, which is all the locking it needs
+ */
+void irqoff_begin(const int8_t* name, uint32_t num){
+    irqoff_start = rdtsc();
+    irqoff_name = name;
+    irqoff_num = num;
+}
+
+/*
+ *irqoff_find
+ * DESCRIPTION: find the slot of a site, claiming a free one the first time it is seen.
+ *              Sites are hashed by name and line and probed linearly. The names are
+ *              __FILE__ strings, compared by address.
+ * INPUTS: name, num -- the site
+ * OUTPUTS:None
+ * RETURN VALUE: the slot, NULL if the table is full
+ * SIDE EFFECTS: None
+ */
+static irqoff_site_t* irqoff_find(const int8_t* name, uint32_t num){
+    uint32_t i, h = (num * 2654435761U + (uint32_t)name) & (IRQSTAT_SITES - 1);
+    irqoff_site_t* site;
+    for(i = 0; i < IRQSTAT_SITES; i++){
+        site = &irqoff_sites[(h + i) & (IRQSTAT_SITES - 1)];
+        if(site->name == name && site->num == num){
+            return site;
+        }
+        if(site->name == NULL){
+            site->name = name;
+            site->num = num;
+            return site;
+        }
+    }
+    return NULL;
+}
+
+/*
+ *irqoff_end
+ * DESCRIPTION: close the open window at file:line and charge its length to the site
+ *              that opened it. If interrupts are already on, iret turned them on since
+ *              the window opened and its length is unknown, so it is dropped.
+ * INPUTS: file, line -- where interrupts are turned on
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: called just before interrupts go on
+ */
+void irqoff_end(const int8_t* file, uint32_t line){
+    uint64_t cycles;
+    irqoff_site_t* site;
+    if(irqoff_start == 0){
+        return;
+    }
+    if(read_eflags() & EFLAGS_IF){
+        irqoff_start = 0;
+        return;
+    }
+    cycles = rdtsc() - irqoff_start;
+    irqoff_start = 0;
+    irqoff_windows++;
+    if((site = irqoff_find(irqoff_name, irqoff_num)) == NULL){
+        irqoff_dropped++;
+        return;
+    }
+    site->count++;
+    site->cycles += cycles;
+    if(cycles > site->max){
+        site->max = cycles;
+    }
+    if(cycles > irqoff_max){
+        irqoff_max = cycles;
+        irqoff_max_from = site;
+        irqoff_max_to = file;
+        irqoff_max_to_line = line;
+    }
+}
+
+/*
+ *irq_enter
+ * DESCRIPTION: note the handler of an interrupt line starting. The cpu turned interrupts
+ *              off to take it, which opens a window. For IRQ0 the PIT counter tells how
+ *              long ago the interrupt was raised; no other device keeps such a clock.
+ * INPUTS: irq -- the interrupt line
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: reads the PIT for IRQ0
+ */
+void irq_enter(uint32_t irq){
+    uint32_t clocks;
+    irq_stat_t* s = &irq_stats[irq & (IRQSTAT_IRQS - 1)];
+    irqoff_begin("irq", irq);
+    irq_entered[irq & (IRQSTAT_IRQS - 1)] = irqoff_start;
+    if(irq == 0){
+        clocks = pit_elapsed();
+        s->latency_count++;
+        s->latency += clocks;
+        if(clocks > s->latency_max){
+            s->latency_max = clocks;
+        }
+    }
+}
+
+/*
+ *irq_exit
+ * DESCRIPTION: note the handler of an interrupt line returning to its wrapper. The PIT
+ *              handler may have switched processes in between; it then comes back here
+ *              when the process it left is switched back to, from the handler entered
+ *              last.
+ * INPUTS: irq -- the interrupt line
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void irq_exit(uint32_t irq){
+    uint64_t cycles;
+    irq_stat_t* s = &irq_stats[irq & (IRQSTAT_IRQS - 1)];
+    if(irq_entered[irq & (IRQSTAT_IRQS - 1)] == 0){
+        return;
+    }
+    cycles = rdtsc() - irq_entered[irq & (IRQSTAT_IRQS - 1)];
+    s->count++;
+    s->cycles += cycles;
+    if(cycles > s->max){
+        s->max = cycles;
+    }
+}
+
+/*
+ *irqstat_clear
+ * DESCRIPTION: forget every figure
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void irqstat_clear(){
+    uint32_t flags;
+    cli_and_save(flags);
+    memset(irqoff_sites, 0, sizeof(irqoff_sites));
+    memset(irq_stats, 0, sizeof(irq_stats));
+    memset(irq_entered, 0, sizeof(irq_entered));
+    irqoff_windows = 0;
+    irqoff_dropped = 0;
+    irqoff_max = 0;
+    irqoff_max_from = NULL;
+    irqoff_max_to = NULL;
+    irqoff_max_to_line = 0;
+    // the window this opened is closed by restore_flags below, and counts from here
+    irqoff_begin(__FILE__, __LINE__);
+    restore_flags(flags);
+}
+
+#endif /* IRQSTAT_ENABLE */
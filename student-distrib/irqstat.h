@@ -0,0 +1,74 @@
+#ifndef _IRQSTAT_H
+#define _IRQSTAT_H
+
+/*
+Interrupt latency statistics. With IRQSTAT_ENABLE the cli, sti, cli_and_save and
+restore_flags macros of lib.h time every window with interrupts off, from the
+place that turned them off to the place that turned them on, and the interrupt
+wrappers time each device interrupt. Remove IRQSTAT_ENABLE to compile all of it
+away. The figures are read from the "irqstat" statistics file.
+*/
+#define IRQSTAT_ENABLE
+
+#define IRQSTAT_SITES       64      // places turning interrupts off that are told apart, a power of 2
+#define IRQSTAT_IRQS        16      // interrupt lines of the two PICs
+#define EFLAGS_IF           0x200   // interrupt enable flag
+
+#ifndef ASM
+
+#include "types.h"
+
+// a place that turned interrupts off: a source file and line, or "irq" and
+// the line for a window opened by the cpu taking a device interrupt
+typedef struct irqoff_site{
+    const int8_t* name;     // NULL for an unused slot
+    uint32_t num;
+    uint32_t count;         // windows it opened
+    uint64_t cycles;        // their total length
+    uint64_t max;           // the longest
+}irqoff_site_t;
+
+typedef struct irq_stat{
+    uint32_t count;         // interrupts taken
+    uint64_t cycles;        // cycles in the handler, wrapper to wrapper
+    uint64_t max;
+    uint32_t latency_count; // interrupts whose latency was measured, only the PIT's can be
+    uint64_t latency;       // PIT clocks from the interrupt being raised to the wrapper
+    uint64_t latency_max;
+}irq_stat_t;
+
+extern irqoff_site_t irqoff_sites[IRQSTAT_SITES];
+extern uint32_t irqoff_windows;            // windows timed
+extern uint32_t irqoff_dropped;            // windows of sites that found no free slot
+extern uint64_t irqoff_max;                // the longest window
+extern irqoff_site_t* irqoff_max_from;     // where it started
+extern const int8_t* irqoff_max_to;        // where it ended, file and line
+extern uint32_t irqoff_max_to_line;
+extern irq_stat_t irq_stats[IRQSTAT_IRQS];
+
+#ifdef IRQSTAT_ENABLE
+#define IRQOFF_BEGIN(flags)  do{ if((flags) & EFLAGS_IF) irqoff_begin(__FILE__, __LINE__); }while(0)
+#define IRQOFF_END(flags)    do{ if((flags) & EFLAGS_IF) irqoff_end(__FILE__, __LINE__); }while(0)
+#else
+#define IRQOFF_BEGIN(flags)  do{}while(0)
+#define IRQOFF_END(flags)    do{}while(0)
+#endif
+
+// interrupts were just turned off at name:num
+void irqoff_begin(const int8_t* name, uint32_t num);
+
+// interrupts are about to be turned on at file:line
+void irqoff_end(const int8_t* file, uint32_t line);
+
+// called by an interrupt wrapper before its handler
+void irq_enter(uint32_t irq);
+
+// called by an interrupt wrapper after its handler
+void irq_exit(uint32_t irq);
+
+// forget every figure
+void irqstat_clear();
+
+#endif /* ASM */
+
+#endif /* _IRQSTAT_H */
@@ -14,6 +14,13 @@
 #include "rtc.h"
 #include "paging.h"
 #include "FileSystem.h"
+#include "systemcall.h"
+#include "ata.h"
+#include "serial.h"
+#include "trace.h"
+#include "bench.h"
+#include "apic.h"
+#include "smp.h"
 
 #define RUN_TESTS
 
@@ -21,14 +28,73 @@
 /* Check if the bit BIT in FLAGS is set. */
 #define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
 
+/* First address past the kernel's bss, from the linker */
+extern uint8_t _end[];
+
+/* Look for "key=<decimal>" on the boot command line and store the number in
+   VALUE. Returns 1 if the option was found, 0 otherwise. */
+static int cmdline_option(const int8_t* cmdline, const int8_t* key, uint32_t* value) {
+    uint32_t key_len = strlen(key);
+    const int8_t* p = cmdline;
+    while (*p != '\0') {
+        /* options start at the beginning of the line or after a space */
+        if ((p == cmdline || *(p - 1) == ' ') && strncmp(p, key, key_len) == 0) {
+            p += key_len;
+            *value = 0;
+            while (*p >= '0' && *p <= '9') {
+                *value = *value * 10 + (*p - '0');
+                p++;
+            }
+            return 1;
+        }
+        p++;
+    }
+    return 0;
+}
+
+/* Look for "key=<word>" on the boot command line and copy the word, up to the
+   next space and at most SIZE - 1 characters, to BUF. Returns 1 if the option
+   was found, 0 otherwise. */
+static int cmdline_string(const int8_t* cmdline, const int8_t* key, int8_t* buf, uint32_t size) {
+    uint32_t key_len = strlen(key);
+    uint32_t len = 0;
+    const int8_t* p = cmdline;
+    while (*p != '\0') {
+        if ((p == cmdline || *(p - 1) == ' ') && strncmp(p, key, key_len) == 0) {
+            p += key_len;
+            while (*p != ' ' && *p != '\0' && len < size - 1) {
+                buf[len++] = *p++;
+            }
+            buf[len] = '\0';
+            return 1;
+        }
+        p++;
+    }
+    return 0;
+}
+
 /* Check if MAGIC is valid and print the Multiboot information structure
    pointed by ADDR. */
 void entry(unsigned long magic, unsigned long addr) {
 
     multiboot_info_t *mbi;
-    uint32_t fs_addr;
+    uint32_t fs_addr = 0;
+    uint32_t mem_upper = 0;
+    uint32_t max_pid = 0;
+    uint32_t fs_disk = 0;
+    uint32_t ata_dma = 1;
+    uint32_t disk_try;
+    uint32_t fs_limit;
+    int fs_disk_given = 0;
+    int8_t bench_list[BENCH_LIST_LEN] = "";
+    uint32_t bench_reps = 0;
+    uint32_t use_apic = 1;
+    uint32_t use_smp = 1;
+    int apic_found = 0;
     /* Clear the screen. */
     clear();
+    /* COM1 carries trace dumps and mirrored output, polled until its interrupt is set up */
+    serial_init();
 
     /* Am I booted by a Multiboot-compliant boot loader? */
     if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
@@ -43,16 +109,37 @@ void entry(unsigned long magic, unsigned long addr) {
     printf("flags = 0x%#x\n", (unsigned)mbi->flags);
 
     /* Are mem_* valid? */
-    if (CHECK_FLAG(mbi->flags, 0))
+    if (CHECK_FLAG(mbi->flags, 0)) {
         printf("mem_lower = %uKB, mem_upper = %uKB\n", (unsigned)mbi->mem_lower, (unsigned)mbi->mem_upper);
+        mem_upper = mbi->mem_upper;
+    }
 
     /* Is boot_device valid? */
     if (CHECK_FLAG(mbi->flags, 1))
         printf("boot_device = 0x%#x\n", (unsigned)mbi->boot_device);
 
     /* Is the command line passed? */
-    if (CHECK_FLAG(mbi->flags, 2))
+    if (CHECK_FLAG(mbi->flags, 2)) {
         printf("cmdline = %s\n", (char *)mbi->cmdline);
+        /* maxpid=N lowers the process limit below what memory allows */
+        cmdline_option((int8_t *)mbi->cmdline, "maxpid=", &max_pid);
+        /* fsdisk=0 or 1 picks the drive holding the filesystem, atadma=0 moves sectors with PIO */
+        fs_disk_given = cmdline_option((int8_t *)mbi->cmdline, "fsdisk=", &fs_disk);
+        cmdline_option((int8_t *)mbi->cmdline, "atadma=", &ata_dma);
+        /* serial=1 copies kernel printf to COM1, serial=2 also what programs write to their terminal */
+        cmdline_option((int8_t *)mbi->cmdline, "serial=", &serial_mirror);
+        /* bench=all or bench=<name>,<name>... times kernel paths before the first shell */
+        cmdline_string((int8_t *)mbi->cmdline, "bench=", bench_list, BENCH_LIST_LEN);
+        cmdline_option((int8_t *)mbi->cmdline, "benchreps=", &bench_reps);
+        /* apic=0 keeps interrupts on the 8259 and the tick on the PIT */
+        cmdline_option((int8_t *)mbi->cmdline, "apic=", &use_apic);
+        /* smp=0 leaves the other processors stopped */
+        cmdline_option((int8_t *)mbi->cmdline, "smp=", &use_smp);
+#ifdef TRACE_ENABLE
+        /* trace=0 boots with event recording off, the "trace" file turns it on */
+        cmdline_option((int8_t *)mbi->cmdline, "trace=", &trace_on);
+#endif
+    }
 
     if (CHECK_FLAG(mbi->flags, 3)) {
         int mod_count = 0;
@@ -143,23 +230,69 @@ void entry(unsigned long magic, unsigned long addr) {
         ltr(KERNEL_TSS);
     }
 
+    /* Point the SYSENTER MSRs at the fast system call entry, which finds
+     * this processor's TSS through them. User programs fall back to
+     * int $0x80 when the cpu lacks SEP. */
+    smp_sysenter_init(0);
+
     /* Initialize devices, memory, filesystem, enable device interrupts on the
      * PIC, any other initialization stuff... */
 
+    /* Find the local APIC and the IOAPIC while the firmware tables can still
+     * be read at their physical addresses */
+    if (use_apic && apic_probe() == 0)
+        apic_found = 1;
+
     /* Init the PIC */
     i8259_init();
     /* Init the IDT */
     idt_init();
-    /* Init the File System */
-    filesystem_init(fs_addr);
-    /* Init the RTC */
-    rtc_init();
     /* Init the Keyboard */
     keyboard_init();
     /* Init the PIT */
     i8253_init();
+    /* Size the process table, which fixes how far the kernel stacks reach down */
+    process_init(mem_upper, max_pid);
+    printf("Process limit: %d\n", max_pid_num);
+    fs_limit = KSTACK_POOL_TOP - max_pid_num * NUM_8KB;
+    /* Init the File System, it may grow up to the kernel stacks. A module that
+     * already reaches them is not used. Without one the image is read from the
+     * start of a disk, the slave (hdb, next to the boot disk) unless fsdisk= names
+     * one, with its inodes and the page cache kept between the kernel and the
+     * stacks. This comes after the PIT so a lost disk interrupt times out. */
+    if (fs_addr != 0 && filesystem_init(fs_addr, fs_limit) != 0) {
+        printf("Filesystem module not mounted, it must end below 0x%#x\n", fs_limit);
+        fs_addr = 0;
+    }
+    if (fs_addr == 0) {
+        for (disk_try = 0; disk_try < 2; disk_try++) {
+            if (!fs_disk_given)
+                fs_disk = 1 - disk_try;
+            if (ata_init(fs_disk, ata_dma) == 0
+                    && filesystem_init_disk(((uint32_t)_end + BLOCK_SIZE - 1) & ~(BLOCK_SIZE - 1), fs_limit) == 0) {
+                printf("Filesystem on disk %d, %d sectors\n", fs_disk, ata_sectors);
+                break;
+            }
+            if (fs_disk_given)
+                break;
+        }
+    }
     /* Init paging */
     paging_init();
+    /* Move the device interrupts from the PIC to the IOAPIC and the tick from
+     * the PIT to the local APIC timer */
+    if (apic_found)
+        apic_init();
+    /* Start the other processors, which idle until their terminal is shown */
+    if (apic_found && use_smp)
+        smp_init();
+    /* The RTC and COM1 hold their line up until served, so an edge the PIC
+     * latched with interrupts off would be lost on the move to the IOAPIC.
+     * Start them once the interrupt controller is settled. */
+    /* Init the RTC */
+    rtc_init();
+    /* Drive COM1 from its interrupt */
+    serial_irq_init();
 
     /* Enable interrupts */
     /* Do not enable the following until after you have set up your
@@ -179,6 +312,9 @@ void entry(unsigned long magic, unsigned long addr) {
     init_terminal();
     /* Clear Screen */
     clear_helper();
+    /* Microbenchmarks asked for on the command line, results on COM1 */
+    if (bench_list[0] != '\0')
+        bench_run(bench_list, bench_reps);
     /* Execute Shell for terminal 1 */
     execute((uint8_t*)"shell");
     /* Spin (nicely, so we don't chew up cycles) */
@@ -1,4 +1,5 @@
 #include "keyboard.h"
+#include "trace.h"
 
 //ASCII code for Keyboard inputs
 char asccode[57] = {                                                                    // normal looktable when no special key is pressed. 57 is the range for all the char will be used in this check point 
@@ -46,6 +47,7 @@ void keyboard_init(void) {
 void keyboard_int_handler() {
     uint8_t keyboard_asccode, keyboard_scancode;
 	 cli();                                                      // mask interrupt
+    TRACE(TRACE_IRQ, IDT_IRQ1);
 
 	keyboard_scancode = inb(DATA_PORT_KEYBOARD_CONTROLLER);      // keyboard scancode from keyboard data port
 	if(keyboard_scancode == 0x38){                               // 0x38 is the scancode for alt pressed
@@ -3,6 +3,7 @@
 
 #include "lib.h"
 #include "terminal.h"
+#include "serial.h"
 #define VIDEO       0xB8000
 #define ATTRIB      0x7
 
@@ -10,6 +11,16 @@ static int screen_x;
 static int screen_y;
 static char* video_mem = (char *)VIDEO;
 
+/* void putc_console(uint8_t c);
+ * Inputs: uint_8* c = character to print
+ * Return Value: void
+ *  Function: Output a character of printf to the console, and to COM1 with serial=1 */
+static void putc_console(uint8_t c) {
+    putc(c);
+    if (serial_mirror >= SERIAL_MIRROR_KERNEL)
+        serial_console_putc(c);
+}
+
 /* void clear(void);
  * Inputs: void
  * Return Value: none
@@ -71,7 +82,7 @@ format_char_switch:
                     switch (*buf) {
                         /* Print a literal '%' character */
                         case '%':
-                            putc('%');
+                            putc_console('%');
                             break;
 
                         /* Use alternate formatting */
@@ -133,7 +144,7 @@ format_char_switch:
 
                         /* Print a single character */
                         case 'c':
-                            putc((uint8_t) *((int32_t *)esp));
+                            putc_console((uint8_t) *((int32_t *)esp));
                             esp++;
                             break;
 
@@ -151,7 +162,7 @@ format_char_switch:
                 break;
 
             default:
-                putc(*buf);
+                putc_console(*buf);
                 break;
         }
         buf++;
@@ -166,7 +177,7 @@ format_char_switch:
 int32_t puts(int8_t* s) {
     register int32_t index = 0;
     while (s[index] != '\0') {
-        putc(s[index]);
+        putc_console(s[index]);
         index++;
     }
     return index;
@@ -220,6 +231,30 @@ void clearln(){
     update_cursor();
 }
 
+static int32_t cursor_hold_count = 0;                                          // nesting depth of hold_cursor
+
+/*
+void hold_cursor;
+Input: None;
+Return Value: None;
+Function: Stop update_cursor from touching the VGA cursor until the matching release_cursor
+*/
+void hold_cursor(){
+    cursor_hold_count++;
+}
+
+/*
+void release_cursor;
+Input: None;
+Return Value: None;
+Function: Undo one hold_cursor, and move the cursor once when the last hold is released
+*/
+void release_cursor(){
+    if(cursor_hold_count > 0 && --cursor_hold_count == 0){
+        update_cursor();
+    }
+}
+
 /*
 void update_cursor;
 Input:None;
@@ -227,6 +262,9 @@ Return Value: None;
 Function: Change the position of cursor to the end of last char
 */
 void update_cursor(){                                                           //adapted from https://wiki.osdev.org/Text_Mode_Cursor
+    if(cursor_hold_count > 0){                                                  // a vectored write moves the cursor once at the end
+        return;
+    }
     uint16_t pos = screen_y * NUM_COLS + screen_x;
 
     outb(0x0F, 0X3D4);                                                          
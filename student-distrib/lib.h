@@ -9,6 +9,7 @@
 #define NUM_COLS    80
 #define NUM_ROWS    25
 #include "types.h"
+#include "irqstat.h"
 
 // clear video memory
 void clear(void);
@@ -34,6 +35,12 @@ void clearln();
 // update the cursor location on the screen
 void update_cursor();
 
+// defer cursor updates while a batch of characters is written
+void hold_cursor();
+
+// end a hold_cursor batch and update the cursor once
+void release_cursor();
+
 // modified version of putc, supporting scrolling
 void putc_modified(uint8_t c);
 
@@ -162,14 +169,63 @@ do {                                    \
 /* Writes four bytes to four consecutive ports */
 #define outl(data, port)                \
 do {                                    \
-    asm volatile ("outl %l1, (%w0)"     \
+    asm volatile ("outl %k1, (%w0)"     \
             :                           \
             : "d"(port), "a"(data)      \
             : "memory", "cc"            \
     );                                  \
 } while (0)
 
+/* Writes a model specific register, "lo" and "hi" are its low and
+ * high 32 bits */
+#define wrmsr(msr, lo, hi)              \
+do {                                    \
+    asm volatile ("wrmsr"               \
+            :                           \
+            : "c"(msr), "a"(lo), "d"(hi) \
+            : "memory"                  \
+    );                                  \
+} while (0)
+
+/* Reads a model specific register */
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint64_t value;
+    asm volatile ("rdmsr" : "=A"(value) : "c"(msr));
+    return value;
+}
+
+/* Runs cpuid for the given leaf and returns the feature flags in edx */
+static inline uint32_t cpuid_edx(uint32_t leaf) {
+    uint32_t eax, ebx, ecx, edx;
+    asm volatile ("cpuid"
+            : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+            : "a"(leaf)
+    );
+    return edx;
+}
+
+/* Reads the time stamp counter */
+static inline uint64_t rdtsc(void) {
+    uint64_t tsc;
+    asm volatile ("rdtsc" : "=A"(tsc));
+    return tsc;
+}
+
+/* Reads the linear address of the last page fault */
+static inline uint32_t read_cr2(void) {
+    uint32_t addr;
+    asm volatile ("movl %%cr2, %0" : "=r"(addr));
+    return addr;
+}
+
 /* Clear interrupt flag - disables interrupts on this processor */
+#ifdef IRQSTAT_ENABLE
+#define cli()                           \
+do {                                    \
+    uint32_t cli_flags_;                \
+    cli_and_save(cli_flags_);           \
+} while (0)
+#else
 #define cli()                           \
 do {                                    \
     asm volatile ("cli"                 \
@@ -178,6 +234,7 @@ do {                                    \
             : "memory", "cc"            \
     );                                  \
 } while (0)
+#endif
 
 /* Save flags and then clear interrupt flag
  * Saves the EFLAGS register into the variable "flags", and then
@@ -193,11 +250,13 @@ do {                                    \
             :                           \
             : "memory", "cc"            \
     );                                  \
+    IRQOFF_BEGIN(flags);                \
 } while (0)
 
 /* Set interrupt flag - enable interrupts on this processor */
 #define sti()                           \
 do {                                    \
+    IRQOFF_END(EFLAGS_IF);              \
     asm volatile ("sti"                 \
             :                           \
             :                           \
@@ -210,6 +269,7 @@ do {                                    \
  * after a cli_and_save_flags(flags) */
 #define restore_flags(flags)            \
 do {                                    \
+    IRQOFF_END(flags);                  \
     asm volatile ("                   \n\
             pushl %0                  \n\
             popfl                     \n\
@@ -0,0 +1,406 @@
+#include "pagecache.h"
+#include "FileSystem.h"
+#include "lib.h"
+
+#define PCACHE_HASH(inode, block) (((inode) * 31 + (block)) & (PCACHE_HASH_NUM - 1))
+
+static uint8_t (*pcache_data)[BLOCK_SIZE];     // PCACHE_NUM blocks given to pcache_init
+static pcache_entry_t pcache[PCACHE_NUM];
+static int16_t pcache_hash[PCACHE_HASH_NUM];   // first slot of each bucket
+static int16_t lru_head;                        // most recently used slot
+static int16_t lru_tail;                        // least recently used slot, evicted first
+
+uint32_t pcache_hits;
+uint32_t pcache_misses;
+uint32_t pcache_readaheads;
+
+/*
+ *pcache_init
+ * DESCRIPTION: empty the page cache and reset its counters
+ * INPUTS: data -- PCACHE_NUM blocks to hold the cached copies, NULL when nothing is read
+ *                 through the cache
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: every slot is free and on the LRU list
+ */
+void pcache_init(uint8_t* data){
+    int i;
+    pcache_data = (uint8_t (*)[BLOCK_SIZE])data;
+    for(i = 0; i < PCACHE_HASH_NUM; i++){
+        pcache_hash[i] = PCACHE_NONE;
+    }
+    for(i = 0; i < PCACHE_NUM; i++){
+        pcache[i].inode = PCACHE_NONE;
+        pcache[i].block = 0;
+        pcache[i].lru_prev = i - 1;
+        pcache[i].lru_next = (i == PCACHE_NUM - 1) ? PCACHE_NONE : i + 1;
+        pcache[i].hash_next = PCACHE_NONE;
+        pcache[i].dirty = 0;
+        pcache[i].req.dir = BLK_READ;
+        pcache[i].req.status = BLK_DONE;
+        pcache[i].req.next = NULL;
+    }
+    lru_head = 0;
+    lru_tail = PCACHE_NUM - 1;
+    pcache_hits = 0;
+    pcache_misses = 0;
+    pcache_readaheads = 0;
+}
+
+/*
+ *lru_unlink
+ * DESCRIPTION: take a slot off the LRU list
+ * INPUTS: slot
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+static void lru_unlink(int16_t slot){
+    if(pcache[slot].lru_prev != PCACHE_NONE){
+        pcache[pcache[slot].lru_prev].lru_next = pcache[slot].lru_next;
+    }else{
+        lru_head = pcache[slot].lru_next;
+    }
+    if(pcache[slot].lru_next != PCACHE_NONE){
+        pcache[pcache[slot].lru_next].lru_prev = pcache[slot].lru_prev;
+    }else{
+        lru_tail = pcache[slot].lru_prev;
+    }
+}
+
+/*
+ *lru_touch
+ * DESCRIPTION: make a slot the most recently used one
+ * INPUTS: slot
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+static void lru_touch(int16_t slot){
+    if(slot == lru_head){
+        return;
+    }
+    lru_unlink(slot);
+    pcache[slot].lru_prev = PCACHE_NONE;
+    pcache[slot].lru_next = lru_head;
+    pcache[lru_head].lru_prev = slot;
+    lru_head = slot;
+}
+
+/*
+ *lru_drop
+ * DESCRIPTION: make a slot the next one to be evicted
+ * INPUTS: slot
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+static void lru_drop(int16_t slot){
+    if(slot == lru_tail){
+        return;
+    }
+    lru_unlink(slot);
+    pcache[slot].lru_next = PCACHE_NONE;
+    pcache[slot].lru_prev = lru_tail;
+    pcache[lru_tail].lru_next = slot;
+    lru_tail = slot;
+}
+
+/*
+ *hash_remove
+ * DESCRIPTION: take a tagged slot out of its hash bucket and mark it free
+ * INPUTS: slot
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+static void hash_remove(int16_t slot){
+    int16_t* link = &pcache_hash[PCACHE_HASH(pcache[slot].inode, pcache[slot].block)];
+    while(*link != PCACHE_NONE && *link != slot){
+        link = &pcache[*link].hash_next;
+    }
+    if(*link == slot){
+        *link = pcache[slot].hash_next;
+    }
+    pcache[slot].inode = PCACHE_NONE;
+}
+
+/*
+ *pcache_lookup
+ * DESCRIPTION: find the slot holding a file block without filling it or counting a hit
+ * INPUTS: inode, block
+ * OUTPUTS:None
+ * RETURN VALUE: the slot, PCACHE_NONE if the block is not cached
+ * SIDE EFFECTS: None
+ */
+int32_t pcache_lookup(uint32_t inode, uint32_t block){
+    int16_t slot = pcache_hash[PCACHE_HASH(inode, block)];
+    while(slot != PCACHE_NONE && (pcache[slot].inode != (int32_t)inode || pcache[slot].block != block)){
+        slot = pcache[slot].hash_next;
+    }
+    return slot;
+}
+
+/*
+ *pcache_clean
+ * DESCRIPTION: write a dirty slot back to the disk, before it is reused or dropped
+ * INPUTS: slot
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: the slot is clean afterwards. A failed write loses the block, since an
+ *               eviction has nobody to report to; pcache_flush reports its failures.
+ */
+static void pcache_clean(int16_t slot){
+    if(pcache[slot].dirty){
+        blk_rw(FS_DATA_BLOCK(pcache[slot].data_block) * BLK_SECTORS_PER_BLOCK, BLK_SECTORS_PER_BLOCK, pcache_data[slot], BLK_WRITE);
+    }
+    pcache[slot].dirty = 0;
+}
+
+/*
+ *pcache_claim
+ * DESCRIPTION: evict the least recently used slot and tag it with a file block, leaving
+ *              its data for the caller to fill
+ * INPUTS: inode, block
+ * OUTPUTS:None
+ * RETURN VALUE: the slot, PCACHE_NONE if the block is not part of the file
+ * SIDE EFFECTS: the slot becomes the most recently used one
+ */
+static int32_t pcache_claim(uint32_t inode, uint32_t block){
+    int16_t slot;
+    int32_t data_block = get_datablock_num(inode, block);  // may itself fill an indirect block
+    if(data_block == -1){
+        return PCACHE_NONE;
+    }
+    slot = lru_tail;
+    pcache_clean(slot);
+    if(pcache[slot].inode != PCACHE_NONE){
+        hash_remove(slot);
+    }
+    pcache[slot].inode = inode;
+    pcache[slot].block = block;
+    pcache[slot].data_block = data_block;
+    pcache[slot].hash_next = pcache_hash[PCACHE_HASH(inode, block)];
+    pcache_hash[PCACHE_HASH(inode, block)] = slot;
+    lru_touch(slot);
+    return slot;
+}
+
+/*
+ *pcache_fill
+ * DESCRIPTION: claim a slot for a file block and queue its read from the disk. The caller
+ *              runs the block queue before using the slot.
+ * INPUTS: inode, block
+ * OUTPUTS:None
+ * RETURN VALUE: the slot, PCACHE_NONE if the block is not part of the file or the disk
+ *               refused the read
+ * SIDE EFFECTS: the filled slot becomes the most recently used one
+ */
+static int32_t pcache_fill(uint32_t inode, uint32_t block){
+    int32_t slot = pcache_claim(inode, block);
+    if(slot == PCACHE_NONE){
+        return PCACHE_NONE;
+    }
+    pcache[slot].req.sector = FS_DATA_BLOCK(pcache[slot].data_block) * BLK_SECTORS_PER_BLOCK;
+    pcache[slot].req.count = BLK_SECTORS_PER_BLOCK;
+    pcache[slot].req.buf = pcache_data[slot];
+    pcache[slot].req.dir = BLK_READ;
+    if(blk_submit(&pcache[slot].req) == -1){
+        hash_remove(slot);
+        lru_drop(slot);
+        return PCACHE_NONE;
+    }
+    return slot;
+}
+
+/*
+ *pcache_reap
+ * DESCRIPTION: drop the slots whose disk read failed
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: the dropped slots are evicted first
+ */
+static void pcache_reap(){
+    int16_t i;
+    for(i = 0; i < PCACHE_NUM; i++){
+        if(pcache[i].req.dir == BLK_READ && pcache[i].req.status == BLK_ERROR){
+            pcache[i].req.status = BLK_DONE;
+            if(pcache[i].inode != PCACHE_NONE){
+                hash_remove(i);
+                lru_drop(i);
+            }
+        }
+    }
+}
+
+/*
+ *pcache_get
+ * DESCRIPTION: get the cached copy of a file block. A miss reads the block, then up to
+ *              PCACHE_READAHEAD following blocks that lie right after it on disk. The block
+ *              layer merges those reads into one command.
+ * INPUTS: inode, block
+ * OUTPUTS:None
+ * RETURN VALUE: the 4KB copy of the block, NULL if the block is not part of the file or
+ *               could not be read
+ * SIDE EFFECTS: counts a hit or a miss, the block becomes the most recently used one
+ */
+uint8_t* pcache_get(uint32_t inode, uint32_t block){
+    int32_t slot = pcache_lookup(inode, block);
+    uint32_t i, run;
+    if(slot != PCACHE_NONE){
+        pcache_hits++;
+        lru_touch(slot);
+        return pcache_data[slot];
+    }
+    pcache_misses++;
+    if((slot = pcache_fill(inode, block)) == PCACHE_NONE){
+        return NULL;
+    }
+    // each fill evicts the tail, and so may the up to two indirect blocks it looks up, so
+    // stop before the block just filled could reach it
+    run = run_length(inode, block);
+    for(i = 1; i < run && i <= PCACHE_READAHEAD && 3 * i < PCACHE_NUM - 1; i++){
+        if(pcache_lookup(inode, block + i) == PCACHE_NONE && pcache_fill(inode, block + i) != PCACHE_NONE){
+            pcache_readaheads++;
+        }
+    }
+    blk_run();
+    pcache_reap();
+    if(pcache[slot].inode == PCACHE_NONE){
+        return NULL;
+    }
+    lru_touch(slot);
+    return pcache_data[slot];
+}
+
+/*
+ *pcache_slot_data
+ * DESCRIPTION: get the data of a slot remembered by a caller, if the slot still holds the block
+ * INPUTS: slot, inode, block
+ * OUTPUTS:None
+ * RETURN VALUE: the 4KB copy of the block, NULL if the slot was reused or dropped
+ * SIDE EFFECTS: counts a hit when the slot is still valid
+ */
+uint8_t* pcache_slot_data(int32_t slot, uint32_t inode, uint32_t block){
+    if(slot < 0 || slot >= PCACHE_NUM || pcache[slot].inode != (int32_t)inode || pcache[slot].block != block){
+        return NULL;
+    }
+    pcache_hits++;
+    lru_touch(slot);
+    return pcache_data[slot];
+}
+
+/*
+ *pcache_zero
+ * DESCRIPTION: get a zeroed copy of a file block without reading the disk, for a block that
+ *              was just allocated or is about to be overwritten whole. Only used when the
+ *              image is on disk, where the cached copy is written back later.
+ * INPUTS: inode, block
+ * OUTPUTS:None
+ * RETURN VALUE: the 4KB copy of the block, NULL if the block is not part of the file
+ * SIDE EFFECTS: the copy is dirty and becomes the most recently used one
+ */
+uint8_t* pcache_zero(uint32_t inode, uint32_t block){
+    int32_t slot = pcache_lookup(inode, block);
+    if(slot == PCACHE_NONE && (slot = pcache_claim(inode, block)) == PCACHE_NONE){
+        return NULL;
+    }
+    memset(pcache_data[slot], 0, BLOCK_SIZE);
+    pcache[slot].dirty = 1;
+    lru_touch(slot);
+    return pcache_data[slot];
+}
+
+/*
+ *pcache_mark_dirty
+ * DESCRIPTION: mark the cached copy of a file block as newer than the disk, after the caller
+ *              changed it. Only used when the image is on disk.
+ * INPUTS: inode, block
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void pcache_mark_dirty(uint32_t inode, uint32_t block){
+    int32_t slot = pcache_lookup(inode, block);
+    if(slot != PCACHE_NONE){
+        pcache[slot].dirty = 1;
+    }
+}
+
+/*
+ *pcache_flush
+ * DESCRIPTION: write every dirty block back to the disk. The writes are queued together, so
+ *              dirty blocks that are neighbours on disk go out in one command, along with
+ *              anything else the caller queued.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: the number of blocks written, -1 if a write failed
+ * SIDE EFFECTS: the blocks written are clean, the failed ones stay dirty
+ */
+int32_t pcache_flush(){
+    int16_t i;
+    int32_t count = 0, failed = 0;
+    for(i = 0; i < PCACHE_NUM; i++){
+        if(!pcache[i].dirty){
+            continue;
+        }
+        pcache[i].req.sector = FS_DATA_BLOCK(pcache[i].data_block) * BLK_SECTORS_PER_BLOCK;
+        pcache[i].req.count = BLK_SECTORS_PER_BLOCK;
+        pcache[i].req.buf = pcache_data[i];
+        pcache[i].req.dir = BLK_WRITE;
+        if(blk_submit(&pcache[i].req) == -1){
+            pcache[i].req.status = BLK_ERROR;
+        }
+    }
+    blk_run();
+    for(i = 0; i < PCACHE_NUM; i++){
+        if(!pcache[i].dirty){
+            continue;
+        }
+        if(pcache[i].req.status == BLK_DONE){
+            pcache[i].dirty = 0;
+            count++;
+        }else{
+            failed = 1;
+        }
+    }
+    return failed ? -1 : count;
+}
+
+/*
+ *pcache_forget
+ * DESCRIPTION: drop one cached block, after its data block was freed
+ * INPUTS: inode, block
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: a dirty copy is dropped too
+ */
+void pcache_forget(uint32_t inode, uint32_t block){
+    int32_t slot = pcache_lookup(inode, block);
+    if(slot != PCACHE_NONE){
+        pcache[slot].dirty = 0;
+        hash_remove(slot);
+        lru_drop(slot);
+    }
+}
+
+/*
+ *pcache_invalidate
+ * DESCRIPTION: drop the cached blocks of a file from a block on, after those blocks were
+ *              freed. Dirty copies are dropped too, the blocks no longer hold file data.
+ * INPUTS: inode, first -- first block index to drop
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: the dropped slots are evicted first
+ */
+void pcache_invalidate(uint32_t inode, uint32_t first){
+    int16_t i;
+    for(i = 0; i < PCACHE_NUM; i++){
+        if(pcache[i].inode == (int32_t)inode && pcache[i].block >= first){
+            pcache[i].dirty = 0;
+            hash_remove(i);
+            lru_drop(i);
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef _PAGECACHE_H
+#define _PAGECACHE_H
+
+#include "types.h"
+#include "blk.h"
+
+#define PCACHE_NUM        64        // cached 4KB blocks
+#define PCACHE_HASH_NUM   64        // hash buckets, a power of 2
+#define PCACHE_READAHEAD  4         // blocks of the same run filled after a miss
+#define PCACHE_NONE       -1        // end of a list, or no slot
+
+// one cached block of a file
+typedef struct pcache_entry{
+    int32_t inode;          // PCACHE_NONE if the slot is free
+    uint32_t block;         // block index within the file
+    int16_t lru_prev;       // toward the most recently used slot
+    int16_t lru_next;       // toward the least recently used slot
+    int16_t hash_next;      // next slot in the same hash bucket
+    uint8_t dirty;          // 1 if the copy is newer than the disk
+    uint32_t data_block;    // data block holding the block, where the copy is read from and written to
+    blk_request_t req;      // disk transfer of the slot
+}pcache_entry_t;
+
+// lookups served from the cache
+extern uint32_t pcache_hits;
+
+// lookups that had to fill a slot from the store
+extern uint32_t pcache_misses;
+
+// blocks filled ahead of a miss
+extern uint32_t pcache_readaheads;
+
+// empty the cache, which keeps its copies in PCACHE_NUM blocks at data
+void pcache_init(uint8_t* data);
+
+// get the cached copy of a file block, filling it on a miss
+uint8_t* pcache_get(uint32_t inode, uint32_t block);
+
+// get the slot holding a file block, or PCACHE_NONE, without filling it
+int32_t pcache_lookup(uint32_t inode, uint32_t block);
+
+// get the data of a slot if it still holds the given file block
+uint8_t* pcache_slot_data(int32_t slot, uint32_t inode, uint32_t block);
+
+// get a zeroed, dirty copy of a file block without reading it
+uint8_t* pcache_zero(uint32_t inode, uint32_t block);
+
+// mark the cached copy of a file block as newer than the disk
+void pcache_mark_dirty(uint32_t inode, uint32_t block);
+
+// write every dirty block back to the disk
+int32_t pcache_flush();
+
+// drop one cached block
+void pcache_forget(uint32_t inode, uint32_t block);
+
+// drop the cached blocks of a file from a block on
+void pcache_invalidate(uint32_t inode, uint32_t first);
+
+#endif /* _PAGECACHE_H */
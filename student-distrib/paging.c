@@ -1,8 +1,27 @@
 #include "paging.h"
+#include "FileSystem.h"
+#include "smp.h"
 
 page_directory_t page_directory[ONE_K] __attribute__ ((aligned(FOUR_K)));
 page_table_t page_table[ONE_K]  __attribute__ ((aligned(FOUR_K)));
 page_table_t page_table_video[ONE_K] __attribute__ ((aligned(FOUR_K)));
+// the other processors' copies, each maps the user pages of the process it runs
+static page_directory_t page_directory_ap[APIC_MAX_CPUS - 1][ONE_K] __attribute__ ((aligned(FOUR_K)));
+static page_table_t page_table_video_ap[APIC_MAX_CPUS - 1][ONE_K] __attribute__ ((aligned(FOUR_K)));
+page_table_t page_table_mmap[MMAP_TABLE_NUM][ONE_K] __attribute__ ((aligned(FOUR_K)));
+static uint8_t mmap_bounce[MMAP_BOUNCE_NUM][FOUR_K] __attribute__ ((aligned(FOUR_K)));
+static int32_t mmap_bounce_owner[MMAP_BOUNCE_NUM];  // pid using each bounce page, -1 if free
+
+/* the page directory and video page table of the processor running this */
+static page_directory_t* cpu_page_directory(){
+    uint32_t index = smp_cpu_index();
+    return index == 0 ? page_directory : page_directory_ap[index - 1];
+}
+
+static page_table_t* cpu_page_table_video(){
+    uint32_t index = smp_cpu_index();
+    return index == 0 ? page_table_video : page_table_video_ap[index - 1];
+}
 /* 
  *paging_int
  * DESCRIPTION: initialize paging
@@ -54,6 +73,14 @@ void paging_init(){
         page_table_video[i].avail = 0;
         page_table_video[i].addr = i;
     }
+    // the mmap tables start empty, map_file_page fills in read-only user pages
+    for(i = 0; i < MMAP_TABLE_NUM * ONE_K; i++){
+        page_table_mmap[i / ONE_K][i % ONE_K].val[0] = 0;
+        page_table_mmap[i / ONE_K][i % ONE_K].us = 1;
+    }
+    for(i = 0; i < MMAP_BOUNCE_NUM; i++){
+        mmap_bounce_owner[i] = -1;
+    }
     page_table[184].p = 1;      // set the video memory virtual address 0XB8000                                  ; B8 is equivalent to 184
     page_table[184].us = 1;
     page_table[185].p = 1;      // set the video memory (for back buffer of terminal 1) virtual address 0XB9000  ; B9 is equivalent to 185
@@ -76,7 +103,8 @@ void paging_init(){
 
 /* 
  * map_program
- * DESCRIPTION: This function is used to load in the page and map the program.
+ * DESCRIPTION: This function is used to load in the page and map the program, in the
+ *              page directory of this processor.
  * INPUTS: pid - process number
  * OUTPUTS:None
  * RETURN VALUE: None
@@ -85,6 +113,7 @@ void paging_init(){
 void map_program(uint32_t pid){
     // physical memory starts at 8MB + (process number * 4MB)
     uint32_t addr = NUMBER_8MB + pid * NUMBER_4MB; //8MB + pid*4MB
+    page_directory_t* page_directory = cpu_page_directory();
     page_directory[USER_PAGE_NUM].p = 1;  // set Present (P) flag to be 1. Indicates whether the page or page
     page_directory[USER_PAGE_NUM].rw = 1; // set Read/write (R/W) flag to be 1
     page_directory[USER_PAGE_NUM].us = 1; // set User/supervisor (U/S) flag to be 1
@@ -97,6 +126,11 @@ void map_program(uint32_t pid){
     page_directory[USER_PAGE_NUM].avail = 0;
     page_directory[USER_PAGE_NUM].reserved = 0;
     page_directory[USER_PAGE_NUM].addr = (addr>>PAGING_OFFSET); 
+    // each pid has its own mmap page table, the pages themselves are read-only
+    page_directory[MMAP_PAGE_NUM].p = 1;
+    page_directory[MMAP_PAGE_NUM].us = 1;
+    page_directory[MMAP_PAGE_NUM].ps = 0;
+    page_directory[MMAP_PAGE_NUM].addr = (unsigned int)page_table_mmap[pid] >> PAGING_OFFSET;
     flush_tlb();
     return;
 }
@@ -122,13 +156,16 @@ void flush_tlb(){
 
 /* 
  * vidmap_paging
- * DESCRIPTION: This function is used to map virtual memory for video mem to physical.
+ * DESCRIPTION: This function is used to map virtual memory for video mem to physical,
+ *              for the process this processor runs.
  * INPUTS: None
  * OUTPUTS:None
  * RETURN VALUE: None
  * SIDE EFFECTS: map video memory
  */
 void vidmap_paging(){
+    page_directory_t* page_directory = cpu_page_directory();
+    page_table_t* page_table_video = cpu_page_table_video();
     page_directory[VIDEO_PAGE_NUM].addr = (unsigned int)page_table_video >> 12;
     page_directory[VIDEO_PAGE_NUM].p = 1;                                    // set to be present
     page_directory[VIDEO_PAGE_NUM].us = 1;                                   // set to user
@@ -143,4 +180,152 @@ void vidmap_paging(){
     return;
 }
 
+/* 
+ * map_file_page
+ * DESCRIPTION: This function maps one filesystem block read-only into the mmap region of a pid.
+ *              A page-aligned block is mapped in place; otherwise, or when asked to copy, the
+ *              block is copied into a bounce page owned by the pid and that page is mapped instead.
+ * INPUTS: pid - process number
+ *         page - page index within the mmap region
+ *         block - address of the 4KB data block
+ *         copy - 1 if the block may be reused, such as a page cache slot, and must be copied
+ * OUTPUTS:None
+ * RETURN VALUE: 0 on success, -1 if the page is out of range, block is NULL or no bounce page is free
+ * SIDE EFFECTS: the caller flushes the TLB once all pages are mapped. A block mapped in place
+ *               is counted, so the filesystem does not free it until it is unmapped.
+ */
+int32_t map_file_page(uint32_t pid, uint32_t page, const uint8_t* block, uint32_t copy){
+    int i;
+    if(pid >= MMAP_TABLE_NUM || page >= ONE_K || block == NULL){
+        return -1;
+    }
+    if(copy || ((uint32_t)block & (FOUR_K - 1))){
+        for(i = 0; i < MMAP_BOUNCE_NUM && mmap_bounce_owner[i] != -1; i++);
+        if(i == MMAP_BOUNCE_NUM){
+            return -1;
+        }
+        mmap_bounce_owner[i] = (int32_t)pid;
+        memcpy(mmap_bounce[i], block, FOUR_K);
+        block = mmap_bounce[i];
+    }else if(fs_map_block(block) == -1){
+        return -1;      // the block in place stays put while the page maps it
+    }
+    page_table_mmap[pid][page].addr = (uint32_t)block >> PAGING_OFFSET;
+    page_table_mmap[pid][page].rw = 0;      // mapped files are read-only
+    page_table_mmap[pid][page].p = 1;
+    return 0;
+}
+
+/* 
+ * unmap_file_pages
+ * DESCRIPTION: This function clears a range of the mmap region of a pid, and frees the
+ *              bounce pages that were mapped there.
+ * INPUTS: pid - process number
+ *         first - first page index to clear
+ *         count - number of pages to clear
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: the caller flushes the TLB
+ */
+void unmap_file_pages(uint32_t pid, uint32_t first, uint32_t count){
+    uint32_t page;
+    int i;
+    if(pid >= MMAP_TABLE_NUM){
+        return;
+    }
+    for(page = first; page < first + count && page < ONE_K; page++){
+        if(!page_table_mmap[pid][page].p){
+            continue;
+        }
+        for(i = 0; i < MMAP_BOUNCE_NUM; i++){
+            if(page_table_mmap[pid][page].addr == (uint32_t)mmap_bounce[i] >> PAGING_OFFSET){
+                mmap_bounce_owner[i] = -1;
+                break;
+            }
+        }
+        if(i == MMAP_BOUNCE_NUM){
+            fs_unmap_block((uint8_t*)(page_table_mmap[pid][page].addr << PAGING_OFFSET));
+        }
+        page_table_mmap[pid][page].p = 0;
+    }
+}
 
+/* 
+ * unmap_files
+ * DESCRIPTION: This function clears the whole mmap region of a pid.
+ * INPUTS: pid - process number
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void unmap_files(uint32_t pid){
+    unmap_file_pages(pid, 0, ONE_K);
+}
+
+/* 
+ * map_mmio
+ * DESCRIPTION: This function maps the 4MB page holding memory mapped device registers,
+ *              such as the APICs', at the same virtual address, for the kernel only and
+ *              with caching off so every access reaches the device.
+ * INPUTS: addr - physical address of the registers
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: flushes the TLB
+ */
+void map_mmio(uint32_t addr){
+    uint32_t pde = addr >> 22;      // 4MB per page directory entry
+    page_directory[pde].p = 1;
+    page_directory[pde].rw = 1;
+    page_directory[pde].us = 0;
+    page_directory[pde].pwt = 1;
+    page_directory[pde].pcd = 1;
+    page_directory[pde].ps = 1;
+    page_directory[pde].g = 1;
+    page_directory[pde].addr = (pde << 22) >> PAGING_OFFSET;
+    flush_tlb();
+}
+
+/* 
+ * map_low_page
+ * DESCRIPTION: This function maps or unmaps one 4KB page of the first 4MB at the same
+ *              virtual address, for the kernel only, such as the page the other
+ *              processors start in.
+ * INPUTS: addr - physical address below 4MB
+ *         present - 1 to map the page, 0 to unmap it
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: flushes the TLB
+ */
+void map_low_page(uint32_t addr, uint32_t present){
+    if(addr >= NUMBER_4MB){
+        return;
+    }
+    page_table[addr >> PAGING_OFFSET].us = 0;
+    page_table[addr >> PAGING_OFFSET].p = present;
+    flush_tlb();
+}
+
+/* 
+ * paging_init_ap
+ * DESCRIPTION: This function turns paging on for a processor started after the booting
+ *              one, on a page directory of its own. It copies the kernel's entries of
+ *              the booting processor's, which smp_init no longer changes; the user,
+ *              video and mmap entries are filled in as processes run here.
+ * INPUTS: index - the processor, in cpus
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: Load CR3, CR4, CR0
+ */
+void paging_init_ap(uint32_t index){
+    page_directory_t* dir = page_directory_ap[index - 1];
+    int i;
+    memcpy(dir, page_directory, sizeof(page_directory));
+    dir[USER_PAGE_NUM].p = 0;
+    dir[VIDEO_PAGE_NUM].p = 0;
+    dir[MMAP_PAGE_NUM].p = 0;
+    memcpy(page_table_video_ap[index - 1], page_table_video, sizeof(page_table_video));
+    for(i = 0; i < PAGE_SIZE; i++){
+        page_table_video_ap[index - 1][i].p = 0;
+    }
+    enable_paging((void*)dir);
+}
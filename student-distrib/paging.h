@@ -15,6 +15,9 @@
 #define USER_PAGE_NUM 32
 #define VIDEO_PAGE_NUM 33
 #define VID_MEM   0xB8
+#define MMAP_PAGE_NUM 34        // 136MB - 140MB holds files mapped by mmap
+#define MMAP_TABLE_NUM 64       // one mmap page table per pid, matches MAX_PID_NUM
+#define MMAP_BOUNCE_NUM 16      // pages for blocks that are not page aligned in the image
 // intel manual 3-24 Figure 3-14. Format of Page-Directory and Page-Table Entries for 4-KByte Pages
 // and 32-Bit Physical Addresses
 // page directory struct
@@ -69,5 +72,23 @@ void flush_tlb();
 // video paging map
 void vidmap_paging();
 
+// map one filesystem block read-only at a page of the pid's mmap region
+int32_t map_file_page(uint32_t pid, uint32_t page, const uint8_t* block, uint32_t copy);
+
+// drop count mmap pages of a pid starting at first, freeing their bounce pages
+void unmap_file_pages(uint32_t pid, uint32_t first, uint32_t count);
+
+// drop every mmap page of a pid
+void unmap_files(uint32_t pid);
+
+// map the 4MB holding a device's registers at its own address, uncached
+void map_mmio(uint32_t addr);
+
+// map or unmap a 4KB page of the first 4MB at its own address, for the kernel
+void map_low_page(uint32_t addr, uint32_t present);
+
+// turn paging on for another processor, on its own copy of the page directory
+void paging_init_ap(uint32_t index);
+
 #endif
 
@@ -0,0 +1,722 @@
+#include "proc.h"
+#include "lib.h"
+#include "types.h"
+#include "systemcall.h"
+#include "trace.h"
+#include "profile.h"
+#include "scheduler.h"
+#include "i8253.h"
+#include "irqstat.h"
+#include "apic.h"
+#include "smp.h"
+
+#define PROC_NAME_WIDTH 12      // columns of the name of a system call in a report
+#define PROC_NUM_WIDTH 12       // columns of one number in a report, with the space before it
+#define PROC_CMD_LEN 8          // longest command written to a control file
+#define PROC_PID_WIDTH 3        // columns of a pid in a report, "pid" fits
+#define PROC_PROFILE_TOP 3      // hottest EIPs shown per program in the profile report
+#define PROC_TTY_WIDTH 4        // columns of a terminal number in a report, "tty" fits
+#define PROC_STATE_WIDTH 7      // columns of a process state in a report
+#define PROC_SITE_WIDTH 20      // columns of a file:line in a report
+#define PROC_IRQOFF_TOP 10      // longest sites shown in the irqstat report
+
+// commands of the control files, in proc_commands order
+#define PROC_CMD_ON 0
+#define PROC_CMD_OFF 1
+#define PROC_CMD_CLEAR 2
+#define PROC_CMD_DUMP 3
+#define PROC_CMD_NUM 4
+
+// names of the statistics files, by inode number
+static const int8_t* proc_names[PROC_FILE_NUM] = {"syscalls", "trace", "profile", "sched", "irqstat"};
+
+static const int8_t* proc_commands[PROC_CMD_NUM] = {"on", "off", "clear", "dump"};
+
+// names of the system calls, in jump_tbl order
+static const int8_t* syscall_names[SYSCALL_NUM] = {
+    "halt", "execute", "read", "write", "open", "close", "getargs", "vidmap", "set_handler", "sigreturn",
+    "spawn", "waitpid", "null", "readv", "writev", "mmap", "getdents",
+    "stat", "fstat", "create", "truncate", "fsync"
+};
+
+uint32_t syscall_calls[SYSCALL_NUM];
+static uint32_t syscall_returns[SYSCALL_NUM];                   // calls that came back, halt never does
+static uint64_t syscall_cycles[SYSCALL_NUM];                    // cycles spent in the calls that came back
+static uint64_t syscall_max[SYSCALL_NUM];                       // longest call
+static uint32_t syscall_hist[SYSCALL_NUM][SYSSTAT_BUCKETS];     // calls by log2 of their cycles
+static int8_t proc_buf[PROC_BUF_SIZE];                          // the report being read
+
+/* syscall_stat_exit
+* Description: This function is called by the system call entry code when a call returns. The
+*              latency runs from entry to return and includes the time other processes ran
+*              while the call was blocked, so execute counts the whole life of its child.
+* Input: index -- call number - 1
+*        start_lo, start_hi -- time stamp counter at entry
+* Output: None
+* Return value: None
+* Side effect: called with interrupts off, which keeps the figures consistent
+*/
+void syscall_stat_exit(uint32_t index, uint32_t start_lo, uint32_t start_hi){
+    uint64_t cycles = rdtsc() - (((uint64_t)start_hi << 32) | start_lo);
+    uint32_t bucket = SYSSTAT_BUCKETS - 1;
+    if(index >= SYSCALL_NUM){
+        return;
+    }
+    if((cycles >> 32) == 0 && (uint32_t)cycles != 0){
+        asm ("bsrl %1, %0" : "=r"(bucket) : "rm"((uint32_t)cycles));
+        if(bucket >= SYSSTAT_BUCKETS){
+            bucket = SYSSTAT_BUCKETS - 1;
+        }
+    }else if(cycles == 0){
+        bucket = 0;
+    }
+    syscall_returns[index]++;
+    syscall_cycles[index] += cycles;
+    if(cycles > syscall_max[index]){
+        syscall_max[index] = cycles;
+    }
+    syscall_hist[index][bucket]++;
+}
+
+/* div64
+* Description: This function divides a 64-bit number in place without the compiler's runtime
+*              library, which the kernel is not linked with.
+* Input: n -- the dividend, replaced by the quotient
+*        d -- the divisor, not 0
+* Output: None
+* Return value: the remainder
+* Side effect: None
+*/
+static uint32_t div64(uint64_t* n, uint32_t d){
+    uint32_t hi = (uint32_t)(*n >> 32);
+    uint32_t lo = (uint32_t)*n;
+    uint32_t q_hi = hi / d;
+    uint32_t rem;
+    hi %= d;    // below d, so the divl below cannot overflow
+    asm ("divl %4" : "=a"(lo), "=d"(rem) : "a"(lo), "d"(hi), "rm"(d));
+    *n = ((uint64_t)q_hi << 32) | lo;
+    return rem;
+}
+
+/* proc_put
+* Description: This function appends a string to the report, right aligned in width columns
+*              after a separating space.
+* Input: len -- length of the report so far
+*        s -- the string
+*        width -- columns to fill, 0 for none
+* Output: None
+* Return value: the new length of the report
+* Side effect: stops at the end of proc_buf
+*/
+static uint32_t proc_put(uint32_t len, const int8_t* s, uint32_t width){
+    uint32_t n = strlen(s);
+    if(width > 0 && len < PROC_BUF_SIZE){
+        proc_buf[len++] = ' ';
+        width--;
+    }
+    for(; width > n && len < PROC_BUF_SIZE; width--){
+        proc_buf[len++] = ' ';
+    }
+    for(; *s != '\0' && len < PROC_BUF_SIZE; s++){
+        proc_buf[len++] = *s;
+    }
+    return len;
+}
+
+/* proc_put_num
+* Description: This function appends a 64-bit number to the report in decimal.
+* Input: len -- length of the report so far
+*        value -- the number
+*        width -- columns to fill, 0 for none
+* Output: None
+* Return value: the new length of the report
+* Side effect: None
+*/
+static uint32_t proc_put_num(uint32_t len, uint64_t value, uint32_t width){
+    int8_t digits[24];
+    int32_t i = sizeof(digits) - 1;
+    digits[i] = '\0';
+    do{
+        digits[--i] = '0' + div64(&value, 10);
+    }while(value != 0);
+    return proc_put(len, &digits[i], width);
+}
+
+/* proc_syscalls_report
+* Description: This function writes one line per system call: the calls made, the mean and
+*              longest latency in cycles of those that returned, and every nonempty log2
+*              bucket as log2:count, where bucket b holds calls of 2^b to 2^(b+1) - 1 cycles.
+* Input: None
+* Output: None
+* Return value: length of the report
+* Side effect: fills proc_buf
+*/
+static uint32_t proc_syscalls_report(){
+    uint32_t len = 0, i, b;
+    uint64_t mean;
+    len = proc_put(len, "call", 0);
+    len = proc_put(len, "", PROC_NAME_WIDTH - 1 - 4);
+    len = proc_put(len, "calls", PROC_NUM_WIDTH);
+    len = proc_put(len, "mean", PROC_NUM_WIDTH);
+    len = proc_put(len, "max", PROC_NUM_WIDTH);
+    len = proc_put(len, " log2(cycles):count\n", 0);
+    for(i = 0; i < SYSCALL_NUM; i++){
+        len = proc_put(len, syscall_names[i], 0);
+        len = proc_put(len, "", PROC_NAME_WIDTH - 1 - strlen(syscall_names[i]));
+        len = proc_put_num(len, syscall_calls[i], PROC_NUM_WIDTH);
+        if(syscall_returns[i] == 0){
+            len = proc_put(len, "-", PROC_NUM_WIDTH);
+            len = proc_put(len, "-", PROC_NUM_WIDTH);
+        }else{
+            mean = syscall_cycles[i];
+            div64(&mean, syscall_returns[i]);
+            len = proc_put_num(len, mean, PROC_NUM_WIDTH);
+            len = proc_put_num(len, syscall_max[i], PROC_NUM_WIDTH);
+        }
+        for(b = 0; b < SYSSTAT_BUCKETS; b++){
+            if(syscall_hist[i][b] != 0){
+                len = proc_put(len, " ", 0);
+                len = proc_put_num(len, b, 0);
+                len = proc_put(len, ":", 0);
+                len = proc_put_num(len, syscall_hist[i][b], 0);
+            }
+        }
+        len = proc_put(len, "\n", 0);
+    }
+    return len;
+}
+
+/* proc_trace_report
+* Description: This function writes whether events are recorded and, for every cpu, the
+*              records made since the last clear and how many of them were overwritten.
+* Input: None
+* Output: None
+* Return value: length of the report
+* Side effect: fills proc_buf
+*/
+static uint32_t proc_trace_report(){
+    uint32_t len = 0;
+#ifdef TRACE_ENABLE
+    uint32_t cpu, head;
+    len = proc_put(len, trace_on ? "tracing on\n" : "tracing off\n", 0);
+    for(cpu = 0; cpu < TRACE_NUM_CPUS; cpu++){
+        head = trace_rings[cpu].head;
+        len = proc_put(len, "cpu ", 0);
+        len = proc_put_num(len, cpu, 0);
+        len = proc_put_num(len, head, PROC_NUM_WIDTH);
+        len = proc_put(len, " events", 0);
+        len = proc_put_num(len, head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0, PROC_NUM_WIDTH);
+        len = proc_put(len, " overwritten\n", 0);
+    }
+#else
+    len = proc_put(len, "tracing not compiled in\n", 0);
+#endif
+    return len;
+}
+
+/* proc_command
+* Description: This function reads a command written to a control file: "on", "off", "clear"
+*              or "dump", with an optional trailing newline.
+* Input: buf -- the command
+*        nbytes -- its length
+* Output: None
+* Return value: PROC_CMD_ON to PROC_CMD_DUMP, -1 for anything else
+* Side effect: None
+*/
+static int32_t proc_command(const void* buf, int32_t nbytes){
+    int8_t cmd[PROC_CMD_LEN];
+    int32_t i;
+    if(buf == NULL || nbytes <= 0 || nbytes >= PROC_CMD_LEN){
+        return -1;
+    }
+    memcpy(cmd, buf, nbytes);
+    if(cmd[nbytes - 1] == '\n'){
+        nbytes--;
+    }
+    cmd[nbytes] = '\0';
+    for(i = 0; i < PROC_CMD_NUM; i++){
+        if(strncmp(cmd, proc_commands[i], PROC_CMD_LEN) == 0){
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* proc_trace_control
+* Description: This function carries out a command written to the trace file: "on" and
+*              "off" start and stop recording, "clear" forgets the events and "dump" sends
+*              them on COM1.
+* Input: cmd -- the command, from proc_command
+* Output: None
+* Return value: 0 for success, -1 for an unknown command
+* Side effect: a dump takes seconds, the caller waits for it
+*/
+static int32_t proc_trace_control(int32_t cmd){
+#ifdef TRACE_ENABLE
+    switch(cmd){
+        case PROC_CMD_ON:
+            trace_on = 1;
+            return 0;
+        case PROC_CMD_OFF:
+            trace_on = 0;
+            return 0;
+        case PROC_CMD_CLEAR:
+            trace_clear();
+            return 0;
+        case PROC_CMD_DUMP:
+            trace_dump();
+            return 0;
+    }
+#endif
+    return -1;
+}
+
+/* proc_profile_report
+* Description: This function writes whether the profiler samples, then one line per
+*              session: its pid and program, the samples taken, the share of them in user
+*              mode, those dropped for want of a slot, and the PROC_PROFILE_TOP most
+*              frequent EIPs as eip:count.
+* Input: None
+* Output: None
+* Return value: length of the report
+* Side effect: fills proc_buf
+*/
+static uint32_t proc_profile_report(){
+    uint32_t len = 0, i, j, k, best, last_count, last_eip;
+    uint64_t share;
+    profile_session_t* s;
+    int8_t hex[12];
+    len = proc_put(len, profile_on ? "profiling on, " : "profiling off, ", 0);
+    len = proc_put_num(len, profile_session_num, 0);
+    len = proc_put(len, " programs, ", 0);
+    len = proc_put_num(len, profile_lost, 0);
+    len = proc_put(len, " samples lost\n", 0);
+    len = proc_put(len, "pid name", 0);
+    len = proc_put(len, "", MAX_FNAME_NUM - 1 - 4);
+    len = proc_put(len, "samples", PROC_NUM_WIDTH);
+    len = proc_put(len, "user%", PROC_NUM_WIDTH);
+    len = proc_put(len, "dropped", PROC_NUM_WIDTH);
+    len = proc_put(len, " top eip:count\n", 0);
+    for(i = 0; i < profile_session_num; i++){
+        s = &profile_sessions[i];
+        if(s->pid < 0){
+            len = proc_put(len, "-1", PROC_PID_WIDTH);
+        }else{
+            len = proc_put_num(len, s->pid, PROC_PID_WIDTH);
+        }
+        len = proc_put(len, " ", 0);
+        len = proc_put(len, s->name, 0);
+        len = proc_put(len, "", MAX_FNAME_NUM - 1 - strlen(s->name));
+        len = proc_put_num(len, s->samples, PROC_NUM_WIDTH);
+        share = (uint64_t)s->user * 100;
+        if(s->samples != 0){
+            div64(&share, s->samples);
+        }
+        len = proc_put_num(len, share, PROC_NUM_WIDTH);
+        len = proc_put_num(len, s->dropped, PROC_NUM_WIDTH);
+        // the top slots by count, ties broken by address so each is shown once
+        last_count = 0xFFFFFFFF;
+        last_eip = 0;
+        for(k = 0; k < PROC_PROFILE_TOP; k++){
+            best = PROFILE_SLOTS;
+            for(j = 0; j < PROFILE_SLOTS; j++){
+                if(s->slot[j].count == 0 || s->slot[j].count > last_count ||
+                   (s->slot[j].count == last_count && s->slot[j].eip <= last_eip)){
+                    continue;
+                }
+                if(best == PROFILE_SLOTS || s->slot[j].count > s->slot[best].count ||
+                   (s->slot[j].count == s->slot[best].count && s->slot[j].eip < s->slot[best].eip)){
+                    best = j;
+                }
+            }
+            if(best == PROFILE_SLOTS){
+                break;
+            }
+            len = proc_put(len, " ", 0);
+            len = proc_put(len, itoa(s->slot[best].eip, hex, 16), 0);
+            len = proc_put(len, ":", 0);
+            len = proc_put_num(len, s->slot[best].count, 0);
+            last_count = s->slot[best].count;
+            last_eip = s->slot[best].eip;
+        }
+        len = proc_put(len, "\n", 0);
+    }
+    return len;
+}
+
+/* proc_profile_control
+* Description: This function carries out a command written to the profile file: "on" and
+*              "off" start and stop sampling, "clear" forgets the samples and "dump" sends
+*              them on COM1.
+* Input: cmd -- the command, from proc_command
+* Output: None
+* Return value: 0 for success, -1 for an unknown command
+* Side effect: a dump takes seconds, the caller waits for it
+*/
+static int32_t proc_profile_control(int32_t cmd){
+    switch(cmd){
+        case PROC_CMD_ON:
+            profile_enable(1);
+            return 0;
+        case PROC_CMD_OFF:
+            profile_enable(0);
+            return 0;
+        case PROC_CMD_CLEAR:
+            profile_clear();
+            return 0;
+        case PROC_CMD_DUMP:
+            profile_dump();
+            return 0;
+    }
+    return -1;
+}
+
+/* proc_sched_report
+* Description: This function writes the time stamp counter, the running pid and the
+*              processors online, the PIT rate with the mean and longest cycles between
+*              its ticks, the switches made and the longest scheduling latency, then one
+*              line per process: its pid, program, terminal and state, the times it got
+*              the cpu, the cycles it ran and waited runnable for the cpu, and its
+*              longest such wait. The running process is charged up to now.
+* Input: None
+* Output: None
+* Return value: length of the report
+* Side effect: fills proc_buf
+*/
+static uint32_t proc_sched_report(){
+    static const int8_t* states[] = {"run", "wait", "zombie"};
+    uint32_t len = 0;
+    int32_t i;
+    uint64_t now = rdtsc();
+    uint64_t mean, run;
+    pcb_t* pcb;
+    len = proc_put(len, "now", 0);
+    len = proc_put_num(len, now, PROC_NUM_WIDTH);
+    len = proc_put(len, " cpu ", 0);
+    if(curr_pid < 0){
+        len = proc_put(len, "-1", 0);
+    }else{
+        len = proc_put_num(len, curr_pid, 0);
+    }
+    len = proc_put(len, ", ", 0);
+    len = proc_put_num(len, cpu_online_num, 0);
+    len = proc_put(len, " cpus online", 0);
+    len = proc_put(len, "\npit ", 0);
+    len = proc_put_num(len, pit_slice_ticks * PIT_HZ, 0);
+    len = proc_put(len, " Hz, ", 0);
+    len = proc_put_num(len, pit_slice_ticks, 0);
+    len = proc_put(len, " ticks per slice, ", 0);
+    len = proc_put_num(len, pit_tick_count, 0);
+    len = proc_put(len, " ticks, interval mean ", 0);
+    mean = pit_tick_cycles;
+    if(pit_tick_count != 0){
+        div64(&mean, pit_tick_count);
+    }
+    len = proc_put_num(len, mean, 0);
+    len = proc_put(len, " max ", 0);
+    len = proc_put_num(len, pit_tick_max, 0);
+    len = proc_put(len, "\nswitches ", 0);
+    len = proc_put_num(len, sched_switches, 0);
+    len = proc_put(len, ", longest latency ", 0);
+    len = proc_put_num(len, sched_latency_max, 0);
+    len = proc_put(len, "\npid name", 0);
+    len = proc_put(len, "", MAX_FNAME_NUM - 1 - 4);
+    len = proc_put(len, "tty", PROC_TTY_WIDTH);
+    len = proc_put(len, "state", PROC_STATE_WIDTH);
+    len = proc_put(len, "switches", PROC_NUM_WIDTH);
+    len = proc_put(len, "run", PROC_NUM_WIDTH);
+    len = proc_put(len, "wait", PROC_NUM_WIDTH);
+    len = proc_put(len, "maxlat", PROC_NUM_WIDTH);
+    len = proc_put(len, "\n", 0);
+    for(i = 0; i < max_pid_num; i++){
+        if(!pid_in_use(i)){
+            continue;
+        }
+        pcb = get_pcb(i);
+        run = pcb->run_cycles;
+        if(i == curr_pid && pcb->run_since != 0){
+            run += now - pcb->run_since;
+        }
+        len = proc_put_num(len, i, PROC_PID_WIDTH);
+        len = proc_put(len, " ", 0);
+        len = proc_put(len, pcb->name, 0);
+        len = proc_put(len, "", MAX_FNAME_NUM - 1 - strlen(pcb->name));
+        len = proc_put_num(len, pcb->tid, PROC_TTY_WIDTH);
+        len = proc_put(len, pcb->state <= PROCESS_ZOMBIE ? states[pcb->state] : "?", PROC_STATE_WIDTH);
+        len = proc_put_num(len, pcb->switches, PROC_NUM_WIDTH);
+        len = proc_put_num(len, run, PROC_NUM_WIDTH);
+        len = proc_put_num(len, pcb->wait_cycles, PROC_NUM_WIDTH);
+        len = proc_put_num(len, pcb->max_latency, PROC_NUM_WIDTH);
+        len = proc_put(len, "\n", 0);
+    }
+    return len;
+}
+
+#ifdef IRQSTAT_ENABLE
+/* proc_put_site
+* Description: This function appends where interrupts were turned off or on, after a
+*              separating space and left aligned in width columns.
+* Input: len -- length of the report so far
+*        name, num -- the file and line, or "irq" and its number
+*        width -- columns to fill, 0 for none
+* Output: None
+* Return value: the new length of the report
+* Side effect: None
+*/
+static uint32_t proc_put_site(uint32_t len, const int8_t* name, uint32_t num, uint32_t width){
+    uint32_t start = len;
+    len = proc_put(len, " ", 0);
+    len = proc_put(len, name, 0);
+    len = proc_put(len, ":", 0);
+    len = proc_put_num(len, num, 0);
+    if(len - start < width){
+        len = proc_put(len, "", width - (len - start));
+    }
+    return len;
+}
+#endif
+
+/* proc_irqstat_report
+* Description: This function writes the longest window with interrupts off and where it
+*              started and ended, then the PROC_IRQOFF_TOP places whose windows were the
+*              longest, with their count and mean and longest window, then one line per
+*              interrupt line taken: the interrupts, the mean and longest cycles in the
+*              handler, the mean and longest latency, and a bound on the latency. Only
+*              the PIT's latency can be read, from its counter, and is shown in cycles
+*              at the measured tick rate. The bound is the longest window plus the
+*              longest handler of every line the interrupt controller puts before this
+*              one. Cycles throughout.
+* Input: None
+* Output: None
+* Return value: length of the report
+* Side effect: fills proc_buf
+*/
+static uint32_t proc_irqstat_report(){
+#ifdef IRQSTAT_ENABLE
+    // PIC priority, the slave's lines in place of IRQ2; the APIC serves higher vectors first
+    static const uint8_t pic_order[] = {0, 1, 8, 9, 10, 11, 12, 13, 14, 15, 3, 4, 5, 6, 7};
+    static const uint8_t apic_order[] = {15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 1, 0};
+    const uint8_t* order = apic_on ? apic_order : pic_order;
+    static const int8_t* names[IRQSTAT_IRQS] = {"pit", "keyboard", "", "", "com1", "", "", "",
+                                                "rtc", "", "", "", "", "", "ata", ""};
+    uint8_t shown[IRQSTAT_SITES];
+    uint32_t len = 0, i, j, best;
+    uint64_t mean, bound, per_tick;
+    irqoff_site_t* site;
+    irq_stat_t* s;
+    len = proc_put(len, "longest off ", 0);
+    len = proc_put_num(len, irqoff_max, 0);
+    if(irqoff_max_from != NULL){
+        len = proc_put(len, " from", 0);
+        len = proc_put_site(len, irqoff_max_from->name, irqoff_max_from->num, 0);
+        len = proc_put(len, " to", 0);
+        len = proc_put_site(len, irqoff_max_to, irqoff_max_to_line, 0);
+    }
+    len = proc_put(len, "\nwindows ", 0);
+    len = proc_put_num(len, irqoff_windows, 0);
+    len = proc_put(len, ", dropped ", 0);
+    len = proc_put_num(len, irqoff_dropped, 0);
+    len = proc_put(len, "\nsite", 0);
+    len = proc_put(len, "", PROC_SITE_WIDTH - 4);
+    len = proc_put(len, "count", PROC_NUM_WIDTH);
+    len = proc_put(len, "mean", PROC_NUM_WIDTH);
+    len = proc_put(len, "max", PROC_NUM_WIDTH);
+    len = proc_put(len, "\n", 0);
+    memset(shown, 0, sizeof(shown));
+    for(i = 0; i < PROC_IRQOFF_TOP; i++){
+        best = IRQSTAT_SITES;
+        for(j = 0; j < IRQSTAT_SITES; j++){
+            if(!shown[j] && irqoff_sites[j].count != 0 &&
+               (best == IRQSTAT_SITES || irqoff_sites[j].max > irqoff_sites[best].max)){
+                best = j;
+            }
+        }
+        if(best == IRQSTAT_SITES){
+            break;
+        }
+        shown[best] = 1;
+        site = &irqoff_sites[best];
+        len = proc_put_site(len, site->name, site->num, PROC_SITE_WIDTH);
+        len = proc_put_num(len, site->count, PROC_NUM_WIDTH);
+        mean = site->cycles;
+        div64(&mean, site->count);
+        len = proc_put_num(len, mean, PROC_NUM_WIDTH);
+        len = proc_put_num(len, site->max, PROC_NUM_WIDTH);
+        len = proc_put(len, "\n", 0);
+    }
+    len = proc_put(len, "\nirq name    ", 0);
+    len = proc_put(len, "count", PROC_NUM_WIDTH);
+    len = proc_put(len, "mean", PROC_NUM_WIDTH);
+    len = proc_put(len, "max", PROC_NUM_WIDTH);
+    len = proc_put(len, "latency", PROC_NUM_WIDTH);
+    len = proc_put(len, "maxlat", PROC_NUM_WIDTH);
+    len = proc_put(len, "bound", PROC_NUM_WIDTH);
+    len = proc_put(len, "\n", 0);
+    per_tick = pit_tick_cycles;
+    if(pit_tick_count != 0){
+        div64(&per_tick, pit_tick_count);
+    }
+    bound = irqoff_max;
+    for(i = 0; i < sizeof(pic_order); i++){
+        s = &irq_stats[order[i]];
+        if(s->count != 0){
+            len = proc_put_num(len, order[i], PROC_PID_WIDTH);
+            len = proc_put(len, " ", 0);
+            len = proc_put(len, names[order[i]], 0);
+            len = proc_put(len, "", 8 - strlen(names[order[i]]));
+            len = proc_put_num(len, s->count, PROC_NUM_WIDTH);
+            mean = s->cycles;
+            div64(&mean, s->count);
+            len = proc_put_num(len, mean, PROC_NUM_WIDTH);
+            len = proc_put_num(len, s->max, PROC_NUM_WIDTH);
+            if(s->latency_count != 0 && pit_tick_count != 0){
+                // PIT clocks to cycles, at the cycles per tick measured
+                mean = s->latency * per_tick;
+                div64(&mean, s->latency_count);
+                div64(&mean, pit_divisor);
+                len = proc_put_num(len, mean, PROC_NUM_WIDTH);
+                mean = s->latency_max * per_tick;
+                div64(&mean, pit_divisor);
+                len = proc_put_num(len, mean, PROC_NUM_WIDTH);
+            }else{
+                len = proc_put(len, "-", PROC_NUM_WIDTH);
+                len = proc_put(len, "-", PROC_NUM_WIDTH);
+            }
+            len = proc_put_num(len, bound, PROC_NUM_WIDTH);
+            len = proc_put(len, "\n", 0);
+        }
+        // a line after this one may wait for this one's handler too
+        bound += s->max;
+    }
+    return len;
+#else
+    return proc_put(0, "not compiled in, see IRQSTAT_ENABLE in irqstat.h\n", 0);
+#endif
+}
+
+/* proc_lookup
+* Description: This function finds a statistics file by name, for images whose directory
+*              has no entry for it.
+* Input: fname -- the name
+*        dentry -- the entry to fill
+* Output: None
+* Return value: 0 if fname names a statistics file, -1 otherwise
+* Side effect: None
+*/
+int32_t proc_lookup(const uint8_t* fname, dentry_t* dentry){
+    uint32_t i;
+    for(i = 0; i < PROC_FILE_NUM; i++){
+        if(strncmp((int8_t*)fname, proc_names[i], filename_len) == 0){
+            memset(dentry, 0, sizeof(dentry_t));
+            strncpy((int8_t*)dentry->filename, proc_names[i], filename_len);
+            dentry->filetype = PROC_FILETYPE;
+            dentry->inode_num = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* proc_open
+* Description: This function opens a statistics file. There is nothing to set up, the report
+*              is made at every read.
+* Input: filename -- the name
+* Output: None
+* Return value: 0
+* Side effect: None
+*/
+int32_t proc_open(const uint8_t* filename){
+    return 0;
+}
+
+/* proc_close
+* Description: This function closes a statistics file.
+* Input: fd -- a file descriptor
+* Output: None
+* Return value: 0
+* Side effect: None
+*/
+int32_t proc_close(int32_t fd){
+    return 0;
+}
+
+/* proc_read
+* Description: This function reads the report of the file from the fd's position. The report
+*              is made again at every read, so reading it in pieces can tear between lines.
+* Input: fd -- a file descriptor
+*        buf -- the user buffer
+*        nbytes -- the number of bytes to read
+* Output: None
+* Return value: the number of bytes read, 0 at the end of the report, -1 for failure
+* Side effect: advances the fd's position
+*/
+int32_t proc_read(int32_t fd, void* buf, int32_t nbytes){
+    fd_t* file = &get_curr_pcb()->fd_arr[fd];
+    uint32_t len = 0, flags;
+    int32_t count;
+    if(buf == NULL || nbytes < 0){
+        return -1;
+    }
+    cli_and_save(flags);        // proc_buf is shared and the figures change at every system call
+    if(file->inode == PROC_SYSCALLS){
+        len = proc_syscalls_report();
+    }else if(file->inode == PROC_TRACE){
+        len = proc_trace_report();
+    }else if(file->inode == PROC_PROFILE){
+        len = proc_profile_report();
+    }else if(file->inode == PROC_SCHED){
+        len = proc_sched_report();
+    }else if(file->inode == PROC_IRQSTAT){
+        len = proc_irqstat_report();
+    }
+    count = 0;
+    if((uint32_t)file->file_pos < len){
+        count = len - file->file_pos;
+        if(count > nbytes){
+            count = nbytes;
+        }
+        memcpy(buf, proc_buf + file->file_pos, count);
+        file->file_pos += count;
+    }
+    restore_flags(flags);
+    return count;
+}
+
+/* proc_write
+* Description: This function clears the figures of the syscalls, sched and irqstat files,
+*              whatever is written, so a benchmark can start from zero. The trace and
+*              profile files take a command instead.
+* Input: fd -- a file descriptor
+*        buf -- ignored, or the command
+*        nbytes -- the number of bytes written
+* Output: None
+* Return value: nbytes, -1 for an unknown command
+* Side effect: clears the figures
+*/
+int32_t proc_write(int32_t fd, const void* buf, int32_t nbytes){
+    fd_t* file = &get_curr_pcb()->fd_arr[fd];
+    uint32_t flags;
+    if(file->inode == PROC_TRACE){
+        return proc_trace_control(proc_command(buf, nbytes)) == 0 ? nbytes : -1;
+    }
+    if(file->inode == PROC_PROFILE){
+        return proc_profile_control(proc_command(buf, nbytes)) == 0 ? nbytes : -1;
+    }
+    cli_and_save(flags);
+    if(file->inode == PROC_SYSCALLS){
+        memset(syscall_calls, 0, sizeof(syscall_calls));
+        memset(syscall_returns, 0, sizeof(syscall_returns));
+        memset(syscall_cycles, 0, sizeof(syscall_cycles));
+        memset(syscall_max, 0, sizeof(syscall_max));
+        memset(syscall_hist, 0, sizeof(syscall_hist));
+    }else if(file->inode == PROC_SCHED){
+        sched_stat_clear();
+        pit_stat_clear();
+    }else if(file->inode == PROC_IRQSTAT){
+#ifdef IRQSTAT_ENABLE
+        irqstat_clear();
+#endif
+    }
+    restore_flags(flags);
+    return nbytes;
+}
@@ -0,0 +1,45 @@
+#ifndef _PROC_H
+#define _PROC_H
+
+#include "types.h"
+#include "FileSystem.h"
+
+/*
+Kernel statistics files. They have directory entries of file type PROC_FILETYPE,
+whose inode number selects the report, and are also found by name in images
+built before they existed.
+*/
+#define PROC_FILETYPE       3
+#define PROC_SYSCALLS       0       // per system call counts and latencies
+#define PROC_TRACE          1       // state of the event trace, written to control it
+#define PROC_PROFILE        2       // sampling profiler, written to control it
+#define PROC_SCHED          3       // cpu time and scheduling latency per process
+#define PROC_IRQSTAT        4       // how long interrupts stay off and wait
+#define PROC_FILE_NUM       5
+#define PROC_BUF_SIZE       16384   // largest report
+
+#define SYSCALL_NUM         22      // entries of jump_tbl in IDT_wrappers.S
+#define SYSSTAT_BUCKETS     32      // log2 latency buckets, the last one takes everything longer
+
+// calls made through either entry path, by call number - 1, counted by the entry code
+extern uint32_t syscall_calls[SYSCALL_NUM];
+
+// record the latency of a system call that returned
+void syscall_stat_exit(uint32_t index, uint32_t start_lo, uint32_t start_hi);
+
+// fill a directory entry for a statistics file named fname
+int32_t proc_lookup(const uint8_t* fname, dentry_t* dentry);
+
+// open a statistics file
+int32_t proc_open(const uint8_t* filename);
+
+// close a statistics file
+int32_t proc_close(int32_t fd);
+
+// read the report from the fd's position
+int32_t proc_read(int32_t fd, void* buf, int32_t nbytes);
+
+// clear the figures of the report
+int32_t proc_write(int32_t fd, const void* buf, int32_t nbytes);
+
+#endif /* _PROC_H */
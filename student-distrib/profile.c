@@ -0,0 +1,166 @@
+#include "profile.h"
+#include "lib.h"
+#include "i8253.h"
+#include "serial.h"
+
+uint32_t profile_on = 0;
+profile_session_t profile_sessions[PROFILE_SESSIONS];
+uint32_t profile_session_num = 0;
+uint32_t profile_lost = 0;
+
+static uint8_t pid_session[MAX_PID_NUM];           // 1 + session of each pid, 0 until it is sampled
+static int32_t kernel_session = PROFILE_NONE;      // session of the samples taken before the first shell
+
+/* 
+ *profile_sample
+ * DESCRIPTION: count a sample in the histogram of the running program, starting a
+ *              session for it at its first sample. The EIP is hashed into the slots
+ *              with a short linear probe.
+ * INPUTS: eip, cs -- from the interrupt frame of the PIT
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: called with interrupts off
+ */
+void profile_sample(uint32_t eip, uint32_t cs){
+    profile_session_t* s;
+    profile_slot_t* slot;
+    uint32_t i, h;
+    int32_t n = curr_pid < 0 ? kernel_session : pid_session[(uint8_t)curr_pid] - 1;
+    if(n < 0){
+        if(profile_session_num == PROFILE_SESSIONS){
+            profile_lost++;
+            return;
+        }
+        n = profile_session_num++;
+        s = &profile_sessions[n];           // cleared by profile_clear, or never used
+        s->pid = curr_pid;
+        if(curr_pid < 0){
+            strncpy(s->name, "kernel", MAX_FNAME_NUM - 1);
+            kernel_session = n;
+        }else{
+            strncpy(s->name, get_pcb(curr_pid)->name, MAX_FNAME_NUM - 1);
+            pid_session[(uint8_t)curr_pid] = n + 1;
+        }
+    }
+    s = &profile_sessions[n];
+    s->samples++;
+    if((cs & 0x3) == 0x3){                  // privilege level 3
+        s->user++;
+    }
+    h = (eip * 2654435761U) >> 16;          // Knuth's multiplicative hash, upper bits mix best
+    for(i = 0; i < PROFILE_PROBES; i++){
+        slot = &s->slot[(h + i) & (PROFILE_SLOTS - 1)];
+        if(slot->count == 0){
+            slot->eip = eip;
+            slot->count = 1;
+            return;
+        }
+        if(slot->eip == eip){
+            slot->count++;
+            return;
+        }
+    }
+    s->dropped++;
+}
+
+/* 
+ *profile_exec
+ * DESCRIPTION: give the program just loaded into pid a session of its own at its
+ *              first sample, apart from the program that had the pid before
+ * INPUTS: pid -- the new process
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void profile_exec(int8_t pid){
+    pid_session[(uint8_t)pid] = 0;
+}
+
+/* 
+ *profile_enable
+ * DESCRIPTION: start or stop sampling. The PIT runs at PROFILE_HZ while sampling so
+ *              short functions get hit, the scheduler still switches at its own rate.
+ * INPUTS: on -- 1 to start, 0 to stop
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: reprograms the PIT
+ */
+void profile_enable(uint32_t on){
+    uint32_t flags;
+    cli_and_save(flags);
+    profile_on = on;
+    pit_set_hz(on ? PROFILE_HZ : PIT_HZ);
+    restore_flags(flags);
+}
+
+/* 
+ *profile_clear
+ * DESCRIPTION: forget every sample and session
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void profile_clear(){
+    uint32_t flags;
+    cli_and_save(flags);
+    memset(profile_sessions, 0, sizeof(profile_sessions));
+    memset(pid_session, 0, sizeof(pid_session));
+    profile_session_num = 0;
+    profile_lost = 0;
+    kernel_session = PROFILE_NONE;
+    restore_flags(flags);
+}
+
+/* 
+ *profile_dump
+ * DESCRIPTION: send every session on COM1 as text lines between "PROFILE BEGIN" and
+ *              "PROFILE END". A session starts with
+ *                  PROFILE SESSION <pid> <name> <samples> <user samples> <dropped>
+ *              and has a line "S <eip in hex> <count>" per slot in use. profsym.py
+ *              looks the EIPs up in the kernel and program ELF files.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: no samples are taken while the dump is sent
+ */
+void profile_dump(){
+    uint32_t i, j, saved_on = profile_on;
+    profile_session_t* s;
+    int8_t num[12];
+    profile_on = 0;
+    serial_puts("PROFILE BEGIN ");
+    serial_puts(itoa(saved_on ? PROFILE_HZ : PIT_HZ, num, 10));
+    serial_puts(" ");
+    serial_puts(itoa(profile_lost, num, 10));
+    serial_puts("\n");
+    for(i = 0; i < profile_session_num; i++){
+        s = &profile_sessions[i];
+        serial_puts("PROFILE SESSION ");
+        if(s->pid < 0){
+            serial_puts("-");
+        }
+        serial_puts(itoa(s->pid < 0 ? -s->pid : s->pid, num, 10));
+        serial_puts(" ");
+        serial_puts(s->name);
+        serial_puts(" ");
+        serial_puts(itoa(s->samples, num, 10));
+        serial_puts(" ");
+        serial_puts(itoa(s->user, num, 10));
+        serial_puts(" ");
+        serial_puts(itoa(s->dropped, num, 10));
+        serial_puts("\n");
+        for(j = 0; j < PROFILE_SLOTS; j++){
+            if(s->slot[j].count == 0){
+                continue;
+            }
+            serial_puts("S ");
+            serial_puts(itoa(s->slot[j].eip, num, 16));
+            serial_puts(" ");
+            serial_puts(itoa(s->slot[j].count, num, 10));
+            serial_puts("\n");
+        }
+    }
+    serial_puts("PROFILE END\n");
+    profile_on = saved_on;
+}
@@ -0,0 +1,61 @@
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include "types.h"
+#include "systemcall.h"
+
+/*
+Sampling profiler. While it is on, the PIT runs at PROFILE_HZ and every tick
+counts the interrupted EIP in a histogram of the running program. A program
+gets a new histogram each time it is loaded, and keeps it after it halts,
+until the samples are cleared.
+*/
+#define PROFILE_HZ          1000    // PIT rate while profiling, a multiple of the normal one
+#define PROFILE_SESSIONS    16      // programs profiled at once, the kernel before the first shell is one
+#define PROFILE_SLOTS       1024    // distinct EIPs per program, a power of 2
+#define PROFILE_PROBES      16      // slots tried before a sample is dropped
+#define PROFILE_NONE        -1      // no session
+
+// one histogram bucket
+typedef struct profile_slot{
+    uint32_t eip;
+    uint32_t count;         // 0 if the slot is free
+}profile_slot_t;
+
+// the samples of one loaded program
+typedef struct profile_session{
+    int8_t pid;             // -1 for the kernel before the first shell
+    int8_t name[MAX_FNAME_NUM];
+    uint32_t samples;       // taken in the session, dropped ones included
+    uint32_t user;          // taken in user mode
+    uint32_t dropped;       // with no free slot in reach
+    profile_slot_t slot[PROFILE_SLOTS];
+}profile_session_t;
+
+// 1 while the PIT takes samples
+extern uint32_t profile_on;
+
+extern profile_session_t profile_sessions[PROFILE_SESSIONS];
+
+// number of sessions in use
+extern uint32_t profile_session_num;
+
+// samples lost because every session was in use
+extern uint32_t profile_lost;
+
+// count a sample of the running process, from the PIT interrupt
+void profile_sample(uint32_t eip, uint32_t cs);
+
+// start a new session for the program just loaded into pid
+void profile_exec(int8_t pid);
+
+// start or stop sampling
+void profile_enable(uint32_t on);
+
+// forget every sample
+void profile_clear();
+
+// send every session on COM1
+void profile_dump();
+
+#endif /* _PROFILE_H */
@@ -4,6 +4,8 @@
 #include "lib.h"
 #include "types.h"
 #include "scheduler.h"
+#include "trace.h"
+#include "smp.h"
 
 // set interrupt flags for each of three terminals
 volatile int interrupt_flags[NUM_TERMINAL] = {1, 1, 1};
@@ -32,6 +34,7 @@ void rtc_init(void){
 */
 void rtc_int_handler(){
     cli();
+    TRACE(TRACE_IRQ, RTC_PIC_NUM);
     outb(REGISTER_C,RTC_PORT);             //mask the other interrupt
     inb(CMOS_PORT);                         //Throw away contents
     send_eoi(RTC_PIC_NUM);
@@ -82,12 +85,16 @@ int32_t rtc_close(int32_t fd) {
 * Side effect: clear the interrupt flag after interrupt happens
 */
 int32_t rtc_read(int32_t fd, void * buf, int32_t nbytes) {
+    uint8_t tid = curr_terminal_running;
     // set interrupt flag for current running terminal in order for happened interrupt
-    interrupt_flags[curr_terminal_running] = 1;
-    while (interrupt_flags[curr_terminal_running] == 1) {
+    interrupt_flags[tid] = 1;
+    // the RTC interrupts the booting processor, which needs the kernel lock to serve it
+    smp_unlock();
+    while (interrupt_flags[tid] == 1) {
         ; // wait until the interrupt handler clears the interrupt flag
     }
-    interrupt_flags[curr_terminal_running] = 1; // set the flag current running terminal again for checking next interrupt 
+    smp_lock();
+    interrupt_flags[tid] = 1; // set the flag current running terminal again for checking next interrupt 
     return 0; // should return 0 always
 }
 
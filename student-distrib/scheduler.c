@@ -1,24 +1,36 @@
 #include "scheduler.h"
+#include "trace.h"
+#include "smp.h"
+
+uint32_t sched_switches = 0;
+uint64_t sched_latency_max = 0;
 
 /* void scheduler()
 * Input: None
 * Output: None
 * Return value: None
-* Side effect: enable scheduler
+* Side effect: switch to the next runnable process, called with interrupts off
+*              from the PIT handler, or from halt and waitpid to give the cpu away
 */
 void scheduler(){
+// no process to switch away from before the first shell, or the running one holds the cpu
+    if (curr_pid < 0 || sched_hold_count > 0){
+        return;
+    }
 // get the pid for next process (after switch)    
     int32_t next_pid = get_next_process();  
-// only one terminal working, just return
-    if (next_terminal_running == curr_terminal_running){
-  	send_eoi(0);
+// only one process runnable, just return
+    if (next_pid < 0 || next_pid == curr_pid){
   	return;
- }
+    }
+    TRACE(TRACE_SWITCH, next_pid);
+    sched_account(curr_pid, next_pid);
 // remap program (virtual 128MB to Physical)
     map_program(next_pid);
-// get current PCB (before switch)
-    pcb_t* pcb_before_switch = get_pcb(terminal[curr_terminal_running].curr_pid);
+// get current PCB (before switch), NULL if an orphan freed its own pid in halt
+    pcb_t* pcb_before_switch = get_pcb(curr_pid);
 //save esp and ebp
+    if (pcb_before_switch != NULL){
        asm volatile(
             "movl %%esp, %0       \n"
             "movl %%ebp, %1       \n"
@@ -26,16 +38,31 @@ void scheduler(){
             :
             : "memory"
         );   
+    }
 // get PCB for next process (after switch)
     pcb_t* pcb_after_switch = get_pcb(next_pid);
-// get next running terminal
-    curr_terminal_running = next_terminal_running;  
+// get next running process and its terminal
+    curr_pid = next_pid;
+    curr_terminal_running = pcb_after_switch->tid;  
 // remap video memory
     vidmap_paging();
-// prepare for context switch
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = 0x800000 - 0x2000 * (next_pid) - 4 ;   // -4 to avoid edge case
-	send_eoi(0);
+// prepare for context switch, on this processor's TSS
+    tss_t* cpu_tss = smp_tss();
+    cpu_tss->ss0 = KERNEL_DS;
+    cpu_tss->esp0 = get_kstack_top(next_pid);
+// a spawned child has no kernel context yet, enter user space on its own kernel stack
+    if (pcb_after_switch->first_run){
+        pcb_after_switch->first_run = 0;
+        asm volatile(
+            "movl %0, %%esp       \n"
+            "pushl %1             \n"
+            "pushl $0             \n"   // fake return address, context_switch reads the entry at 4(%esp)
+            "jmp context_switch   \n"
+            :
+            : "r" (cpu_tss->esp0), "r" (pcb_after_switch->entry)
+            : "memory"
+        );
+    }
 // restore return esp and return ebp 
     asm volatile(
         "movl %0, %%esp       \n"
@@ -50,17 +77,119 @@ void scheduler(){
 /* void get_next_process()
 * Input: None
 * Output: None
-* Return value: pid for next process
-* Side effect: Set correct next_terminal_running
+* Return value: pid for next process of this processor, -1 if nothing is runnable
+* Side effect: None
 */
 int32_t get_next_process(){
     int i;
-    next_terminal_running = curr_terminal_running;
-    for(i = 0; i < MAX_TERMINAL; i++){   
-        next_terminal_running = (next_terminal_running + 1) % MAX_TERMINAL; 
-        if(terminal[next_terminal_running].active == 1){
-            break;
+    int32_t next_pid = curr_pid;
+    uint32_t cpu = smp_cpu_index();
+    // round robin over every pid, several of them may share a terminal; only the
+    // terminals this processor serves count, a process stays where it started
+    for(i = 0; i < max_pid_num; i++){   
+        next_pid = (next_pid + 1) % max_pid_num; 
+        if(pid_in_use(next_pid) && get_pcb(next_pid)->state == PROCESS_RUNNING
+                && smp_terminal_cpu(get_pcb(next_pid)->tid) == cpu){
+            return next_pid;
+        }
+    }
+    return -1;
+}
+
+/* void sched_hold()
+* Input: None
+* Output: None
+* Return value: None
+* Side effect: the PIT stops switching processes until the matching sched_release, so
+*              a process can wait for a device interrupt with interrupts on while the
+*              state it shares with other processes stays put. Holds nest.
+*/
+void sched_hold(){
+    sched_hold_count++;
+}
+
+/* void sched_release()
+* Input: None
+* Output: None
+* Return value: None
+* Side effect: ends one sched_hold
+*/
+void sched_release(){
+    if (sched_hold_count > 0){
+        sched_hold_count--;
+    }
+}
+
+/* void sched_account()
+* Input: prev_pid -- the process giving the cpu away, -1 for none
+*        next_pid -- the process getting it, -1 for none
+* Output: None
+* Return value: None
+* Side effect: the running time of prev_pid grows by its time on the cpu, and if it
+*              is still runnable it starts waiting. The wait of next_pid, if it was
+*              runnable rather than blocked, is added to its wait time and latency.
+*              Called with interrupts off wherever curr_pid changes hands.
+*/
+void sched_account(int32_t prev_pid, int32_t next_pid){
+    uint64_t now = rdtsc();
+    uint64_t waited;
+    pcb_t* prev = (prev_pid >= 0) ? get_pcb(prev_pid) : NULL;
+    pcb_t* next = (next_pid >= 0) ? get_pcb(next_pid) : NULL;
+    if (prev != NULL && prev->run_since != 0){
+        prev->run_cycles += now - prev->run_since;
+        // blocked and halted processes are not waiting for the cpu
+        prev->ready_since = (prev->state == PROCESS_RUNNING) ? now : 0;
+    }
+    if (next == NULL){
+        return;
+    }
+    if (next->ready_since != 0){
+        waited = now - next->ready_since;
+        next->wait_cycles += waited;
+        if (waited > next->max_latency){
+            next->max_latency = waited;
+        }
+        if (waited > sched_latency_max){
+            sched_latency_max = waited;
+        }
+        next->ready_since = 0;
+    }
+    next->run_since = now;
+    next->switches++;
+    sched_switches++;
+}
+
+/* void sched_stat_clear()
+* Input: None
+* Output: None
+* Return value: None
+* Side effect: the figures of every process start again from zero. A runnable process
+*              waiting for the cpu keeps waiting from now on.
+*/
+void sched_stat_clear(){
+    int32_t i;
+    uint32_t flags;
+    uint64_t now;
+    pcb_t* pcb;
+    cli_and_save(flags);
+    now = rdtsc();
+    for (i = 0; i < max_pid_num; i++){
+        if (!pid_in_use(i)){
+            continue;
+        }
+        pcb = get_pcb(i);
+        pcb->switches = 0;
+        pcb->run_cycles = 0;
+        pcb->wait_cycles = 0;
+        pcb->max_latency = 0;
+        if (pcb->run_since != 0){
+            pcb->run_since = now;
+        }
+        if (pcb->ready_since != 0){
+            pcb->ready_since = now;
         }
     }
-    return terminal[next_terminal_running].curr_pid;
+    sched_switches = 0;
+    sched_latency_max = 0;
+    restore_flags(flags);
 }
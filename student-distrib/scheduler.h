@@ -11,12 +11,31 @@
 
 #define MAX_TERMINAL 3
 
-uint32_t next_terminal_running;
+// nonzero while the running process must keep the cpu, such as while it waits on the disk
+volatile uint32_t sched_hold_count;
+
+// switches between processes since boot or the last sched_stat_clear
+extern uint32_t sched_switches;
+
+// longest time any process was runnable before it got the cpu, in cycles
+extern uint64_t sched_latency_max;
 
 // implement Scheduler
 void scheduler();
 
+// charge the cpu time of a switch from prev_pid to next_pid, either may be -1
+void sched_account(int32_t prev_pid, int32_t next_pid);
+
+// forget the scheduling figures of every process
+void sched_stat_clear();
+
 // get the pid for next running process
 int32_t get_next_process();
 
+// keep the running process on the cpu until sched_release
+void sched_hold();
+
+// end a sched_hold
+void sched_release();
+
 #endif /* _SCHEDULER_H */
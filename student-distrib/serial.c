@@ -0,0 +1,321 @@
+#include "serial.h"
+#include "lib.h"
+#include "i8259.h"
+#include "trace.h"
+#include "smp.h"
+
+uint32_t serial_mirror = 0;
+uint32_t serial_rx_dropped = 0;
+
+static uint8_t serial_present = 0;     // 1 once a UART answered at COM1
+static uint8_t serial_irq_on = 0;      // 1 once the rings are drained by the interrupt
+static uint8_t serial_tx_busy = 0;     // 1 while the transmit interrupt is armed
+static uint8_t tx_ring[SERIAL_TX_SIZE];
+static uint8_t rx_ring[SERIAL_RX_SIZE];
+static volatile uint32_t tx_head = 0, tx_tail = 0;     // bytes ever queued and ever sent
+static volatile uint32_t rx_head = 0, rx_tail = 0;     // bytes ever received and ever read
+
+/*
+ *serial_init
+ * DESCRIPTION: set up COM1 at SERIAL_BAUD, 8N1 with FIFOs and no interrupts, so early
+ *              boot messages can be sent by polling. The scratch register is written
+ *              and read back first, a port nobody answers reads 0xFF and serial
+ *              output is then dropped.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: programs the UART
+ */
+void serial_init(){
+    outb(0x5A, COM1_BASE + SERIAL_SCRATCH);
+    if(inb(COM1_BASE + SERIAL_SCRATCH) != 0x5A){
+        return;
+    }
+    outb(0x00, COM1_BASE + SERIAL_IER);                 // polled, no interrupts
+    outb(SERIAL_LCR_DLAB, COM1_BASE + SERIAL_LCR);
+    outb((SERIAL_CLOCK / SERIAL_BAUD) & 0xFF, COM1_BASE + SERIAL_DATA);
+    outb((SERIAL_CLOCK / SERIAL_BAUD) >> 8, COM1_BASE + SERIAL_IER);
+    outb(SERIAL_LCR_8N1, COM1_BASE + SERIAL_LCR);
+    outb(SERIAL_FCR_ENABLE, COM1_BASE + SERIAL_FCR);
+    outb(SERIAL_MCR_DTR_RTS, COM1_BASE + SERIAL_MCR);
+    serial_present = 1;
+}
+
+/*
+ *serial_irq_init
+ * DESCRIPTION: turn on the receive and line status interrupts and unmask IRQ4. From
+ *              here on output is queued in tx_ring and sent by the transmit interrupt,
+ *              and input is kept in rx_ring for serial_read.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: needs the IDT entry of IRQ4
+ */
+void serial_irq_init(){
+    uint32_t flags;
+    if(!serial_present){
+        return;
+    }
+    cli_and_save(flags);
+    outb(SERIAL_MCR_DTR_RTS | SERIAL_MCR_OUT2, COM1_BASE + SERIAL_MCR);
+    outb(SERIAL_IER_RX | SERIAL_IER_LINE, COM1_BASE + SERIAL_IER);
+    inb(COM1_BASE + SERIAL_LSR);                        // clear anything pending from before
+    inb(COM1_BASE + SERIAL_DATA);
+    inb(COM1_BASE + SERIAL_IIR);
+    serial_irq_on = 1;
+    enable_irq(SERIAL_IRQ_NUM);
+    restore_flags(flags);
+}
+
+/*
+ *serial_tx_fill
+ * DESCRIPTION: move queued bytes into the transmit FIFO, which must be empty, and
+ *              disarm the transmit interrupt once nothing is left
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: called with interrupts off
+ */
+static void serial_tx_fill(){
+    uint32_t n;
+    if(tx_tail == tx_head){
+        serial_tx_busy = 0;
+        outb(SERIAL_IER_RX | SERIAL_IER_LINE, COM1_BASE + SERIAL_IER);
+        return;
+    }
+    for(n = 0; n < SERIAL_FIFO_SIZE && tx_tail != tx_head; n++){
+        outb(tx_ring[tx_tail & (SERIAL_TX_SIZE - 1)], COM1_BASE + SERIAL_DATA);
+        tx_tail++;
+    }
+}
+
+/*
+ *serial_wait_thre
+ * DESCRIPTION: spin until the transmitter is empty
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: 0 once it is, -1 after SERIAL_SPIN polls
+ * SIDE EFFECTS: None
+ */
+static int32_t serial_wait_thre(){
+    uint32_t spin;
+    for(spin = 0; spin < SERIAL_SPIN; spin++){
+        if(inb(COM1_BASE + SERIAL_LSR) & SERIAL_LSR_THRE){
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ *serial_putc
+ * DESCRIPTION: send one byte on COM1. Before serial_irq_init the byte is written by
+ *              polling. After it the byte is queued and the transmit interrupt armed;
+ *              when the ring is full, because interrupts have been off too long or
+ *              output outruns the line, the oldest bytes are pushed out by polling
+ *              so nothing is lost and the order is kept.
+ * INPUTS: c -- the byte
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: a byte is dropped if the transmitter stays full for SERIAL_SPIN polls
+ */
+void serial_putc(uint8_t c){
+    uint32_t flags;
+    if(!serial_present){
+        return;
+    }
+    cli_and_save(flags);
+    if(!serial_irq_on){
+        if(serial_wait_thre() == 0){
+            outb(c, COM1_BASE + SERIAL_DATA);
+        }
+        restore_flags(flags);
+        return;
+    }
+    if(tx_head - tx_tail == SERIAL_TX_SIZE){
+        if(serial_wait_thre() == 0){
+            serial_tx_fill();
+        }else{
+            tx_tail++;                                  // the line is stuck, lose the oldest byte
+        }
+    }
+    tx_ring[tx_head & (SERIAL_TX_SIZE - 1)] = c;
+    tx_head++;
+    if(!serial_tx_busy){
+        serial_tx_busy = 1;
+        // arming the interrupt with the transmitter empty raises it right away
+        outb(SERIAL_IER_RX | SERIAL_IER_LINE | SERIAL_IER_TX, COM1_BASE + SERIAL_IER);
+    }
+    restore_flags(flags);
+}
+
+/*
+ *serial_console_putc
+ * DESCRIPTION: send one byte of console text, with a carriage return before a newline
+ *              so a terminal on the other end starts each line at the left
+ * INPUTS: c -- the byte
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void serial_console_putc(uint8_t c){
+    if(c == '\n'){
+        serial_putc('\r');
+    }
+    serial_putc(c);
+}
+
+/*
+ *serial_puts
+ * DESCRIPTION: send a string of console text on COM1
+ * INPUTS: s -- the string
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void serial_puts(const int8_t* s){
+    for(; *s != '\0'; s++){
+        serial_console_putc(*s);
+    }
+}
+
+/*
+ *serial_int_handler
+ * DESCRIPTION: handle every cause the UART reports: refill the transmit FIFO, move
+ *              received bytes into rx_ring, and read the line and modem status to
+ *              clear them
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: received bytes are dropped while rx_ring is full
+ */
+void serial_int_handler(){
+    uint8_t iir;
+    TRACE(TRACE_IRQ, SERIAL_IRQ_NUM);
+    while(!((iir = inb(COM1_BASE + SERIAL_IIR)) & SERIAL_IIR_NONE)){
+        switch(iir & SERIAL_IIR_ID){
+            case SERIAL_IIR_RX:
+            case SERIAL_IIR_TIMEOUT:
+                while(inb(COM1_BASE + SERIAL_LSR) & SERIAL_LSR_DR){
+                    if(rx_head - rx_tail < SERIAL_RX_SIZE){
+                        rx_ring[rx_head & (SERIAL_RX_SIZE - 1)] = inb(COM1_BASE + SERIAL_DATA);
+                        rx_head++;
+                    }else{
+                        inb(COM1_BASE + SERIAL_DATA);
+                        serial_rx_dropped++;
+                    }
+                }
+                break;
+            case SERIAL_IIR_TX:
+                serial_tx_fill();
+                break;
+            case SERIAL_IIR_LINE:
+                inb(COM1_BASE + SERIAL_LSR);
+                break;
+            default:
+                inb(COM1_BASE + SERIAL_MSR);
+                break;
+        }
+    }
+    send_eoi(SERIAL_IRQ_NUM);
+}
+
+/*
+ *serial_lookup
+ * DESCRIPTION: find the serial device file by name, for images whose directory has
+ *              no entry for it
+ * INPUTS: fname -- the name
+ *         dentry -- the entry to fill
+ * OUTPUTS:None
+ * RETURN VALUE: 0 if fname is "serial", -1 otherwise
+ * SIDE EFFECTS: None
+ */
+int32_t serial_lookup(const uint8_t* fname, dentry_t* dentry){
+    if(strncmp((int8_t*)fname, "serial", filename_len) != 0){
+        return -1;
+    }
+    memset(dentry, 0, sizeof(dentry_t));
+    strncpy((int8_t*)dentry->filename, "serial", filename_len);
+    dentry->filetype = 0;                               // a device, like rtc
+    dentry->inode_num = SERIAL_INODE;
+    return 0;
+}
+
+/*
+ *serial_open
+ * DESCRIPTION: open the serial device file
+ * INPUTS: filename -- the name
+ * OUTPUTS:None
+ * RETURN VALUE: 0, -1 if there is no UART
+ * SIDE EFFECTS: None
+ */
+int32_t serial_open(const uint8_t* filename){
+    return serial_present ? 0 : -1;
+}
+
+/*
+ *serial_close
+ * DESCRIPTION: close the serial device file, queued output is still sent
+ * INPUTS: fd -- a file descriptor
+ * OUTPUTS:None
+ * RETURN VALUE: 0
+ * SIDE EFFECTS: None
+ */
+int32_t serial_close(int32_t fd){
+    return 0;
+}
+
+/*
+ *serial_read
+ * DESCRIPTION: copy received bytes, waiting until there is at least one. Every reader
+ *              takes from the same ring.
+ * INPUTS: fd -- a file descriptor
+ *         buf -- the user buffer
+ *         nbytes -- the most bytes to read
+ * OUTPUTS:None
+ * RETURN VALUE: the number of bytes read, -1 for failure
+ * SIDE EFFECTS: the scheduler runs other processes while this one waits
+ */
+int32_t serial_read(int32_t fd, void* buf, int32_t nbytes){
+    uint8_t* out = (uint8_t*)buf;
+    uint32_t flags;
+    int32_t count = 0;
+    if(buf == NULL || nbytes < 0){
+        return -1;
+    }
+    if(nbytes == 0){
+        return 0;
+    }
+    smp_unlock();                                       // the receive interrupt takes the kernel lock
+    while(rx_head == rx_tail);                          // the receive interrupt moves rx_head
+    smp_lock();
+    cli_and_save(flags);
+    while(count < nbytes && rx_tail != rx_head){
+        out[count++] = rx_ring[rx_tail & (SERIAL_RX_SIZE - 1)];
+        rx_tail++;
+    }
+    restore_flags(flags);
+    return count;
+}
+
+/*
+ *serial_write
+ * DESCRIPTION: queue bytes for sending, unchanged, so binary data goes through
+ * INPUTS: fd -- a file descriptor
+ *         buf -- the bytes
+ *         nbytes -- how many
+ * OUTPUTS:None
+ * RETURN VALUE: nbytes, -1 for failure
+ * SIDE EFFECTS: waits for the line when more than SERIAL_TX_SIZE bytes are queued
+ */
+int32_t serial_write(int32_t fd, const void* buf, int32_t nbytes){
+    const uint8_t* in = (const uint8_t*)buf;
+    int32_t i;
+    if(buf == NULL || nbytes < 0){
+        return -1;
+    }
+    for(i = 0; i < nbytes; i++){
+        serial_putc(in[i]);
+    }
+    return nbytes;
+}
@@ -0,0 +1,83 @@
+#ifndef _SERIAL_H
+#define _SERIAL_H
+
+#include "types.h"
+#include "FileSystem.h"
+
+#define COM1_BASE           0x3F8
+#define SERIAL_IRQ_NUM      4       // COM1 interrupt line
+#define SERIAL_DATA         0       // transmit and receive buffer, divisor low byte with DLAB set
+#define SERIAL_IER          1       // interrupt enable, divisor high byte with DLAB set
+#define SERIAL_IIR          2       // interrupt identification on read, FIFO control on write
+#define SERIAL_FCR          2
+#define SERIAL_LCR          3       // line control
+#define SERIAL_MCR          4       // modem control
+#define SERIAL_LSR          5       // line status
+#define SERIAL_MSR          6       // modem status
+#define SERIAL_SCRATCH      7
+#define SERIAL_LCR_DLAB     0x80    // divisor latch access
+#define SERIAL_LCR_8N1      0x03    // 8 data bits, no parity, 1 stop bit
+#define SERIAL_FCR_ENABLE   0xC7    // enable and clear both FIFOs, 14 byte receive trigger
+#define SERIAL_MCR_DTR_RTS  0x03
+#define SERIAL_MCR_OUT2     0x08    // routes the UART interrupt to the PIC
+#define SERIAL_IER_RX       0x01    // received data, or the receive FIFO timed out
+#define SERIAL_IER_TX       0x02    // transmit holding register empty
+#define SERIAL_IER_LINE     0x04    // line status
+#define SERIAL_IIR_NONE     0x01    // no interrupt pending
+#define SERIAL_IIR_ID       0x0E    // interrupt identification bits
+#define SERIAL_IIR_MODEM    0x00
+#define SERIAL_IIR_TX       0x02
+#define SERIAL_IIR_RX       0x04
+#define SERIAL_IIR_LINE     0x06
+#define SERIAL_IIR_TIMEOUT  0x0C
+#define SERIAL_LSR_DR       0x01    // received data ready
+#define SERIAL_LSR_THRE     0x20    // transmit holding register empty
+#define SERIAL_CLOCK        115200  // baud rate of a divisor of 1
+#define SERIAL_BAUD         115200
+#define SERIAL_FIFO_SIZE    16      // bytes the transmit FIFO takes once it is empty
+#define SERIAL_SPIN         100000  // polls of the line status before a byte is given up
+#define SERIAL_TX_SIZE      8192    // transmit ring, a power of 2
+#define SERIAL_RX_SIZE      1024    // receive ring, a power of 2
+#define SERIAL_INODE        1       // inode of the device file, rtc is 0
+
+// what serial= on the boot command line copies to COM1
+#define SERIAL_MIRROR_KERNEL    1   // kernel printf
+#define SERIAL_MIRROR_TERMINAL  2   // and what programs write to their terminal
+
+// SERIAL_MIRROR_KERNEL or SERIAL_MIRROR_TERMINAL to copy screen output, 0 for none
+extern uint32_t serial_mirror;
+
+// bytes lost because the receive ring was full
+extern uint32_t serial_rx_dropped;
+
+// set up COM1 for polled output
+void serial_init();
+
+// move COM1 output and input to interrupts and the rings
+void serial_irq_init();
+
+// send one byte
+void serial_putc(uint8_t c);
+
+// send one byte of console text, with a carriage return before a newline
+void serial_console_putc(uint8_t c);
+
+// send a string of console text
+void serial_puts(const int8_t* s);
+
+// fill a directory entry for the device file named fname
+int32_t serial_lookup(const uint8_t* fname, dentry_t* dentry);
+
+// open the serial device file
+int32_t serial_open(const uint8_t* filename);
+
+// close the serial device file
+int32_t serial_close(int32_t fd);
+
+// read received bytes, waiting for at least one
+int32_t serial_read(int32_t fd, void* buf, int32_t nbytes);
+
+// queue bytes for sending
+int32_t serial_write(int32_t fd, const void* buf, int32_t nbytes);
+
+#endif /* _SERIAL_H */
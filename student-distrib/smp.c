@@ -0,0 +1,332 @@
+#include "smp.h"
+#include "lib.h"
+#include "paging.h"
+#include "spinlock.h"
+#include "scheduler.h"
+#include "systemcall.h"
+#include "terminal.h"
+#include "IDT_wrappers.h"
+
+#define CPUID_FEATURES      1
+#define CPUID_SEP_BIT       11
+
+cpu_t cpus[APIC_MAX_CPUS];
+uint32_t cpu_online_num = 1;
+uint32_t smp_ap_stack = 0;
+static uint32_t smp_ap_index = 0;       // cpus entry of the processor being started
+
+static uint8_t smp_stacks[APIC_MAX_CPUS][SMP_STACK_SIZE] __attribute__ ((aligned(16)));
+
+// the booting processor holds the lock from the start, the kernel is its own until
+// the first program runs
+static spinlock_t kernel_lock = {1, 0};
+static volatile int32_t kernel_lock_owner = 0;
+
+/*
+The lock functions save and restore the flags with raw instructions: the
+interrupts-off statistics of lib.h are shared, and only the holder may touch them.
+*/
+
+/*
+ *smp_lock
+ * DESCRIPTION: take the kernel lock, waiting for the processors that asked first, and
+ *              load this processor's curr_pid and curr_terminal_running
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: interrupts are off while it waits, and as they were after
+ */
+void smp_lock(){
+    uint32_t flags;
+    uint32_t index;
+    asm volatile ("pushfl; popl %0; cli" : "=r"(flags) : : "memory", "cc");
+    index = smp_cpu_index();
+    spin_lock(&kernel_lock);
+    kernel_lock_owner = index;
+    curr_pid = cpus[index].curr_pid;
+    curr_terminal_running = cpus[index].curr_terminal_running;
+    asm volatile ("pushl %0; popfl" : : "r"(flags) : "memory", "cc");
+}
+
+/*
+ *smp_unlock
+ * DESCRIPTION: save this processor's curr_pid and curr_terminal_running and let the
+ *              kernel lock go. The caller holds it.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void smp_unlock(){
+    uint32_t flags;
+    uint32_t index;
+    asm volatile ("pushfl; popl %0; cli" : "=r"(flags) : : "memory", "cc");
+    index = kernel_lock_owner;
+    cpus[index].curr_pid = curr_pid;
+    cpus[index].curr_terminal_running = curr_terminal_running;
+    kernel_lock_owner = -1;
+    spin_unlock(&kernel_lock);
+    asm volatile ("pushl %0; popfl" : : "r"(flags) : "memory", "cc");
+}
+
+/*
+ *smp_enter
+ * DESCRIPTION: take the kernel lock on entry to the kernel, unless this processor
+ *              already holds it: an interrupt of kernel code that holds it. Only the
+ *              holder sets kernel_lock_owner to its own index, so reading it unlocked
+ *              is safe. Called by the entry code with interrupts off.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: 1 if it took the lock, 0 if it was held already
+ * SIDE EFFECTS: None
+ */
+int32_t smp_enter(){
+    if(kernel_lock_owner == (int32_t)smp_cpu_index()){
+        return 0;
+    }
+    smp_lock();
+    return 1;
+}
+
+/*
+ *smp_leave
+ * DESCRIPTION: let the kernel lock go on the way out of the kernel, if smp_enter took it
+ * INPUTS: took -- what smp_enter returned
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void smp_leave(int32_t took){
+    if(took){
+        smp_unlock();
+    }
+}
+
+/*
+ *smp_tss
+ * DESCRIPTION: find the TSS of the processor running this
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: its TSS, the one in x86_desc.S for the booting processor
+ * SIDE EFFECTS: None
+ */
+tss_t* smp_tss(){
+    uint32_t index = smp_cpu_index();
+    return index == 0 ? &tss : &cpus[index].tss;
+}
+
+/*
+ *smp_terminal_cpu
+ * DESCRIPTION: find the processor that runs a terminal's processes
+ * INPUTS: tid -- the terminal
+ * OUTPUTS:None
+ * RETURN VALUE: its index in cpus
+ * SIDE EFFECTS: None
+ */
+uint32_t smp_terminal_cpu(uint8_t tid){
+    return tid % cpu_online_num;
+}
+
+/*
+ *smp_launch
+ * DESCRIPTION: ask the processor serving a terminal to start its shell. It does so
+ *              from its idle loop at its next tick.
+ * INPUTS: tid -- a terminal with no process, served by another processor
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: None
+ */
+void smp_launch(uint8_t tid){
+    cpus[smp_terminal_cpu(tid)].launch = tid;
+}
+
+/*
+ *smp_sysenter_init
+ * DESCRIPTION: point this processor's SYSENTER registers at sysenter_handler. SYSENTER_ESP
+ *              is the address of its sysenter_tss, which the handler reads esp0 through.
+ *              SYSEXIT derives the user CS and SS from SYSENTER_CS + 16 and + 24, which
+ *              matches the GDT order KERNEL_CS, KERNEL_DS, USER_CS, USER_DS. Without SEP
+ *              nothing is set, and user programs fall back to int $0x80.
+ * INPUTS: index -- this processor, in cpus
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: writes the SYSENTER model specific registers
+ */
+void smp_sysenter_init(uint32_t index){
+    if(!(cpuid_edx(CPUID_FEATURES) & (1 << CPUID_SEP_BIT))){
+        return;
+    }
+    cpus[index].sysenter_tss = index == 0 ? &tss : &cpus[index].tss;
+    wrmsr(MSR_SYSENTER_CS, KERNEL_CS, 0);
+    wrmsr(MSR_SYSENTER_ESP, (uint32_t)&cpus[index].sysenter_tss, 0);
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t)sysenter_handler, 0);
+}
+
+/*
+ *smp_tick
+ * DESCRIPTION: timer tick of a processor other than the booting one. The keyboard
+ *              switches the display on the booting processor, so the vidmap page of
+ *              the process here follows it at the tick; then the scheduler runs.
+ *              The global tick statistics stay the booting processor's.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: may switch to another process of this processor's terminals
+ */
+void smp_tick(){
+    cpu_t* cpu = &cpus[smp_cpu_index()];
+    apic_send_eoi();
+    if(curr_pid >= 0 && cpu->display != display_terminal){
+        cpu->display = display_terminal;
+        vidmap_paging();
+    }
+    scheduler();
+}
+
+/*
+ *smp_idle
+ * DESCRIPTION: wait in hlt for a terminal of this processor to be shown, then start
+ *              its shell. execute only comes back if the shell could not start; once
+ *              it runs, the terminal keeps a process and this loop is left for good.
+ * INPUTS: cpu -- this processor
+ * OUTPUTS:None
+ * RETURN VALUE: never returns
+ * SIDE EFFECTS: None
+ */
+static void smp_idle(cpu_t* cpu){
+    uint8_t tid;
+    while(1){
+        // sti and hlt together, so no interrupt slips in between; the raw instructions
+        // keep this processor out of the interrupts-off statistics
+        asm volatile ("sti; hlt; cli" : : : "memory");
+        if(cpu->launch < 0){
+            continue;
+        }
+        smp_lock();
+        tid = cpu->launch;
+        cpu->launch = -1;
+        if(!terminal[tid].active){
+            curr_terminal_running = tid;
+            execute((uint8_t*)"shell");
+        }
+        smp_unlock();
+    }
+}
+
+/*
+ *smp_tss_init
+ * DESCRIPTION: give a processor other than the booting one its TSS, in its own GDT slot,
+ *              so an interrupt from user mode lands on the kernel stack of its process
+ * INPUTS: index -- the processor, 1 to APIC_MAX_CPUS - 1
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: loads the task register, which smp_cpu_index reads from then on
+ */
+static void smp_tss_init(uint32_t index){
+    seg_desc_t the_tss_desc = tss_desc_ptr;     // the booting processor's, but for the base
+    cpu_t* cpu = &cpus[index];
+    memset(&cpu->tss, 0, sizeof(tss_t));
+    cpu->tss.ldt_segment_selector = KERNEL_LDT;
+    cpu->tss.ss0 = KERNEL_DS;
+    cpu->tss.esp0 = cpu->stack_top;
+    SET_TSS_PARAMS(the_tss_desc, &cpu->tss, tss_size);
+    the_tss_desc.type = 0x9;                    // available, the booting one's is marked busy
+    ap_tss_desc_ptr[index - 1] = the_tss_desc;
+    ltr(AP_TSS + (index - 1) * 8);
+}
+
+/*
+ *smp_ap_main
+ * DESCRIPTION: bring a processor other than the booting one the rest of the way up:
+ *              its page directory, local APIC and timer, LDT, TSS and SYSENTER
+ *              registers. It then says it is online and idles until its terminal
+ *              has a shell to run. None of this takes the kernel lock, which the
+ *              booting processor holds while it starts the others.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: never returns
+ * SIDE EFFECTS: sets its cpus entry online
+ */
+void smp_ap_main(){
+    uint32_t index = smp_ap_index;
+    cpu_t* cpu = &cpus[index];
+    paging_init_ap(index);
+    apic_init_ap();
+    lldt(KERNEL_LDT);
+    smp_tss_init(index);
+    smp_sysenter_init(index);
+    cpu->curr_pid = -1;
+    cpu->curr_terminal_running = index;
+    cpu->display = 0;
+    cpu->launch = -1;
+    cpu->online = 1;
+    smp_idle(cpu);
+}
+
+/*
+ *smp_start_cpu
+ * DESCRIPTION: start one processor with INIT and two STARTUP IPIs, the 10ms and 200us
+ *              waits the MP specification asks for, and wait for it to come online.
+ *              It takes the next cpus entry, so the processors online are the first
+ *              cpu_online_num entries even when one does not come up.
+ * INPUTS: apic_index -- the processor, in apic_cpu_ids
+ * OUTPUTS:None
+ * RETURN VALUE: 0 once it is online, -1 if it did not come up
+ * SIDE EFFECTS: counts it in cpu_online_num. A processor that did not come up is sent
+ *               INIT again, so it cannot wake later on the stack of the next one
+ */
+static int32_t smp_start_cpu(uint32_t apic_index){
+    uint32_t i;
+    uint32_t index = cpu_online_num;
+    cpu_t* cpu = &cpus[index];
+    cpu->apic_id = apic_cpu_ids[apic_index];
+    cpu->online = 0;
+    cpu->stack_top = (uint32_t)&smp_stacks[index][SMP_STACK_SIZE];
+    smp_ap_stack = cpu->stack_top;
+    smp_ap_index = index;
+    apic_send_ipi(cpu->apic_id, APIC_ICR_INIT);
+    apic_delay_us(10000);
+    for(i = 0; i < 2 && !cpu->online; i++){
+        apic_send_ipi(cpu->apic_id, APIC_ICR_STARTUP | (SMP_TRAMPOLINE >> 12));
+        apic_delay_us(200);
+    }
+    for(i = 0; i < SMP_START_TRIES && !cpu->online; i++){
+        apic_delay_us(1000);
+    }
+    if(!cpu->online){
+        apic_send_ipi(cpu->apic_id, APIC_ICR_INIT);
+        return -1;
+    }
+    cpu_online_num++;
+    return 0;
+}
+
+/*
+ *smp_init
+ * DESCRIPTION: copy the trampoline to SMP_TRAMPOLINE and start every other processor
+ *              found in the APIC tables, one at a time since they share smp_ap_stack.
+ *              Called with interrupts off, after apic_init.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: prints how many processors came up
+ */
+void smp_init(){
+    uint32_t i;
+    uint8_t* tramp = (uint8_t*)SMP_TRAMPOLINE;
+    cpus[0].apic_id = apic_cpu_ids[0];
+    cpus[0].online = 1;
+    if(!apic_on || apic_cpu_num < 2){
+        return;
+    }
+    map_low_page(SMP_TRAMPOLINE, 1);
+    memcpy(tramp, smp_trampoline_start, smp_trampoline_end - smp_trampoline_start);
+    memcpy(tramp + (smp_tramp_gdt - smp_trampoline_start), gdt_desc_ptr, 6);
+    for(i = 1; i < apic_cpu_num; i++){
+        if(smp_start_cpu(i) != 0){
+            printf("Processor %d (APIC %d) did not start\n", i, apic_cpu_ids[i]);
+        }
+    }
+    map_low_page(SMP_TRAMPOLINE, 0);
+    printf("%d of %d processors online\n", cpu_online_num, apic_cpu_num);
+}
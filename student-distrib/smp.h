@@ -0,0 +1,104 @@
+#ifndef _SMP_H
+#define _SMP_H
+
+#include "apic.h"
+
+/*
+Other processors. smp_init starts every processor the APIC tables list with
+the INIT, STARTUP, STARTUP sequence. Each one enters 16-bit code copied to
+SMP_TRAMPOLINE, switches to protected mode on the kernel's GDT and then runs
+smp_ap_main on its own stack, with its own TSS, SYSENTER stack, page directory
+and local APIC timer. smp=0 on the command line leaves them stopped.
+
+Terminal t is served by processor t % cpu_online_num: its processes are only
+ever scheduled there, so a process never moves and its user pages are only in
+the TLB of one processor. An idle processor starts its terminal's shell when
+the terminal is first shown.
+
+The kernel itself runs under one lock. Every interrupt, exception and system
+call takes it on entry unless the processor already holds it, and lets it go
+on the way out, so the kernel code keeps its one-processor view: curr_pid and
+curr_terminal_running are swapped with the processor's copies in cpus as the
+lock changes hands, and cli still keeps out this processor's handlers. A user
+program runs without the lock, and the kernel drops it around the loops that
+wait for another processor's interrupt, such as a read of the keyboard.
+*/
+#define SMP_TRAMPOLINE      0x7000      // page the other processors start in, below 1MB
+#define SMP_STACK_SIZE      4096        // kernel stack of each other processor
+#define SMP_START_TRIES     100         // milliseconds to wait for a processor to come up
+
+/* SYSENTER model specific registers */
+#define MSR_SYSENTER_CS     0x174
+#define MSR_SYSENTER_ESP    0x175
+#define MSR_SYSENTER_EIP    0x176
+
+#ifndef ASM
+
+#include "types.h"
+#include "x86_desc.h"
+
+// what a processor has of its own
+typedef struct cpu{
+    uint8_t apic_id;
+    volatile uint32_t online;       // set by the processor once it is up
+    tss_t tss;                      // the booting processor uses the one in x86_desc.S
+    uint32_t stack_top;
+    tss_t* sysenter_tss;            // SYSENTER_ESP points here, the handler finds esp0 through it
+    int8_t curr_pid;                // its process while another processor holds the kernel lock
+    uint8_t curr_terminal_running;
+    uint8_t display;                // display_terminal when it last mapped its vidmap page
+    volatile int8_t launch;         // terminal whose shell it is to start, -1 for none
+}cpu_t;
+
+extern cpu_t cpus[APIC_MAX_CPUS];
+extern uint32_t cpu_online_num;     // processors up, the booting one included
+
+// start the other processors, after apic_init
+void smp_init();
+
+// C entry of the other processors, from the trampoline
+void smp_ap_main();
+
+// point this processor's SYSENTER registers at sysenter_handler
+void smp_sysenter_init(uint32_t index);
+
+// this processor's TSS, where esp0 is set for the process it runs
+tss_t* smp_tss();
+
+// processor that runs the processes of a terminal
+uint32_t smp_terminal_cpu(uint8_t tid);
+
+// start the shell of a terminal served by another processor
+void smp_launch(uint8_t tid);
+
+// tick of the local APIC timer of the other processors
+void smp_tick();
+
+// take and let go of the kernel lock, with curr_pid and curr_terminal_running
+void smp_lock();
+void smp_unlock();
+
+// the entry code's forms: smp_enter returns 1 if it took the lock, and
+// smp_leave lets it go only then
+int32_t smp_enter();
+void smp_leave(int32_t took);
+
+/* index of the processor running this, 0 for the booting one, read from the
+   task register since each processor loads its own TSS slot */
+static inline uint32_t smp_cpu_index() {
+    uint16_t sel;
+    asm volatile ("str %0" : "=r"(sel));
+    return sel < AP_TSS ? 0 : (sel - AP_TSS) / 8 + 1;
+}
+
+// the trampoline, copied to SMP_TRAMPOLINE
+extern uint8_t smp_trampoline_start[];
+extern uint8_t smp_trampoline_end[];
+extern uint8_t smp_tramp_gdt[];         // where it keeps the GDTR image
+
+// stack top the next processor to start loads, read by the trampoline
+extern uint32_t smp_ap_stack;
+
+#endif /* ASM */
+
+#endif /* _SMP_H */
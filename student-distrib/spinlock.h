@@ -0,0 +1,40 @@
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+#include "types.h"
+
+/*
+Spinlocks, for data shared between processors. Turning interrupts off only
+keeps out the handlers of the processor doing it; a lock also keeps out the
+others. They are ticket locks: each processor takes the next ticket and waits
+for its turn, so a processor that lets go and takes the lock straight back
+cannot starve one already waiting. The holder does not change the interrupt
+flag; callers that an interrupt handler could reenter turn interrupts off first.
+*/
+typedef struct spinlock{
+    volatile uint32_t next;     // ticket the next processor to ask gets
+    volatile uint32_t serving;  // ticket of the holder
+}spinlock_t;
+
+#define SPINLOCK_INIT       {0, 0}
+
+/* Take the lock, spinning until every processor that asked first has let go */
+static inline void spin_lock(spinlock_t* lock) {
+    uint32_t ticket = 1;
+    asm volatile ("lock; xaddl %0, %1"
+            : "+r"(ticket), "+m"(lock->next)
+            :
+            : "memory", "cc"
+    );
+    while (lock->serving != ticket) {
+        asm volatile ("pause" : : : "memory");
+    }
+}
+
+/* Let the lock go; stores are not reordered on x86, the barrier keeps the compiler in line */
+static inline void spin_unlock(spinlock_t* lock) {
+    asm volatile ("" : : : "memory");
+    lock->serving = lock->serving + 1;
+}
+
+#endif /* _SPINLOCK_H */
@@ -1,13 +1,44 @@
 #include "systemcall.h"
 #include "lib.h"
 #include "FileSystem.h"
+#include "scheduler.h"
+#include "pagecache.h"
+#include "proc.h"
+#include "trace.h"
+#include "serial.h"
+#include "profile.h"
+#include "smp.h"
 
 file_operation_table_t null_operation = {0, 0, 0, 0};
 file_operation_table_t file_operation = {file_read, file_write, file_open, file_close};
 file_operation_table_t rtc_operation = {rtc_read, rtc_write, rtc_open, rtc_close};
+file_operation_table_t serial_operation = {serial_read, serial_write, serial_open, serial_close};
 file_operation_table_t terminal_operation = {terminal_read, terminal_write, terminal_open, terminal_close};
 file_operation_table_t directory_operation = {directory_read, directory_write, directory_open, directory_close};
-int8_t pid_count[6] = {0, 0, 0, 0, 0, 0};      // used to indicate the current running process, max 6, 1 means running
+file_operation_table_t proc_operation = {proc_read, proc_write, proc_open, proc_close};
+uint32_t pid_bitmap[PID_BITMAP_WORDS];          // one bit per pid, 1 means in use
+pcb_t* pcb_table[MAX_PID_NUM];                  // pid -> pcb at the bottom of its kernel stack, NULL when free
+int32_t max_pid_num = DEFAULT_PID_NUM;          // pids usable after boot, set by process_init
+uint8_t kstack_free_slot[MAX_PID_NUM];          // free kernel stack slots, used as a stack so freed slots are reused first
+int32_t kstack_free_num = 0;                    // number of entries in kstack_free_slot
+int8_t curr_pid = -1;                           // pid owning the cpu, switched by execute, halt and the scheduler
+
+/* find_first_zero
+* Description: index of the lowest clear bit of a word that is not all ones
+* Input: word -- bitmap word
+* Output: None
+* Return value: bit index 0 to 31
+* Side effect: None
+*/
+static inline uint32_t find_first_zero(uint32_t word){
+    uint32_t bit;
+    asm volatile ("bsfl %1, %0"
+            : "=r"(bit)
+            : "r"(~word)
+            : "cc"
+    );
+    return bit;
+}
 
 /* halt
 * Description: This function is used to halt and terminate the process.
@@ -20,33 +51,54 @@ int8_t pid_count[6] = {0, 0, 0, 0, 0, 0};      // used to indicate the current r
 int32_t halt (uint8_t status){
     cli();
     // get pcb before halt
-    pcb_t* pcb = get_pcb(terminal[curr_terminal_running].curr_pid);
+    pcb_t* pcb = get_curr_pcb();
     // restore its parent's ebp and esp
     uint32_t ebp_restore = pcb->saved_ebp;
     uint32_t esp_restore = pcb->saved_esp;
     // get parent pid
     int8_t parent_pid = pcb->parent_pid;
     // get halt pid 
-    int8_t halting_pid = terminal[curr_terminal_running].curr_pid;
+    int8_t halting_pid = curr_pid;
+    uint8_t tid = pcb->tid;
     uint8_t shell[] = "shell";
+    TRACE(TRACE_HALT, status);
     // clear fd
     int32_t fd;
     for (fd = 2; fd < 8; fd++) {
         close(fd);
     } 
-    // update the pid_count array
+    // background children of the halting process can no longer be reaped by it
+    orphan_children(halting_pid);
+    // a background child has no parent blocked in execute, leave a zombie for waitpid
+    if(pcb->background){
+        pcb->exit_status = status;
+        pcb->state = PROCESS_ZOMBIE;
+        if(parent_pid == -1){
+            del_pid(halting_pid);       // orphaned, nobody will reap it
+        }
+        // zombies are never picked again, so this does not return
+        scheduler();
+    }
+    // the parent, if any, takes the cpu straight from the halting process
+    sched_account(halting_pid, parent_pid);
+    // free the pid and its kernel stack
     del_pid(halting_pid); 
     // check if it is the last process in current running terminal, if it is, re-launch shell
     if(parent_pid == -1){
-        terminal[curr_terminal_running].curr_pid = -1;
-        terminal[curr_terminal_running].active = 0;
+        terminal[tid].curr_pid = -1;
+        terminal[tid].active = 0;
         execute(shell);
     }
     // remap the parent process paging
     map_program(parent_pid);
-    // update necessary tss properties
-    tss.esp0 = pcb -> saved_esp;
-    terminal[curr_terminal_running].curr_pid = parent_pid;
+    // update necessary tss properties, on this processor's TSS
+    smp_tss()->esp0 = get_kstack_top(parent_pid);
+    // the parent was blocked in execute, it is runnable again
+    get_pcb(parent_pid)->state = PROCESS_RUNNING;
+    if(terminal[tid].curr_pid == halting_pid){
+        terminal[tid].curr_pid = parent_pid;
+    }
+    curr_pid = parent_pid;
     sti();
     asm volatile ("                 \n\
             movl    %0, %%eax      \n\
@@ -73,79 +125,146 @@ int32_t halt (uint8_t status){
 */
 int32_t execute (const uint8_t* command){
     cli();
-    int32_t ret;
-    if(command == NULL){          
-        return -1;
-    }
-    //crete a buffer to store file name
-    uint8_t fname[10]; 
-    int8_t arg[MAX_ARGUMENT_SIZE];
-    ret = parse_cmd(command, fname, arg);
-    if(ret < 0){
-        return -1;
-    }
-
-    // Executable check
     uint32_t entry;
-    dentry_t dentry;
-    if(read_dentry_by_name(fname, &dentry) < 0){
-        return -1;                                      
-    }
-    //check the magic number (0x7f;0x45;0x4c;0x46) specified in Appendix C
-    //create a buffer of size 4 to check the first 4 bytes of the file
-    uint8_t buf[4];
-    // fails to read bytes at the start of file 
-    if(read_data(dentry.inode_num, 0, buf, VALID_NBYTES) != SUCCESS_RETURN_NBYTES){
-        return -1;
-    }
-    // magic number is not present
-    if(buf[0] != 0x7f || buf[1] != 0x45 || buf[2] != 0x4c || buf[3] != 0x46){   
-        return -1;                                      
-    }
-    // fals to get the information of entry point into the program needed for executing program
-    if(read_data(dentry.inode_num, START_BYTE_ENTRY_POINT, buf, VALID_NBYTES) != SUCCESS_RETURN_NBYTES){
-        return -1;
-    }
-    entry = *((uint32_t*)buf);
-    int8_t pid = get_pid();
+    int8_t pid = load_program(command, &entry);
     if(pid < 0){
+        sti();
         return -1;
     }
-// Set up program paging
-    map_program(pid);
-    flush_tlb();
-// User-level Program Loader
-    uint32_t filelen_ = get_filelen(dentry.inode_num);
-    read_data(dentry.inode_num, 0, (uint8_t*)0x8048000, filelen_);
-// Create PCB
-    pcb_t pcb;
-    init_pcb(&pcb, pid);
-    pcb_t* pcb_ptr = get_pcb(pid);
-    strcpy(pcb.args, arg);
-    if(terminal[display_terminal].active == 0){
-        curr_terminal_running = display_terminal;
-        pcb.parent_pid = -1;
-        terminal[display_terminal].active = 1;
+    TRACE(TRACE_EXECUTE, pid);
+    pcb_t* pcb = get_pcb(pid);
+    if(terminal[curr_terminal_running].active == 0){
+        pcb->parent_pid = -1;
+        terminal[curr_terminal_running].active = 1;
+        terminal[curr_terminal_running].curr_pid = pid;
     }else{
-        pcb.parent_pid = terminal[display_terminal].curr_pid;
+        pcb->parent_pid = curr_pid;
+        // the parent sleeps until halt jumps back to exe_ret
+        get_pcb(curr_pid)->state = PROCESS_WAITING;
+        // only a foreground parent hands the keyboard to its child
+        if(terminal[curr_terminal_running].curr_pid == curr_pid){
+            terminal[curr_terminal_running].curr_pid = pid;
+        }
     }
-    terminal[display_terminal].curr_pid = pcb.pid;
-    pcb.active = 1;
+    sched_account(curr_pid, pid);
+    curr_pid = pid;
     asm volatile("         \n\
         movl %%ebp, %0     \n\
         movl %%esp, %1     \n\
         "
-        : "=r"(pcb.saved_ebp), "=r"(pcb.saved_esp));
-    memcpy(pcb_ptr, &pcb, sizeof(pcb_t));
-// Context Switch
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = NUM_8MB - NUM_8KB * pid - 4;  //8MB- 8KB * number of processes
+        : "=r"(pcb->saved_ebp), "=r"(pcb->saved_esp));
+// Context Switch, on this processor's TSS
+    smp_tss()->ss0 = KERNEL_DS;
+    smp_tss()->esp0 = get_kstack_top(pid);
     sti();
     context_switch(entry);
     asm volatile ("exe_ret:");
     return 0;
 }
 
+/* spawn
+* Description: This function is used to start a program in the background. The child is
+*              loaded now but only entered by the scheduler, so the caller keeps running.
+* Input: command -- a space-separated sequence of words needed to be execute
+* Output: None
+* Return value: -1 -- command could not be executed
+*               pid of the child -- successes
+* Side effect: a new runnable process on the caller's terminal
+*/
+int32_t spawn (const uint8_t* command){
+    cli();
+    uint32_t entry;
+    if(curr_pid < 0){                   // only a process can own a background child
+        sti();
+        return -1;
+    }
+    int8_t pid = load_program(command, &entry);
+    if(pid < 0){
+        sti();
+        return -1;
+    }
+    TRACE(TRACE_EXECUTE, pid);
+    // loading the child took over the user page, give it back to the caller
+    map_program(curr_pid);
+    pcb_t* pcb = get_pcb(pid);
+    pcb->parent_pid = curr_pid;
+    pcb->background = 1;
+    pcb->first_run = 1;
+    pcb->ready_since = rdtsc();         // runnable, waiting for its first time slice
+    link_child(curr_pid, pid);
+    sti();
+    return pid;
+}
+
+/* waitpid
+* Description: This function is used to reap a halted background child of the caller.
+* Input: pid -- child to wait for, or WAIT_ANY_CHILD
+*        status -- where the child's halt status is stored, may be NULL
+*        options -- WAIT_NOHANG to poll instead of blocking
+* Output: None
+* Return value: -1 -- no matching child
+*               0 -- WAIT_NOHANG and no matching child has halted yet
+*               pid of the reaped child -- successes
+* Side effect: frees the child's pid
+*/
+int32_t waitpid (int32_t pid, int32_t* status, int32_t options){
+    int8_t i;
+    pcb_t* child;
+    // status must point into the user program page
+    if(status != NULL && ((int32_t)status < NUM_128MB || (int32_t)status > NUM_132MB - 4)){
+        return -1;
+    }
+    while(1){
+        cli();
+        // only the caller's own child list is walked, a given pid is checked directly
+        if(pid == WAIT_ANY_CHILD){
+            i = get_curr_pcb()->first_child;
+        }else if(pid_in_use(pid) && get_pcb(pid)->parent_pid == curr_pid && get_pcb(pid)->background){
+            i = pid;
+        }else{
+            i = -1;
+        }
+        if(i == -1){
+            sti();
+            return -1;
+        }
+        for(; i != -1; i = child->next_sibling){
+            child = get_pcb(i);
+            if(child->state == PROCESS_ZOMBIE){
+                if(status != NULL){
+                    *status = child->exit_status;
+                }
+                unlink_child(curr_pid, i);
+                del_pid(i);
+                sti();
+                return i;
+            }
+            if(pid != WAIT_ANY_CHILD){
+                break;
+            }
+        }
+        if(options & WAIT_NOHANG){
+            sti();
+            return 0;
+        }
+        // give the rest of the time slice away until the child halts
+        scheduler();
+        sti();
+    }
+}
+
+/* null_call
+* Description: This function is the system call null_call. It does no work, so timing it
+*              measures only the cost of entering and leaving the kernel.
+* Input: None
+* Output: None
+* Return value: 0
+* Side effect: None
+*/
+int32_t null_call (void){
+    return 0;
+}
+
 /* read
 * Description: This function is used to read the file content stored in the buffer.
 * Input: fd -- a file descriptor
@@ -169,7 +288,7 @@ int32_t read (int32_t fd, void* buf, int32_t nbytes){
     else if (nbytes < 0) { // number of bytes written should not less than 0
         return -1;
     }
-    pcb_t* pcb = (pcb_t*)(NUM_8MB - NUM_8KB * (terminal[curr_terminal_running].curr_pid + 1)); // get current pcb based on pid
+    pcb_t* pcb = get_curr_pcb(); // get current pcb based on pid
     int32_t flag = pcb->fd_arr[fd].flags; // get the flags to find whether fd is in-use
     if (flag == 0) {
         return -1; // not in use then fails
@@ -200,7 +319,7 @@ int32_t write (int32_t fd, const void* buf, int32_t nbytes){
     else if (nbytes < 0) { // number of bytes written should not less than 0
         return -1;
     }
-    pcb_t* pcb = get_pcb (terminal[curr_terminal_running].curr_pid); // get current pcb based on pid
+    pcb_t* pcb = get_curr_pcb(); // get current pcb based on pid
     int32_t flag = pcb->fd_arr[fd].flags; // get the flags to find whether fd is in-use
     if (flag == 0) { 
         return -1; // not in use then fails
@@ -208,6 +327,106 @@ int32_t write (int32_t fd, const void* buf, int32_t nbytes){
     return pcb->fd_arr[fd].file_operation_table->write(fd, buf, nbytes);
 }
 
+/* check_iov
+* Description: This function checks a readv/writev vector before any of it is used.
+* Input: iov -- the iovec array passed by the user program
+*        iovcnt -- the number of entries in iov
+* Output: None
+* Return value: -1 -- the vector is invalid
+*               0 -- the vector is valid
+* Side effect: None
+*/
+static int32_t check_iov (const iovec_t* iov, int32_t iovcnt){
+    int32_t i;
+    if (iovcnt < 0 || iovcnt > MAX_IOV_NUM) {
+        return -1;
+    }
+    // the array itself must lie in the user program page
+    if ((int32_t)iov < NUM_128MB || (int32_t)(iov + iovcnt) > NUM_132MB) {
+        return -1;
+    }
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].base == NULL || iov[i].len < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* readv
+* Description: This function is the system call readv. It reads into each buffer of the
+*              vector in turn through the fd's read function, and stops early on a short read.
+* Input: fd -- a file descriptor
+*        iov -- the iovec array to fill
+*        iovcnt -- the number of entries in iov
+* Output: None
+* Return value: -1 -- function fails
+*               total number of bytes read -- function successes
+* Side effect: None
+*/
+int32_t readv (int32_t fd, const iovec_t* iov, int32_t iovcnt){
+    int32_t i, cnt, total;
+    if (fd < FILE_MIN_NUM || fd > FILE_MAX_NUM || fd == STD_OUT_NUM) { // same fd rules as read
+        return -1;
+    }
+    if (check_iov(iov, iovcnt) == -1) {
+        return -1;
+    }
+    pcb_t* pcb = get_curr_pcb();
+    if (pcb->fd_arr[fd].flags == 0) {
+        return -1;
+    }
+    total = 0;
+    for (i = 0; i < iovcnt; i++) {
+        cnt = pcb->fd_arr[fd].file_operation_table->read(fd, iov[i].base, iov[i].len);
+        if (cnt == -1) {
+            return (total == 0) ? -1 : total;   // report what was read before the failure
+        }
+        total += cnt;
+        if (cnt < iov[i].len) {
+            break;
+        }
+    }
+    return total;
+}
+
+/* writev
+* Description: This function is the system call writev. It writes each buffer of the
+*              vector in turn through the fd's write function. The cursor is held for
+*              the whole vector, so a terminal moves it once instead of once per buffer.
+* Input: fd -- a file descriptor
+*        iov -- the iovec array to write
+*        iovcnt -- the number of entries in iov
+* Output: None
+* Return value: -1 -- function fails
+*               total number of bytes written -- function successes
+* Side effect: None
+*/
+int32_t writev (int32_t fd, const iovec_t* iov, int32_t iovcnt){
+    int32_t i, cnt, total;
+    if (fd < FILE_MIN_NUM || fd > FILE_MAX_NUM || fd == STDIN_NUM) { // same fd rules as write
+        return -1;
+    }
+    if (check_iov(iov, iovcnt) == -1) {
+        return -1;
+    }
+    pcb_t* pcb = get_curr_pcb();
+    if (pcb->fd_arr[fd].flags == 0) {
+        return -1;
+    }
+    total = 0;
+    hold_cursor();
+    for (i = 0; i < iovcnt; i++) {
+        cnt = pcb->fd_arr[fd].file_operation_table->write(fd, iov[i].base, iov[i].len);
+        if (cnt == -1) {
+            break;
+        }
+        total += cnt;
+    }
+    release_cursor();
+    return (total == 0 && i < iovcnt) ? -1 : total;
+}
+
 /* open
 * Description: This function is used to open the corresponding file.
 * Input: filename -- the name of the file to open
@@ -217,7 +436,7 @@ int32_t write (int32_t fd, const void* buf, int32_t nbytes){
 * Side effect: Open the file and fill in the fd array
 */
 int32_t open (const uint8_t* filename){
-    pcb_t* PCB = get_pcb(terminal[curr_terminal_running].curr_pid);                      //Get the current pcb structure
+    pcb_t* PCB = get_curr_pcb();                                        //Get the current pcb structure
     int32_t index = 2;                                  //2 because we don't want stdin and stdout
     dentry_t dentry;                                    //dentry structure
     if (filename == NULL || read_dentry_by_name(filename, &dentry) == -1) {     //check if the file exists and the file name is valid 
@@ -229,7 +448,18 @@ int32_t open (const uint8_t* filename){
     if (index == 8) {                                               //if reaches the max number do noting and return -1
         return -1;
     }
-    if (dentry.filetype == 0) {                                    //0 is the file type number for rtc
+    if (dentry.filetype == 0 && dentry.inode_num == SERIAL_INODE) {  //devices share file type 0, the inode picks the serial port
+        if (serial_open(filename) == -1) {
+            return -1;
+        }
+        PCB->fd_arr[index].file_operation_table = &serial_operation;
+        PCB->fd_arr[index].inode = SERIAL_INODE;
+        PCB->fd_arr[index].file_pos = 0;
+        PCB->fd_arr[index].seq_pos = -1;
+        PCB->fd_arr[index].flags = 1;
+    }
+
+    else if (dentry.filetype == 0) {                               //0 is the file type number for rtc
         if (rtc_open(filename) == -1) {                            // if cannot rtc open, do noting and return -1
             return -1;
         }
@@ -237,6 +467,7 @@ int32_t open (const uint8_t* filename){
         PCB->fd_arr[index].file_operation_table = &rtc_operation;       //fill in the file op table with rtc op
         PCB->fd_arr[index].inode = 0;                                   //initialize inode
         PCB->fd_arr[index].file_pos = 0;                                //initialize file pos
+        PCB->fd_arr[index].seq_pos = -1;                                //no read yet
         PCB->fd_arr[index].flags = 1;                                   //set flag to in use
     } 
     
@@ -248,6 +479,7 @@ int32_t open (const uint8_t* filename){
         PCB->fd_arr[index].file_operation_table = &directory_operation; //fill in the file op table with directory op
         PCB->fd_arr[index].inode = 0;                                    //initialize inode
         PCB->fd_arr[index].file_pos = 0;                                //initialize file pos
+        PCB->fd_arr[index].seq_pos = -1;                                //no read yet
         PCB->fd_arr[index].flags = 1;                                    //set flag to in use
     }
    
@@ -258,8 +490,23 @@ int32_t open (const uint8_t* filename){
         PCB->fd_arr[index].file_operation_table = &file_operation;      //fill in the file op table with file op
         PCB->fd_arr[index].inode = dentry.inode_num;                     //initialize inode
         PCB->fd_arr[index].file_pos = 0;                                 //initialize file pos
+        PCB->fd_arr[index].seq_pos = -1;                                 //no read yet
         PCB->fd_arr[index].flags = 1;                                   //set flag to in use
     }
+
+    else if (dentry.filetype == PROC_FILETYPE) {                        //kernel statistics, the inode picks the report
+        if (dentry.inode_num >= PROC_FILE_NUM || proc_open(filename) == -1) {
+            return -1;
+        }
+        PCB->fd_arr[index].file_operation_table = &proc_operation;
+        PCB->fd_arr[index].inode = dentry.inode_num;
+        PCB->fd_arr[index].file_pos = 0;                                 //the position in the report
+        PCB->fd_arr[index].seq_pos = -1;
+        PCB->fd_arr[index].flags = 1;
+    }
+    else {
+        return -1;                                                      //unknown file type
+    }
     return index;                                                       //retunr fd number 
 }
 
@@ -275,7 +522,7 @@ int32_t close (int32_t fd){
     if(fd <= 1 || fd > FILE_MAX_NUM){                                   // 1 because we don't want it to be stdin and stdout, max num to check it is out of bound
         return -1;
     }
-    pcb_t *PCB = get_pcb(terminal[curr_terminal_running].curr_pid);                                     //get the currently used pcb
+    pcb_t *PCB = get_curr_pcb();                                        //get the currently used pcb
     if(PCB->fd_arr[fd].flags == 0){                                     //check if the file is  in use
         return -1;
     }
@@ -294,7 +541,7 @@ int32_t close (int32_t fd){
 */
 int32_t getargs(uint8_t* buf, int32_t nbytes){
     if(!buf || nbytes < 0) return -1;
-    pcb_t* pcb = get_pcb(terminal[curr_terminal_running].curr_pid);
+    pcb_t* pcb = get_curr_pcb();
     //if there are no arguments, or if the arguments and a terminal NULL, or do not fit in the buffer, return -1
     if(*(pcb -> args) == NULL || *(pcb -> args) == '\0' || strlen(pcb -> args) > nbytes) return -1;
     //copy to buf
@@ -318,6 +565,210 @@ int32_t vidmap(uint8_t** screen_start){
     return 0;
 }
 
+/* mmap
+* Description: This function is the system call mmap. It maps the data blocks of an open
+*              file read-only into the caller's mmap region, one page per block, so the
+*              program reads the filesystem image without copying it. An image on disk is
+*              mapped through bounce copies of its cached blocks. Mappings last until
+*              the process halts.
+* Input: fd -- a file descriptor opened on a regular file
+*        start -- the user-level pointer that receives the address of the mapping
+* Output: None
+* Return value: -1 -- function fails
+*               length of the file in bytes -- function successes
+* Side effect: uses pages of the caller's mmap region
+*/
+int32_t mmap (int32_t fd, uint8_t** start){
+    uint32_t i, len, num_block;
+    int32_t result;
+    pcb_t* pcb;
+    if (fd < FILE_MIN_NUM || fd > FILE_MAX_NUM) {
+        return -1;
+    }
+    if (!start || (int32_t)start < NUM_128MB || (int32_t)start > NUM_132MB - 4) {
+        return -1;
+    }
+    pcb = get_curr_pcb();
+    if (pcb->fd_arr[fd].flags == 0 || pcb->fd_arr[fd].file_operation_table != &file_operation) {
+        return -1;  // only regular files have data blocks
+    }
+    len = get_filelen(pcb->fd_arr[fd].inode);
+    num_block = (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (pcb->mmap_pages + num_block > ONE_K) {
+        return -1;  // the 4MB region is full
+    }
+    for (i = 0; i < num_block; i++) {
+        if (datablock_base != NULL) {
+            result = map_file_page(curr_pid, pcb->mmap_pages + i, get_datablock(pcb->fd_arr[fd].inode, i), 0);
+        } else {
+            // an image on disk has no block to map in place, map a copy of the cached one
+            sched_hold();
+            result = map_file_page(curr_pid, pcb->mmap_pages + i, pcache_get(pcb->fd_arr[fd].inode, i), 1);
+            sched_release();
+        }
+        if (result == -1) {
+            break;
+        }
+    }
+    if (i < num_block) {
+        unmap_file_pages(curr_pid, pcb->mmap_pages, i);   // undo the part that was mapped
+        flush_tlb();
+        return -1;
+    }
+    *start = (uint8_t*)(NUM_136MB + pcb->mmap_pages * FOUR_K);
+    pcb->mmap_pages += num_block;
+    flush_tlb();
+    return len;
+}
+
+/* getdents
+* Description: This function is the system call getdents. It fills the buffer with as many
+*              directory entries as fit, each with the file type, inode and size, so a
+*              listing needs neither one read per name nor an open per file.
+* Input: fd -- a file descriptor opened on the directory
+*        buf -- the user buffer, an array of dirent_t
+*        nbytes -- the size of buf
+* Output: None
+* Return value: -1 -- function fails
+*               number of bytes filled, 0 at the end of the directory -- function successes
+* Side effect: None
+*/
+int32_t getdents (int32_t fd, void* buf, int32_t nbytes){
+    if (fd < FILE_MIN_NUM || fd > FILE_MAX_NUM || nbytes < 0) {
+        return -1;
+    }
+    // the buffer must lie in the user program page
+    if ((int32_t)buf < NUM_128MB || (int32_t)buf + nbytes > NUM_132MB) {
+        return -1;
+    }
+    pcb_t* pcb = get_curr_pcb();
+    if (pcb->fd_arr[fd].flags == 0 || pcb->fd_arr[fd].file_operation_table != &directory_operation) {
+        return -1;
+    }
+    return directory_getdents(fd, buf, nbytes);
+}
+
+/* stat
+* Description: This function is the system call stat. It reports the length, type and inode
+*              of a file by name without opening it.
+* Input: filename -- the name of the file
+*        buf -- the user buffer, a stat_t
+* Output: None
+* Return value: -1 -- function fails
+*               0 -- function successes
+* Side effect: None
+*/
+int32_t stat (const uint8_t* filename, void* buf){
+    dentry_t dentry;
+    stat_t* st = (stat_t*)buf;
+    if ((int32_t)buf < NUM_128MB || (int32_t)buf > NUM_132MB - (int32_t)sizeof(stat_t)) {
+        return -1;  // the buffer must lie in the user program page
+    }
+    if (filename == NULL || read_dentry_by_name(filename, &dentry) == -1) {
+        return -1;
+    }
+    st->filetype = dentry.filetype;
+    st->inode_num = dentry.inode_num;
+    st->length = (dentry.filetype == 2) ? get_filelen(dentry.inode_num) : 0;    // 2 is a regular file
+    return 0;
+}
+
+/* fstat
+* Description: This function is the system call fstat. It reports the length, type and inode
+*              of an open file. The terminal fds have no directory entry and fail.
+* Input: fd -- a file descriptor
+*        buf -- the user buffer, a stat_t
+* Output: None
+* Return value: -1 -- function fails
+*               0 -- function successes
+* Side effect: None
+*/
+int32_t fstat (int32_t fd, void* buf){
+    stat_t* st = (stat_t*)buf;
+    if (fd < FILE_MIN_NUM || fd > FILE_MAX_NUM) {
+        return -1;
+    }
+    if ((int32_t)buf < NUM_128MB || (int32_t)buf > NUM_132MB - (int32_t)sizeof(stat_t)) {
+        return -1;
+    }
+    fd_t* file = &get_curr_pcb()->fd_arr[fd];
+    if (file->flags == 0) {
+        return -1;
+    }
+    // the type follows from the operations open chose for the fd
+    if (file->file_operation_table == &file_operation) {
+        st->filetype = 2;
+        st->length = get_filelen(file->inode);
+    } else if (file->file_operation_table == &directory_operation) {
+        st->filetype = 1;
+        st->length = 0;
+    } else if (file->file_operation_table == &rtc_operation || file->file_operation_table == &serial_operation) {
+        st->filetype = 0;
+        st->length = 0;
+    } else if (file->file_operation_table == &proc_operation) {
+        st->filetype = PROC_FILETYPE;
+        st->length = 0;
+    } else {
+        return -1;
+    }
+    st->inode_num = file->inode;
+    return 0;
+}
+
+/* create
+* Description: This function is the system call create. It makes an empty regular file,
+*              which open and write then fill.
+* Input: filename -- the name of the new file
+* Output: None
+* Return value: -1 -- function fails
+*               0 -- function successes
+* Side effect: adds a directory entry
+*/
+int32_t create (const uint8_t* filename){
+    if (filename == NULL) {
+        return -1;
+    }
+    return file_create(filename);
+}
+
+/* truncate
+* Description: This function is the system call truncate. It sets the length of an open
+*              regular file, freeing blocks past the new end or adding zeroed ones. It
+*              fails rather than free a block some process still has mapped with mmap.
+* Input: fd -- a file descriptor opened on a regular file
+*        length -- the new length in bytes
+* Output: None
+* Return value: -1 -- function fails
+*               0 -- function successes
+* Side effect: None
+*/
+int32_t truncate (int32_t fd, int32_t length){
+    if (fd < FILE_MIN_NUM || fd > FILE_MAX_NUM || length < 0) {
+        return -1;
+    }
+    fd_t* file = &get_curr_pcb()->fd_arr[fd];
+    if (file->flags == 0 || file->file_operation_table != &file_operation) {
+        return -1;
+    }
+    return file_resize(file->inode, length);
+}
+
+/* fsync
+* Description: This function is the system call fsync. The boot block is shared by every
+*              file, so it writes back all changed blocks of the filesystem, not only the fd's.
+* Input: fd -- any open file descriptor
+* Output: None
+* Return value: -1 -- function fails
+*               0 -- function successes
+* Side effect: None
+*/
+int32_t fsync (int32_t fd){
+    if (fd < FILE_MIN_NUM || fd > FILE_MAX_NUM || get_curr_pcb()->fd_arr[fd].flags == 0) {
+        return -1;
+    }
+    return (fs_sync() == -1) ? -1 : 0;
+}
+
 /* set_handler (int32_t signum, void* handler_address)
 * Description: This function is the system call set_handler         
 * Input: signum, handler_address
@@ -342,8 +793,50 @@ int32_t sigreturn(void){
 
 
 
+/* process_init
+* Description: This function is used to size the process table at boot. Every pid owns a 4MB
+*              user page at 8MB + 4MB * pid, so the limit is what physical memory can hold,
+*              lowered further by a "maxpid=" boot option. Also fills the kernel stack pool.
+* Input: mem_upper -- KB of memory above 1MB reported by the boot loader, 0 if unknown
+*        requested -- limit asked for on the command line, 0 if none
+* Output: None
+* Return value: None
+* Side effect: sets max_pid_num
+*/
+void process_init(uint32_t mem_upper, uint32_t requested){
+    int32_t i;
+    uint32_t mem_top_mb = 1 + mem_upper / ONE_K;    // in MB, so large machines do not overflow
+    if(mem_upper == 0){
+        max_pid_num = DEFAULT_PID_NUM;
+    }else if(mem_top_mb < 12){                      // 8MB below the first user page plus one 4MB page
+        max_pid_num = 1;
+    }else{
+        max_pid_num = (mem_top_mb - 8) / 4;
+    }
+    if(requested > 0 && requested < max_pid_num){
+        max_pid_num = requested;
+    }
+    if(max_pid_num > MAX_PID_NUM){
+        max_pid_num = MAX_PID_NUM;
+    }
+    // pids past the limit are marked in use so get_pid never finds them
+    for(i = 0; i < PID_BITMAP_WORDS; i++){
+        pid_bitmap[i] = 0;
+    }
+    for(i = max_pid_num; i < MAX_PID_NUM; i++){
+        pid_bitmap[i >> 5] |= (1 << (i & 31));
+    }
+    // push the slots lowest address first, so the slot right below 8MB is handed out first
+    kstack_free_num = 0;
+    for(i = max_pid_num - 1; i >= 0; i--){
+        pcb_table[i] = NULL;
+        kstack_free_slot[kstack_free_num++] = i;
+    }
+}
+
 /* get_pid
-* Description: This function is a helper function which is used to get current pid.         
+* Description: This function is a helper function which is used to get an unused pid and a
+*              kernel stack for it. The pcb lives at the bottom of that stack.
 * Input: None
 * Output: None
 * Return value: -1 -- number of pid uses reach maximum
@@ -352,15 +845,51 @@ int32_t sigreturn(void){
 */
 int8_t get_pid (){
     int32_t i;
-    for(i = 0; i < MAX_PID_NUM; i++){
-        if(pid_count[i] == 0){  // indicator indicates pid not in-use
-            pid_count[i] = 1;   // set indicator to 1 for in-use 
-            return i;           // return value for current pid to use
+    int32_t pid;
+    uint32_t slot;
+    if(kstack_free_num == 0){   // every kernel stack is taken
+        return -1;
+    }
+    for(i = 0; i < PID_BITMAP_WORDS; i++){
+        if(pid_bitmap[i] != 0xFFFFFFFF){
+            // bsf on the inverted word finds the lowest free pid in one instruction
+            pid = (i << 5) + find_first_zero(pid_bitmap[i]);
+            pid_bitmap[i] |= (1 << (pid & 31));   // set indicator to 1 for in-use
+            slot = kstack_free_slot[--kstack_free_num];
+            pcb_table[pid] = (pcb_t*)(KSTACK_POOL_TOP - NUM_8KB * (slot + 1));
+            pcb_table[pid]->kstack_slot = slot;
+            return pid;         // return value for current pid to use
         }
     }
     return -1;                  // could not get pid to use then fails
 }
 
+/* pid_in_use
+* Description: This function is a helper function which checks the pid bitmap.
+* Input: pid -- pid to check
+* Output: None
+* Return value: 1 -- pid allocated, 0 -- pid free or out of range
+* Side effect: None
+*/
+int32_t pid_in_use(int32_t pid){
+    if(pid < 0 || pid >= max_pid_num){
+        return 0;
+    }
+    return (pid_bitmap[pid >> 5] >> (pid & 31)) & 1;
+}
+
+/* get_kstack_top
+* Description: This function is a helper function giving the first usable word of a
+*              process's kernel stack.
+* Input: pid -- process
+* Output: None
+* Return value: value for tss.esp0
+* Side effect: None
+*/
+uint32_t get_kstack_top(int8_t pid){
+    return (uint32_t)get_pcb(pid) + NUM_8KB - 4;    // -4 to avoid edge case
+}
+
 /* init_pcb
 * Description: This function is a helper function which is used to initialize pcb 
 *              when creating pcb.
@@ -371,7 +900,7 @@ int8_t get_pid (){
 * Side effect: Help for creating new pcb
 */
 void init_pcb(pcb_t* pcb, uint32_t pid){
-    uint8_t i;
+    uint32_t i;
     pcb -> pid = pid; // set current pid
     pcb -> parent_pid = -1;
     // initialize all of fd_t struct in pcb
@@ -379,6 +908,7 @@ void init_pcb(pcb_t* pcb, uint32_t pid){
         pcb -> fd_arr[i].file_operation_table = &null_operation;
         pcb -> fd_arr[i].inode = 0;
         pcb -> fd_arr[i].file_pos = 0;
+        pcb -> fd_arr[i].seq_pos = -1;
         pcb -> fd_arr[i].flags = 0;
     }
     // stdin
@@ -393,6 +923,22 @@ void init_pcb(pcb_t* pcb, uint32_t pid){
     pcb -> return_ebp = 0;
     pcb -> return_esp = 0;
     pcb -> active = 0;
+    pcb -> tid = 0;
+    pcb -> state = PROCESS_RUNNING;
+    pcb -> background = 0;
+    pcb -> first_run = 0;
+    pcb -> entry = 0;
+    pcb -> exit_status = 0;
+    pcb -> first_child = -1;
+    pcb -> next_sibling = -1;
+    pcb -> prev_sibling = -1;
+    pcb -> mmap_pages = 0;
+    pcb -> switches = 0;
+    pcb -> run_since = 0;
+    pcb -> ready_since = 0;
+    pcb -> run_cycles = 0;
+    pcb -> wait_cycles = 0;
+    pcb -> max_latency = 0;
     for(i=0;i<MAX_ARGUMENT_SIZE;i++){
         pcb->args[i] = '\0';
     }
@@ -406,10 +952,11 @@ void init_pcb(pcb_t* pcb, uint32_t pid){
 * Side effect: provide current pcb for other functions
 */
 pcb_t* get_pcb (uint8_t pid){
-    // each pcb starts at the top of a 8KB block inside the kernel
-    // shell be loaded at physical 8MB
-    pcb_t* pcb = (pcb_t*)(NUM_8MB - NUM_8KB * (pid + 1));
-    return pcb;
+    // each pcb starts at the bottom of the 8KB kernel stack slot handed out by get_pid
+    if(pid >= max_pid_num){
+        return NULL;
+    }
+    return pcb_table[pid];
 }
 
 
@@ -474,13 +1021,16 @@ int32_t parse_cmd (const uint8_t* command, uint8_t* fname, int8_t* arg){
 * Side effect: delete pid
 */
 int8_t del_pid(int8_t pid){
-    if(pid >= MAX_PID_NUM){ // check whether pid is larger than largest pid
+    if(pid >= max_pid_num){ // check whether pid is larger than largest pid
         return -1;
     }
-    if(pid < 0){ // check whether pid is smaller than 0
+    if(pid < 0 || pid_in_use(pid) == 0){ // check whether pid is smaller than 0 or already free
         return -1;
     } else{
-        pid_count[(uint8_t)pid] = 0; // clear pid
+        pid_bitmap[pid >> 5] &= ~(1 << (pid & 31)); // clear pid
+        unmap_files(pid);
+        kstack_free_slot[kstack_free_num++] = pcb_table[(uint8_t)pid]->kstack_slot;
+        pcb_table[(uint8_t)pid] = NULL;
     }
     return 0;
 }
@@ -493,5 +1043,141 @@ int8_t del_pid(int8_t pid){
 * Side effect: None
 */
 pcb_t* get_curr_pcb (){
-    return get_pcb(terminal[curr_terminal_running].curr_pid);
+    return get_pcb(curr_pid);
+}
+
+/* load_program
+* Description: This function is a helper function which checks an executable, grabs a pid,
+*              copies the program into that pid's user page and fills in its pcb.
+*              Used by execute and spawn.
+* Input: command -- a space-separated sequence of words needed to be execute
+*        entry -- filled with the program entry point
+* Output: None
+* Return value: -1 -- command could not be loaded
+*               pid of the new process -- successes
+* Side effect: the user page is left mapped to the new process
+*/
+int8_t load_program (const uint8_t* command, uint32_t* entry){
+    int32_t ret;
+    if(command == NULL){          
+        return -1;
+    }
+    //crete a buffer to store file name
+    uint8_t fname[10]; 
+    int8_t arg[MAX_ARGUMENT_SIZE];
+    ret = parse_cmd(command, fname, arg);
+    if(ret < 0){
+        return -1;
+    }
+
+    // Executable check
+    dentry_t dentry;
+    if(read_dentry_by_name(fname, &dentry) < 0 || dentry.filetype != 2){
+        return -1;                                      // only regular files hold programs
+    }
+    //check the magic number (0x7f;0x45;0x4c;0x46) specified in Appendix C
+    //create a buffer of size 4 to check the first 4 bytes of the file
+    uint8_t buf[4];
+    // fails to read bytes at the start of file 
+    if(read_data(dentry.inode_num, 0, buf, VALID_NBYTES) != SUCCESS_RETURN_NBYTES){
+        return -1;
+    }
+    // magic number is not present
+    if(buf[0] != 0x7f || buf[1] != 0x45 || buf[2] != 0x4c || buf[3] != 0x46){   
+        return -1;                                      
+    }
+    // fals to get the information of entry point into the program needed for executing program
+    if(read_data(dentry.inode_num, START_BYTE_ENTRY_POINT, buf, VALID_NBYTES) != SUCCESS_RETURN_NBYTES){
+        return -1;
+    }
+    *entry = *((uint32_t*)buf);
+    int8_t pid = get_pid();
+    if(pid < 0){
+        return -1;
+    }
+// Set up program paging
+    map_program(pid);
+    flush_tlb();
+// User-level Program Loader
+    uint32_t filelen_ = get_filelen(dentry.inode_num);
+    read_data(dentry.inode_num, 0, (uint8_t*)0x8048000, filelen_);
+// Create PCB
+    pcb_t* pcb = get_pcb(pid);
+    init_pcb(pcb, pid);
+    strcpy(pcb->args, arg);
+    strncpy(pcb->name, (int8_t*)fname, MAX_FNAME_NUM - 1);
+    pcb->name[MAX_FNAME_NUM - 1] = '\0';
+    profile_exec(pid);
+    pcb->tid = curr_terminal_running;
+    pcb->entry = *entry;
+    pcb->active = 1;
+    return pid;
+}
+
+/* orphan_children
+* Description: This function is a helper function used by halt. Zombie children of the halting
+*              process are freed, running ones lose their parent and free themselves on halt.
+* Input: pid -- the halting process
+* Output: None
+* Return value: None
+* Side effect: may free pids
+*/
+void orphan_children(int8_t pid){
+    int8_t i, next;
+    pcb_t* child;
+    for(i = get_pcb(pid)->first_child; i != -1; i = next){
+        child = get_pcb(i);
+        next = child->next_sibling;
+        child->next_sibling = -1;
+        child->prev_sibling = -1;
+        if(child->state == PROCESS_ZOMBIE){
+            del_pid(i);
+        }else{
+            child->parent_pid = -1;
+        }
+    }
+    get_pcb(pid)->first_child = -1;
+}
+
+/* link_child
+* Description: This function is a helper function used by spawn to push a background child
+*              onto its parent's child list.
+* Input: parent_pid -- the parent
+*        child_pid -- the new child
+* Output: None
+* Return value: None
+* Side effect: None
+*/
+void link_child(int8_t parent_pid, int8_t child_pid){
+    pcb_t* parent = get_pcb(parent_pid);
+    pcb_t* child = get_pcb(child_pid);
+    child->prev_sibling = -1;
+    child->next_sibling = parent->first_child;
+    if(parent->first_child != -1){
+        get_pcb(parent->first_child)->prev_sibling = child_pid;
+    }
+    parent->first_child = child_pid;
+}
+
+/* unlink_child
+* Description: This function is a helper function used by waitpid to drop a reaped child
+*              from its parent's child list.
+* Input: parent_pid -- the parent
+*        child_pid -- the child being reaped
+* Output: None
+* Return value: None
+* Side effect: None
+*/
+void unlink_child(int8_t parent_pid, int8_t child_pid){
+    pcb_t* child = get_pcb(child_pid);
+    if(child->prev_sibling != -1){
+        get_pcb(child->prev_sibling)->next_sibling = child->next_sibling;
+    }else{
+        get_pcb(parent_pid)->first_child = child->next_sibling;
+    }
+    if(child->next_sibling != -1){
+        get_pcb(child->next_sibling)->prev_sibling = child->prev_sibling;
+    }
+    child->next_sibling = -1;
+    child->prev_sibling = -1;
 }
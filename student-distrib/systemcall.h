@@ -12,7 +12,9 @@
 #define FILE_MAX_NUM 7
 #define STDIN_NUM 0
 #define STD_OUT_NUM 1
-#define MAX_PID_NUM 6
+#define MAX_PID_NUM 64          // ceiling of the process table, the boot limit is max_pid_num
+#define DEFAULT_PID_NUM 6       // limit used when the boot loader reports no memory size
+#define PID_BITMAP_WORDS (MAX_PID_NUM / 32)
 #define MAX_FNAME_NUM 10
 #define MAX_COMMAND_NUM 32
 #define VALID_NBYTES 4
@@ -22,6 +24,17 @@
 #define NUM_8KB 0x2000
 #define NUM_128MB  0x8000000
 #define NUM_132MB  0x8400000
+#define NUM_4MB 0x400000
+#define NUM_136MB  0x8800000    // start of the mmap region
+#define KSTACK_POOL_TOP NUM_8MB // kernel stacks are handed out in 8KB slots below 8MB
+#define WAIT_ANY_CHILD -1       // waitpid pid argument matching any background child
+#define WAIT_NOHANG 1           // waitpid option: return 0 instead of blocking
+#define MAX_IOV_NUM 16          // most iovec entries one readv/writev accepts
+
+// process states used by the scheduler
+#define PROCESS_RUNNING 0       // runnable, picked by the scheduler
+#define PROCESS_WAITING 1       // blocked in execute until its foreground child halts
+#define PROCESS_ZOMBIE  2       // halted background child, waiting to be reaped
 
 typedef struct file_operation_table{
     int32_t (*read) (int32_t fd, void* buf, int32_t nbytes);
@@ -30,11 +43,20 @@ typedef struct file_operation_table{
     int32_t (*close) (int32_t fd);
 }file_operation_table_t;
 
+// one buffer of a readv/writev vector
+typedef struct iovec{
+    void* base;             // start of the buffer
+    int32_t len;            // number of bytes in the buffer
+}iovec_t;
+
 typedef struct fd{
     file_operation_table_t* file_operation_table;
     int32_t inode;
-    int32_t file_pos;       // file position
+    int32_t file_pos;       // file position, or the next entry index for a directory
     int32_t flags;
+    int32_t seq_slot;       // page cache slot that held the block of seq_pos, checked on use
+    int32_t seq_pos;        // position the next sequential read starts at
+    uint32_t seq_reads;     // reads in a row that continued where the last one stopped
 }fd_t;
 
 typedef struct pcb{
@@ -47,8 +69,32 @@ typedef struct pcb{
     uint32_t return_esp;    // return esp for switching terminal
     int8_t args[MAX_ARGUMENT_SIZE];
     int active;           
+    uint8_t tid;            // terminal the process belongs to
+    uint8_t state;          // PROCESS_RUNNING, PROCESS_WAITING or PROCESS_ZOMBIE
+    uint8_t background;     // 1 if started by spawn, halt leaves a zombie for waitpid
+    uint8_t first_run;      // 1 until the scheduler enters user space for a spawned child
+    uint32_t entry;         // program entry point, used by the first run of a spawned child
+    int32_t exit_status;    // status passed to halt, collected by waitpid
+    uint32_t kstack_slot;   // kernel stack slot holding this pcb, set by get_pid and kept by init_pcb
+    int8_t first_child;     // head of the list of background children, -1 if none
+    int8_t next_sibling;    // next background child of the same parent, -1 at the end
+    int8_t prev_sibling;    // previous background child of the same parent, -1 at the head
+    uint32_t mmap_pages;    // pages of the mmap region already handed out
+    int8_t name[MAX_FNAME_NUM];     // file name of the program, shown by the profiler
+    uint32_t switches;      // times it was given the cpu
+    uint64_t run_since;     // time stamp counter when it was last given the cpu
+    uint64_t ready_since;   // when it last became runnable without the cpu, 0 while it runs or blocks
+    uint64_t run_cycles;    // cycles it held the cpu, up to its last switch out
+    uint64_t wait_cycles;   // cycles it was runnable but waited for the cpu
+    uint64_t max_latency;   // longest of those waits
 }pcb_t;
 
+// pid of the process currently owning the cpu, -1 before the first shell
+extern int8_t curr_pid;
+
+// number of pids usable after boot, at most MAX_PID_NUM
+extern int32_t max_pid_num;
+
 // assembly context switch
 void context_switch(uint32_t entry);
 
@@ -82,9 +128,54 @@ extern int32_t set_handler (int32_t signum, void* handler_address);
 // system call sigreturn
 extern int32_t sigreturn(void);
 
+// system call spawn, start a background child and return its pid
+extern int32_t spawn (const uint8_t* command);
+
+// system call waitpid, reap a halted background child
+extern int32_t waitpid (int32_t pid, int32_t* status, int32_t options);
+
+// system call null_call, does nothing, used to time system call entry
+extern int32_t null_call (void);
+
+// system call readv, read into several buffers with one kernel entry
+extern int32_t readv (int32_t fd, const iovec_t* iov, int32_t iovcnt);
+
+// system call writev, write several buffers with one kernel entry
+extern int32_t writev (int32_t fd, const iovec_t* iov, int32_t iovcnt);
+
+// system call mmap, map a whole file read-only into the caller's address space
+extern int32_t mmap (int32_t fd, uint8_t** start);
+
+// system call getdents, read several directory entries with their sizes
+extern int32_t getdents (int32_t fd, void* buf, int32_t nbytes);
+
+// system call stat, get the length, type and inode of a file by name
+extern int32_t stat (const uint8_t* filename, void* buf);
+
+// system call fstat, get the length, type and inode of an open file
+extern int32_t fstat (int32_t fd, void* buf);
+
+// system call create, make an empty regular file
+extern int32_t create (const uint8_t* filename);
+
+// system call truncate, set the length of an open file
+extern int32_t truncate (int32_t fd, int32_t length);
+
+// system call fsync, write the changed blocks of the filesystem back
+extern int32_t fsync (int32_t fd);
+
+// set the process limit from the boot loader's memory size and command line
+void process_init(uint32_t mem_upper, uint32_t requested);
+
 // get available pid
 int8_t get_pid ();
 
+// check whether a pid is allocated
+int32_t pid_in_use(int32_t pid);
+
+// top of the kernel stack of a process, loaded into tss.esp0
+uint32_t get_kstack_top(int8_t pid);
+
 // initialize the pcb for a process
 void init_pcb(pcb_t* pcb, uint32_t pid);
 
@@ -100,5 +191,17 @@ int8_t del_pid(int8_t pid);
 // get the current running process pid
 pcb_t* get_curr_pcb ();
 
+// load a program into a fresh pid, shared by execute and spawn
+int8_t load_program (const uint8_t* command, uint32_t* entry);
+
+// hand the children of a halting process to nobody, freeing the zombies
+void orphan_children(int8_t pid);
+
+// add a background child to the head of its parent's child list
+void link_child(int8_t parent_pid, int8_t child_pid);
+
+// remove a background child from its parent's child list
+void unlink_child(int8_t parent_pid, int8_t child_pid);
+
 #endif /* _SYSTEMCALL_H */
 
@@ -1,5 +1,8 @@
 #include "terminal.h"
 #include "lib.h"
+#include "trace.h"
+#include "serial.h"
+#include "smp.h"
 
 /* terminal_open
 * Description: This function is used to provide access to the file system. 
@@ -34,17 +37,23 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes){
         return -1;
     }                                      
    
+    if(terminal[curr_terminal_running].curr_pid != curr_pid){   // background jobs do not own the keyboard
+        return -1;
+    }
     char *output = (char*) buf;                            // change the buffer to a char buffer
-    while(enter_indict[curr_terminal_running] == 0);
-    cli();
+    uint32_t flags;
+    uint8_t tid = curr_terminal_running;
+    smp_unlock();                                          // the keyboard interrupt takes the kernel lock
+    while(enter_indict[tid] == 0);
+    smp_lock();
+    cli_and_save(flags);
     for(i = 0; i <= terminal[curr_terminal_running].kb_idx && i< nbytes; i++){
         output[i] = terminal[curr_terminal_running].kbbuf[i];
         terminal[curr_terminal_running].kbbuf[i] = '\0';
     }
     terminal[curr_terminal_running].kb_idx = 0;
-    sti();
     enter_indict[curr_terminal_running] = 0;               // clear the enter indicator
-    cli();
+    restore_flags(flags);
     return i;
 }
 
@@ -60,19 +69,25 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes){
 * Side effect: None
 */
 int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes){
-    cli();                                                  // block other interrupt
-
+    uint32_t flags;
     if(buf == NULL){                                        // check for valid input
         return -1;
     }
 
+    cli_and_save(flags);                                    // block other interrupt
+
     char *output = (char*)buf;                              // change the buffer to a char buffer
 
     int i = 0;                                              // i is the loop counter
+    hold_cursor();                                          // move the cursor once for the whole buffer
     for(; i < nbytes; i++){                                 // put the contents in buf to screen
         putc_to_terminal(output[i]);
+        if(serial_mirror >= SERIAL_MIRROR_TERMINAL){
+            serial_console_putc(output[i]);
+        }
     }
-    sti();                                                  // enable other interrupt
+    release_cursor();
+    restore_flags(flags);                                   // enable other interrupt
     return nbytes;
 }
 
@@ -181,27 +196,40 @@ int32_t switch_terminal(uint8_t old_tid, uint8_t new_tid){
 * Side effect: None
 */
 int32_t start_terminal(uint8_t tid){
-    cli();
+    uint32_t flags;
     int ret;
+    cli_and_save(flags);
+    TRACE(TRACE_TERMINAL, tid);
     // sanity check
     if(tid > 2){
+        restore_flags(flags);
         return -1;
     }
     // if we are switching to the current display terminal, just return
     if(tid == display_terminal){
+        restore_flags(flags);
         return 0;
     }
 	ret = switch_terminal(display_terminal, tid);
     if(ret != 0){
+        restore_flags(flags);
         return -1;
     }
     // no need to launch shell, just remap video memory
     if(terminal[tid].active == 1){
         vidmap_paging();
+        restore_flags(flags);
 	    return 0;
+    }else if(smp_terminal_cpu(tid) != smp_cpu_index()){
+    // another processor serves the terminal and starts its shell; the process
+    // here is no longer on display
+        smp_launch(tid);
+        vidmap_paging();
+        restore_flags(flags);
+        return 0;
     }else{
     // launch shell and save return esp and ebp
-        pcb_t* old_pcb = get_pcb(terminal[curr_terminal_running].curr_pid);        
+        pcb_t* old_pcb = get_curr_pcb();        
         asm volatile(
                  "movl %%esp, %0        \n"
                  "movl %%ebp, %1        \n"
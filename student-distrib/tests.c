@@ -2,6 +2,8 @@
 #include "x86_desc.h"
 #include "lib.h"
 #include "FileSystem.h"
+#include "pagecache.h"
+#include "blk.h"
 #include "rtc.h"
 #include "keyboard.h"
 #define PASS 1
@@ -152,7 +154,7 @@ void filesystem_directory_open_test(){
 		printf("error");
 		return;
 	}
-    printf("directory name: %s\n", curdirectory.filename);
+    printf("directory opened\n");
 }
 
 /* ls_all_directories
@@ -164,14 +166,13 @@ void filesystem_directory_open_test(){
 */
 void ls_all_directories(){
 	clear_helper();
-	int i,fd;
-	cur_directory_read_idx =0;
+	int i;
+	dentry_t dentry;
 	for(i=0;i<bootblock_ptr->num_dir_entries;i++){
-		//directory_read(fd, test_buf, 32);     //the filename is 32 bytes
-		directory_read(fd, test_buf, 112);    //if passed in value more than 32 bytes, we still only copy 32 bytes
-		uint32_t cur_dir_inode = curdirectory.inode_num;
+		read_dentry_by_index(i, &dentry);     //directory_read needs a process fd, so walk the entries directly
+		uint32_t cur_dir_inode = dentry.inode_num;
 		inode_t* inode_ptr = (inode_t*)((void*)bootblock_ptr + BLOCK_SIZE) + cur_dir_inode;
-		printf("filename: %s, filetype: %d, size: %d\n",curdirectory.filename,curdirectory.filetype,inode_ptr->length);
+		printf("filename: %s, filetype: %d, size: %d\n",dentry.filename,dentry.filetype,inode_ptr->length);
 	}
 }
 
@@ -197,6 +198,429 @@ void file_read_wholefile_test(){
 	}while(bytes_read == byte_chunk);
 }
 
+/* Extent cache benchmark */
+#define BENCH_SHIFT 10          // cycles are reported in units of 1024
+uint8_t bench_buf[40960];      // holds the largest file, fish is 36164 bytes
+
+/* read_data_bench_file
+* Description: This function reads a file with read_data in chunks of 1 byte, 4KB and the
+*              whole file, and prints the bytes copied per 1024 cycles for each chunk size.
+* Input: fname -- the file to read
+* Output: one line per chunk size
+* Return value: None
+* Side effect: overwrites bench_buf
+*/
+void read_data_bench_file(const uint8_t* fname){
+	dentry_t dentry;
+	uint32_t chunks[3];
+	uint32_t len, offset, i, kcycles;
+	int32_t cnt;
+	uint64_t t0;
+	if(read_dentry_by_name(fname, &dentry) == -1){
+		printf("%s: not found\n", fname);
+		return;
+	}
+	len = get_filelen(dentry.inode_num);
+	if(len > sizeof(bench_buf)){
+		printf("%s: too large\n", fname);
+		return;
+	}
+	chunks[0] = 1;
+	chunks[1] = BLOCK_SIZE;
+	chunks[2] = len;
+	for(i = 0; i < 3; i++){
+		t0 = rdtsc();
+		for(offset = 0; offset < len; offset += cnt){
+			cnt = read_data(dentry.inode_num, offset, bench_buf + offset, chunks[i]);
+			if(cnt <= 0){
+				break;
+			}
+		}
+		kcycles = (uint32_t)((rdtsc() - t0) >> BENCH_SHIFT);
+		if(kcycles == 0){
+			kcycles = 1;
+		}
+		printf("%s chunk %d: %d bytes, %d bytes per kcycle\n", fname, chunks[i], offset, offset / kcycles);
+	}
+}
+
+/* read_data_bench
+* Description: This function runs the read_data benchmark over a text file and a binary.
+* Input: None
+* Output: bytes per 1024 cycles for each file and chunk size
+* Return value: None
+* Side effect: None
+*/
+void read_data_bench(){
+	clear_helper();
+	read_data_bench_file((uint8_t*)"verylargetextwithverylongname.txt");
+	read_data_bench_file((uint8_t*)"fish");
+	printf("page cache: %d hits, %d misses, %d read ahead\n", pcache_hits, pcache_misses, pcache_readaheads);
+	printf("disk: %d requests, %d commands, %d merged\n", blk_requests, blk_commands, blk_merges);
+}
+
+/* blk_merge_test
+* Description: This function queues the boot block and the first inode as two requests and
+*              checks that they come back as one drive command holding what the filesystem
+*              read at boot. Only meaningful when the filesystem is on disk.
+* Input: None
+* Output: PASS/FAIL
+* Return value: PASS/FAIL
+* Side effect: overwrites bench_buf
+*/
+int blk_merge_test(){
+	TEST_HEADER;
+	blk_request_t req[2];
+	uint32_t i, commands = blk_commands;
+	if(blk_sectors() == 0 || datablock_base != NULL){
+		return FAIL;
+	}
+	for(i = 0; i < 2; i++){
+		req[1 - i].sector = (1 - i) * BLK_SECTORS_PER_BLOCK;	// queued out of order on purpose
+		req[1 - i].count = BLK_SECTORS_PER_BLOCK;
+		req[1 - i].buf = bench_buf + (1 - i) * BLOCK_SIZE;
+		req[1 - i].dir = BLK_READ;
+		if(blk_submit(&req[1 - i]) == -1){
+			return FAIL;
+		}
+	}
+	blk_run();
+	if(req[0].status != BLK_DONE || req[1].status != BLK_DONE || blk_commands != commands + 1){
+		return FAIL;
+	}
+	for(i = 0; i < 2 * BLOCK_SIZE; i++){
+		if(bench_buf[i] != ((uint8_t*)bootblock_ptr)[i]){
+			return FAIL;
+		}
+	}
+	return PASS;
+}
+
+/* Filesystem write tests */
+#define FS_TEST_LEN 10000		// three blocks, the last one partly used
+
+/* fs_test_file
+* Description: This function creates an empty regular file for a test, or empties the one
+*              an earlier run left behind on a disk image.
+* Input: fname -- the file name
+* Output: None
+* Return value: the inode of the file, -1 if it could not be created
+* Side effect: adds a directory entry the first time
+*/
+static int32_t fs_test_file(const uint8_t* fname){
+	dentry_t dentry;
+	if(read_dentry_by_name(fname, &dentry) == 0){
+		return (file_resize(dentry.inode_num, 0) == 0) ? (int32_t)dentry.inode_num : -1;
+	}
+	if(file_create(fname) != 0 || read_dentry_by_name(fname, &dentry) != 0){
+		return -1;
+	}
+	return dentry.inode_num;
+}
+
+/* fs_test_fill
+* Description: This function fills bench_buf with a pattern that differs from block to block.
+* Input: len -- bytes to fill
+* Output: None
+* Return value: None
+* Side effect: overwrites bench_buf
+*/
+static void fs_test_fill(uint32_t len){
+	uint32_t i;
+	for(i = 0; i < len; i++){
+		bench_buf[i] = (uint8_t)(i * 7 + i / BLOCK_SIZE + 1);
+	}
+}
+
+/* fs_test_check
+* Description: This function reads a range of a file back and compares it with bench_buf,
+*              or with zeros.
+* Input: inode, offset, len -- the range, zeros -- 1 to expect zeros instead of bench_buf
+* Output: None
+* Return value: PASS if read_data returns the whole range and it matches, FAIL otherwise
+* Side effect: overwrites test_buf
+*/
+static int fs_test_check(uint32_t inode, uint32_t offset, uint32_t len, int zeros){
+	uint32_t i;
+	if(len > sizeof(test_buf) || read_data(inode, offset, test_buf, len) != (int32_t)len){
+		return FAIL;
+	}
+	for(i = 0; i < len; i++){
+		if(test_buf[i] != (zeros ? 0 : bench_buf[offset + i])){
+			return FAIL;
+		}
+	}
+	return PASS;
+}
+
+/* file_create_test
+* Description: This function creates a file and checks that it is empty, that its name is
+*              taken and that a read at offset 0 is the end of the file.
+* Input: None
+* Output: PASS/FAIL
+* Return value: PASS/FAIL
+* Side effect: adds a file to the filesystem
+*/
+int file_create_test(){
+	TEST_HEADER;
+	dentry_t dentry;
+	int32_t inode = fs_test_file((uint8_t*)"fs_test_create");
+	if(inode == -1 || file_create((uint8_t*)"fs_test_create") != -1){
+		return FAIL;	// a second create of the same name must fail
+	}
+	if(read_dentry_by_name((uint8_t*)"fs_test_create", &dentry) != 0 || dentry.filetype != 2){
+		return FAIL;
+	}
+	if(get_filelen(inode) != 0 || read_data(inode, 0, test_buf, 1) != 0){
+		return FAIL;
+	}
+	return (file_create((uint8_t*)"") == -1) ? PASS : FAIL;
+}
+
+/* file_write_test
+* Description: This function writes three blocks, overwrites bytes across a block boundary
+*              and writes past the end, checking the file after each step.
+* Input: None
+* Output: PASS/FAIL
+* Return value: PASS/FAIL
+* Side effect: adds a file to the filesystem, overwrites bench_buf and test_buf
+*/
+int file_write_test(){
+	TEST_HEADER;
+	uint32_t i;
+	int32_t inode = fs_test_file((uint8_t*)"fs_test_write");
+	if(inode == -1){
+		return FAIL;
+	}
+	fs_test_fill(FS_TEST_LEN);
+	if(write_data(inode, 0, bench_buf, FS_TEST_LEN) != FS_TEST_LEN || get_filelen(inode) != FS_TEST_LEN){
+		return FAIL;
+	}
+	if(fs_test_check(inode, 0, FS_TEST_LEN, 0) == FAIL || read_data(inode, FS_TEST_LEN, test_buf, 1) != 0){
+		return FAIL;
+	}
+	// across the boundary of the first two blocks
+	for(i = BLOCK_SIZE - 50; i < BLOCK_SIZE + 50; i++){
+		bench_buf[i] = 0xAA;
+	}
+	if(write_data(inode, BLOCK_SIZE - 50, bench_buf + BLOCK_SIZE - 50, 100) != 100){
+		return FAIL;
+	}
+	if(fs_test_check(inode, 0, FS_TEST_LEN, 0) == FAIL || get_filelen(inode) != FS_TEST_LEN){
+		return FAIL;
+	}
+	// past the end, the gap reads as zeros
+	if(write_data(inode, FS_TEST_LEN + 5000, bench_buf, 10) != 10 || get_filelen(inode) != FS_TEST_LEN + 5010){
+		return FAIL;
+	}
+	if(fs_test_check(inode, FS_TEST_LEN, 5000, 1) == FAIL){
+		return FAIL;
+	}
+	return (read_data(inode, FS_TEST_LEN + 5000, test_buf, 100) == 10 && test_buf[9] == bench_buf[9]) ? PASS : FAIL;
+}
+
+/* file_resize_test
+* Description: This function shrinks and grows a file, checking its bytes and the free map,
+*              and checks that a block mapped with mmap is not freed.
+* Input: None
+* Output: PASS/FAIL
+* Return value: PASS/FAIL
+* Side effect: adds a file to the filesystem, overwrites bench_buf and test_buf
+*/
+int file_resize_test(){
+	TEST_HEADER;
+	uint32_t free_blocks;
+	uint8_t* block;
+	int32_t inode = fs_test_file((uint8_t*)"fs_test_resize");
+	if(inode == -1){
+		return FAIL;
+	}
+	free_blocks = fs_free_blocks();
+	fs_test_fill(FS_TEST_LEN);
+	if(write_data(inode, 0, bench_buf, FS_TEST_LEN) != FS_TEST_LEN || fs_free_blocks() != free_blocks - 3){
+		return FAIL;
+	}
+	if(file_resize(inode, 5000) != 0 || get_filelen(inode) != 5000 || fs_free_blocks() != free_blocks - 2){
+		return FAIL;
+	}
+	if(fs_test_check(inode, 0, 5000, 0) == FAIL || read_data(inode, 0, test_buf, FS_TEST_LEN) != 5000){
+		return FAIL;
+	}
+	// the bytes cut off come back as zeros
+	if(file_resize(inode, 9000) != 0 || fs_test_check(inode, 5000, 4000, 1) == FAIL || fs_test_check(inode, 0, 5000, 0) == FAIL){
+		return FAIL;
+	}
+	if(datablock_base != NULL){
+		// a mapped block must outlive the shrink that would free it
+		block = get_datablock(inode, 2);
+		if(block == NULL || fs_map_block(block) != 0){
+			return FAIL;
+		}
+		if(file_resize(inode, 0) != -1 || get_filelen(inode) != 9000){
+			fs_unmap_block(block);
+			return FAIL;
+		}
+		fs_unmap_block(block);
+	}
+	if(file_resize(inode, 0) != 0 || fs_free_blocks() != free_blocks){
+		return FAIL;
+	}
+	return (read_data(inode, 0, test_buf, 1) == 0) ? PASS : FAIL;
+}
+
+/* fs_sync_test
+* Description: This function writes a file and checks that fs_sync writes the changed blocks
+*              back once, and that the file reads the same afterwards.
+* Input: None
+* Output: PASS/FAIL
+* Return value: PASS/FAIL
+* Side effect: adds a file to the filesystem, writes the image back
+*/
+int fs_sync_test(){
+	TEST_HEADER;
+	int32_t inode = fs_test_file((uint8_t*)"fs_test_sync");
+	if(inode == -1){
+		return FAIL;
+	}
+	fs_test_fill(FS_TEST_LEN);
+	if(write_data(inode, 0, bench_buf, FS_TEST_LEN) != FS_TEST_LEN){
+		return FAIL;
+	}
+	// at least the inode and the three data blocks changed
+	if(fs_sync() < 4 || fs_sync() != 0){
+		return FAIL;
+	}
+	return fs_test_check(inode, 0, FS_TEST_LEN, 0);
+}
+
+/* indirect_block_test
+* Description: This function grows a file into the double indirect range, stamps blocks at
+*              the edges of each range, then shrinks it back in steps, checking the stamps,
+*              the end of the file and the free map each time. Only meaningful with the
+*              version 2 format and room for about 8MB more, so on a disk image.
+* Input: None
+* Output: PASS/FAIL
+* Return value: PASS/FAIL
+* Side effect: adds a file to the filesystem, overwrites test_buf
+*/
+#define FS_TEST_BIG (FS_DIRECT_V2 + FS_PTRS_PER_BLOCK + 2)	// blocks, two of them under the double indirect block
+int indirect_block_test(){
+	TEST_HEADER;
+	uint32_t stamps[] = {0, FS_DIRECT_V2 - 1, FS_DIRECT_V2, FS_DIRECT_V2 + FS_PTRS_PER_BLOCK - 1,
+						 FS_DIRECT_V2 + FS_PTRS_PER_BLOCK, FS_TEST_BIG - 1};
+	uint32_t sizes[] = {FS_DIRECT_V2 + 5, FS_DIRECT_V2, FS_DIRECT_V2 - 1, 0};
+	// blocks besides the data a file of each size holds: indirect, double indirect and one table under it
+	uint32_t extra[] = {1, 0, 0, 0};
+	uint32_t free_blocks, i, j, value;
+	int32_t inode = fs_test_file((uint8_t*)"fs_test_big");
+	if(inode == -1 || fs_max_file_blocks() < FS_TEST_BIG){
+		return FAIL;
+	}
+	free_blocks = fs_free_blocks();
+	if(free_blocks < FS_TEST_BIG + 3 || file_resize(inode, FS_TEST_BIG * BLOCK_SIZE) != 0){
+		return FAIL;
+	}
+	if(fs_free_blocks() != free_blocks - FS_TEST_BIG - 3){
+		return FAIL;
+	}
+	for(i = 0; i < sizeof(stamps) / sizeof(stamps[0]); i++){
+		if(write_data(inode, stamps[i] * BLOCK_SIZE + 100, (uint8_t*)&stamps[i], 4) != 4){
+			return FAIL;
+		}
+	}
+	for(j = 0; j < sizeof(sizes) / sizeof(sizes[0]); j++){
+		if(file_resize(inode, sizes[j] * BLOCK_SIZE) != 0 || get_filelen(inode) != sizes[j] * BLOCK_SIZE){
+			return FAIL;
+		}
+		if(fs_free_blocks() != free_blocks - sizes[j] - extra[j] || read_data(inode, sizes[j] * BLOCK_SIZE, test_buf, 1) != 0){
+			return FAIL;
+		}
+		for(i = 0; i < sizeof(stamps) / sizeof(stamps[0]) && stamps[i] < sizes[j]; i++){
+			if(fs_test_check(inode, stamps[i] * BLOCK_SIZE, 100, 1) == FAIL){
+				return FAIL;	// the bytes before the stamp were never written
+			}
+			if(read_data(inode, stamps[i] * BLOCK_SIZE + 100, (uint8_t*)&value, 4) != 4 || value != stamps[i]){
+				return FAIL;
+			}
+		}
+	}
+	return PASS;
+}
+
+/* fs_test_dir_blocks
+* Description: This function counts the directory blocks chained after the boot block.
+* Input: entries -- number of directory entries
+* Output: None
+* Return value: the number of chained blocks holding them
+* Side effect: None
+*/
+static uint32_t fs_test_dir_blocks(uint32_t entries){
+	if(entries <= dir_entries_num_bootlock){
+		return 0;
+	}
+	return (entries - dir_entries_num_bootlock + dir_entries_num_bootlock - 1) / dir_entries_num_bootlock;
+}
+
+/* dir_chain_test
+* Description: This function creates files until the directory holds more entries than the
+*              boot block, writes each its index, and finds and reads every one back by name.
+*              It then empties them, checking the free map after each step. Only meaningful
+*              with the version 2 format.
+* Input: None
+* Output: PASS/FAIL
+* Return value: PASS/FAIL
+* Side effect: adds files to the filesystem, overwrites test_buf
+*/
+#define FS_TEST_DIR_PAST 3		// entries past the boot block to reach
+int dir_chain_test(){
+	TEST_HEADER;
+	uint8_t fname[filename_len + 1] = "fs_test_dir00";
+	dentry_t dentry;
+	uint32_t free_blocks, entries, count, i;
+	int32_t inode;
+	entries = bootblock_ptr->num_dir_entries;
+	free_blocks = fs_free_blocks();
+	count = (entries < dir_entries_num_bootlock + FS_TEST_DIR_PAST) ? dir_entries_num_bootlock + FS_TEST_DIR_PAST - entries : FS_TEST_DIR_PAST;
+	if(count > 100 || fs_max_file_blocks() == inode_maxnum_datablock){
+		return FAIL;
+	}
+	for(i = 0; i < count; i++){
+		fname[11] = '0' + i / 10;
+		fname[12] = '0' + i % 10;
+		if((inode = fs_test_file(fname)) == -1 || write_data(inode, 0, (uint8_t*)&i, 4) != 4){
+			return FAIL;
+		}
+	}
+	if(bootblock_ptr->num_dir_entries <= dir_entries_num_bootlock){
+		return FAIL;
+	}
+	// one block per file, and the chained directory blocks that were added
+	if(fs_free_blocks() != free_blocks - count - (fs_test_dir_blocks(bootblock_ptr->num_dir_entries) - fs_test_dir_blocks(entries))){
+		return FAIL;
+	}
+	for(i = 0; i < count; i++){
+		fname[11] = '0' + i / 10;
+		fname[12] = '0' + i % 10;
+		if(read_dentry_by_name(fname, &dentry) != 0 || dentry.filetype != 2){
+			return FAIL;
+		}
+		if(read_data(dentry.inode_num, 0, test_buf, 8) != 4 || *(uint32_t*)test_buf != i){
+			return FAIL;
+		}
+	}
+	if(read_dentry_by_index(bootblock_ptr->num_dir_entries - 1, &dentry) != 0 || read_dentry_by_index(bootblock_ptr->num_dir_entries, &dentry) != -1){
+		return FAIL;
+	}
+	for(i = 0; i < count; i++){
+		fname[11] = '0' + i / 10;
+		fname[12] = '0' + i % 10;
+		if(read_dentry_by_name(fname, &dentry) != 0 || file_resize(dentry.inode_num, 0) != 0){
+			return FAIL;
+		}
+	}
+	return (fs_free_blocks() == free_blocks - (fs_test_dir_blocks(bootblock_ptr->num_dir_entries) - fs_test_dir_blocks(entries))) ? PASS : FAIL;
+}
+
 /* putc_test
 * Description: This function is used to test the putc_modified function
 * Input: None
@@ -408,6 +832,14 @@ void launch_tests(){
 	//ls_all_directories();
 	//filesystem_directory_open_test();
 	file_read_wholefile_test();
+	//read_data_bench();
+	//TEST_OUTPUT("blk_merge_test", blk_merge_test());
+	TEST_OUTPUT("file_create_test", file_create_test());
+	TEST_OUTPUT("file_write_test", file_write_test());
+	TEST_OUTPUT("file_resize_test", file_resize_test());
+	TEST_OUTPUT("fs_sync_test", fs_sync_test());
+	//TEST_OUTPUT("indirect_block_test", indirect_block_test());
+	//TEST_OUTPUT("dir_chain_test", dir_chain_test());
 
 	//fish_gif();
 
@@ -0,0 +1,144 @@
+#include "trace.h"
+#include "lib.h"
+#include "serial.h"
+#include "systemcall.h"
+
+#ifdef TRACE_ENABLE
+
+uint32_t trace_on = 1;
+trace_ring_t trace_rings[TRACE_NUM_CPUS];
+
+/* 
+ *trace_event
+ * DESCRIPTION: append an event to the ring of this cpu. Only this cpu writes its ring,
+ *              and an interrupt taken half way through appends its own record in the
+ *              next slot, so a single xadd reserves the slot without a lock. The type
+ *              is stored last, a dump skips a slot whose record is still being written.
+ * INPUTS: type -- TRACE_SWITCH to TRACE_TERMINAL
+ *         arg -- what the event is about, see trace.h
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: overwrites the oldest record once the ring is full
+ */
+void trace_event(uint32_t type, uint32_t arg){
+    trace_ring_t* ring = &trace_rings[trace_cpu()];
+    trace_record_t* rec;
+    uint32_t slot = 1;
+    uint64_t tsc;
+    if(!trace_on){
+        return;
+    }
+    tsc = rdtsc();          // before the slot, so slot order and time order agree
+    asm volatile ("xaddl %0, %1" : "+r"(slot), "+m"(ring->head) : : "memory");
+    rec = &ring->rec[slot & (TRACE_RING_SIZE - 1)];
+    rec->type = TRACE_NONE;
+    asm volatile ("" : : : "memory");
+    rec->tsc_lo = (uint32_t)tsc;
+    rec->tsc_hi = (uint32_t)(tsc >> 32);
+    rec->pid = curr_pid;
+    rec->arg = arg;
+    asm volatile ("" : : : "memory");
+    rec->type = type;
+}
+
+/* 
+ *trace_put_hex
+ * DESCRIPTION: write a number in hexadecimal with leading zeros
+ * INPUTS: buf -- where to write, digits bytes
+ *         value -- the number
+ *         digits -- how many digits
+ * OUTPUTS:None
+ * RETURN VALUE: the byte after the last digit
+ * SIDE EFFECTS: None
+ */
+static int8_t* trace_put_hex(int8_t* buf, uint32_t value, uint32_t digits){
+    int32_t i;
+    for(i = digits - 1; i >= 0; i--){
+        buf[i] = "0123456789abcdef"[value & 0xF];
+        value >>= 4;
+    }
+    return buf + digits;
+}
+
+/* 
+ *trace_dump
+ * DESCRIPTION: send every ring on COM1, oldest record first, as text lines between
+ *              "TRACE BEGIN" and "TRACE END" so the dump can be cut out of whatever else
+ *              the port carries. Each record is a line
+ *                  E <cpu> <tsc, 16 hex digits> <type> <pid> <arg, 8 hex digits>
+ *              and each ring starts with "TRACE CPU <cpu> <records ever made>", which
+ *              tells how many were overwritten. tracedecode.py turns it into a timeline.
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: recording stops while the dump is sent, it takes seconds at 115200 baud
+ *               and interrupts stay as the caller left them
+ */
+void trace_dump(){
+    uint32_t cpu, i, first, head, saved_on = trace_on;
+    trace_record_t* rec;
+    int8_t line[48];
+    int8_t* p;
+    trace_on = 0;
+    serial_puts("TRACE BEGIN ");
+    serial_puts(itoa(TRACE_NUM_CPUS, line, 10));
+    serial_puts("\n");
+    for(cpu = 0; cpu < TRACE_NUM_CPUS; cpu++){
+        head = trace_rings[cpu].head;
+        serial_puts("TRACE CPU ");
+        serial_puts(itoa(cpu, line, 10));
+        serial_puts(" ");
+        serial_puts(itoa(head, line, 10));
+        serial_puts("\n");
+        first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        for(i = first; i != head; i++){
+            rec = &trace_rings[cpu].rec[i & (TRACE_RING_SIZE - 1)];
+            if(rec->type == TRACE_NONE){
+                continue;
+            }
+            p = line;
+            *p++ = 'E';
+            *p++ = ' ';
+            itoa(cpu, p, 10);
+            p += strlen(p);
+            *p++ = ' ';
+            p = trace_put_hex(p, rec->tsc_hi, 8);
+            p = trace_put_hex(p, rec->tsc_lo, 8);
+            *p++ = ' ';
+            itoa(rec->type, p, 10);
+            p += strlen(p);
+            *p++ = ' ';
+            if(rec->pid < 0){
+                *p++ = '-';
+                itoa(-rec->pid, p, 10);
+            }else{
+                itoa(rec->pid, p, 10);
+            }
+            p += strlen(p);
+            *p++ = ' ';
+            p = trace_put_hex(p, rec->arg, 8);
+            *p++ = '\n';
+            *p = '\0';
+            serial_puts(line);
+        }
+    }
+    serial_puts("TRACE END\n");
+    trace_on = saved_on;
+}
+
+/* 
+ *trace_clear
+ * DESCRIPTION: forget every recorded event
+ * INPUTS: None
+ * OUTPUTS:None
+ * RETURN VALUE: None
+ * SIDE EFFECTS: empties every ring
+ */
+void trace_clear(){
+    uint32_t flags;
+    cli_and_save(flags);
+    memset(trace_rings, 0, sizeof(trace_rings));
+    restore_flags(flags);
+}
+
+#endif /* TRACE_ENABLE */
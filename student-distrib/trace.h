@@ -0,0 +1,69 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "types.h"
+
+/*
+Kernel event trace. Every cpu appends fixed size records to its own ring, the
+oldest ones are overwritten. Remove TRACE_ENABLE to compile every TRACE point
+away, arguments included.
+*/
+#define TRACE_ENABLE
+
+#define TRACE_NUM_CPUS      1           // rings, one per cpu
+#define TRACE_RING_SIZE     4096        // records per ring, a power of 2
+
+// event types, the pid of a record is the process running when it was made
+#define TRACE_NONE          0           // slot being written
+#define TRACE_SWITCH        1           // scheduler switch, arg: next pid
+#define TRACE_EXECUTE       2           // execute or spawn loaded a program, arg: its pid
+#define TRACE_HALT          3           // arg: halt status
+#define TRACE_IRQ           4           // device interrupt, arg: irq number
+#define TRACE_EXCEPTION     5           // arg: vector
+#define TRACE_PAGE_FAULT    6           // arg: faulting address
+#define TRACE_TERMINAL      7           // terminal switch, arg: new terminal
+#define TRACE_TYPE_NUM      8
+
+// one event, 16 bytes
+typedef struct trace_record{
+    uint32_t tsc_lo;        // time stamp counter when the event happened
+    uint32_t tsc_hi;
+    uint8_t type;           // written last, TRACE_NONE until the rest is valid
+    int8_t pid;
+    uint16_t reserved;
+    uint32_t arg;
+}trace_record_t;
+
+typedef struct trace_ring{
+    uint32_t head;          // records ever reserved, the next one goes to head % TRACE_RING_SIZE
+    trace_record_t rec[TRACE_RING_SIZE];
+}trace_ring_t;
+
+#ifdef TRACE_ENABLE
+#define TRACE(type, arg)    trace_event((type), (uint32_t)(arg))
+#define TRACE_DUMP()        trace_dump()
+#else
+#define TRACE(type, arg)    do{}while(0)
+#define TRACE_DUMP()        do{}while(0)
+#endif
+
+// 1 while events are recorded, set from the trace= boot option
+extern uint32_t trace_on;
+
+extern trace_ring_t trace_rings[TRACE_NUM_CPUS];
+
+// cpu the caller runs on, the ring it writes
+static inline uint32_t trace_cpu(void) {
+    return 0;
+}
+
+// append an event to the ring of this cpu
+void trace_event(uint32_t type, uint32_t arg);
+
+// send every ring on COM1
+void trace_dump();
+
+// forget every recorded event
+void trace_clear();
+
+#endif /* _TRACE_H */
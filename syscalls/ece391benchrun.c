@@ -0,0 +1,140 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 4096        /* the results file of one run */
+#define NAME_COL 20         /* width of the benchmark column */
+#define VALUE_COL 12        /* width of the value column */
+
+/*
+ * benchrun           run every benchmark program in turn and show their
+ *                    headline figures in one table, to compare kernel builds
+ * benchrun <prog>... run only the named programs
+ *
+ * The programs append their figures to ECE391_BENCH_FILE, see
+ * ece391_bench_result.  A pipe throughput test belongs in the list once the
+ * kernel has pipes.
+ */
+
+static const uint8_t* programs[] = {
+    (uint8_t*)"nullcall", (uint8_t*)"rdbench", (uint8_t*)"wrbench", (uint8_t*)"dirbench",
+    (uint8_t*)"execbench", (uint8_t*)"rtcjitter", (uint8_t*)"termbench", 0
+};
+
+static uint8_t results[BUFSIZE + 1];
+
+/* empty the results file, then start it with a header line unless done is set */
+static int32_t
+reset_results (int32_t done)
+{
+    int32_t fd;
+
+    (void)ece391_create ((uint8_t*)ECE391_BENCH_FILE);  /* fails once the file exists */
+    if (-1 == (fd = ece391_open ((uint8_t*)ECE391_BENCH_FILE)))
+        return -1;
+    if (-1 == ece391_truncate (fd, 0) ||
+        (!done && 9 != ece391_write (fd, "benchrun\n", 9))) {
+        (void)ece391_close (fd);
+        return -1;
+    }
+    (void)ece391_close (fd);
+    return 0;
+}
+
+/* 1 if the program is named in the argument list, or the list is empty */
+static int32_t
+wanted (const uint8_t* prog, const uint8_t* args)
+{
+    uint32_t n = ece391_strlen (prog);
+
+    if ('\0' == *args)
+        return 1;
+    while ('\0' != *args) {
+        if (0 == ece391_strncmp (args, prog, n) && (' ' == args[n] || '\0' == args[n]))
+            return 1;
+        while (' ' != *args && '\0' != *args)
+            args++;
+        while (' ' == *args)
+            args++;
+    }
+    return 0;
+}
+
+/* print s and pad it with spaces to width, on the left if right is set */
+static void
+column (const uint8_t* s, uint32_t width, int32_t right)
+{
+    uint32_t n = ece391_strlen (s);
+
+    if (right)
+        for (; n < width; n++)
+            ece391_fdputs (1, (uint8_t*)" ");
+    ece391_write (1, s, ece391_strlen (s));
+    if (!right)
+        for (; n < width; n++)
+            ece391_fdputs (1, (uint8_t*)" ");
+}
+
+int main ()
+{
+    int32_t i, fd, cnt, status, last, len = 0;
+    uint8_t args[BUFSIZE];
+    uint8_t *line, *end, *value, *unit;
+
+    if (0 != ece391_getargs (args, BUFSIZE))
+        args[0] = '\0';
+    if (-1 == reset_results (0)) {
+        ece391_fdputs (1, (uint8_t*)"cannot write " ECE391_BENCH_FILE "\n");
+        return 2;
+    }
+
+    for (i = 0; 0 != programs[i]; i++) {
+        if (!wanted (programs[i], args))
+            continue;
+        ece391_fdputs (1, (uint8_t*)"== ");
+        ece391_fdputs (1, programs[i]);
+        ece391_fdputs (1, (uint8_t*)" ==\n");
+        if (-1 == (status = ece391_execute (programs[i])))
+            ece391_bench_result (programs[i], 0, (uint8_t*)"not found");
+        else if (0 != status)
+            ece391_bench_result (programs[i], status, (uint8_t*)"exit status, failed");
+    }
+
+    if (-1 != (fd = ece391_open ((uint8_t*)ECE391_BENCH_FILE))) {
+        while (len < BUFSIZE && 0 < (cnt = ece391_read (fd, results + len, BUFSIZE - len)))
+            len += cnt;
+        (void)ece391_close (fd);
+    }
+    results[len] = '\0';
+    (void)reset_results (1);
+
+    ece391_fdputs (1, (uint8_t*)"\n");
+    column ((uint8_t*)"benchmark", NAME_COL, 0);
+    column ((uint8_t*)"value", VALUE_COL, 1);
+    ece391_fdputs (1, (uint8_t*)"  unit\n");
+    /* the first line is the header reset_results wrote */
+    for (line = results; '\0' != *line && '\n' != *line; line++);
+    if ('\n' == *line)
+        line++;
+    for (; '\0' != *line; line = end + 1) {
+        for (end = line; '\n' != *end && '\0' != *end; end++);
+        last = ('\0' == *end);
+        *end = '\0';
+        /* "<name> <value> <unit...>" */
+        for (value = line; ' ' != *value && value < end; value++);
+        if (value < end)
+            *value++ = '\0';
+        for (unit = value; ' ' != *unit && unit < end; unit++);
+        if (unit < end)
+            *unit++ = '\0';
+        column (line, NAME_COL, 0);
+        column (value, VALUE_COL, 1);
+        ece391_fdputs (1, (uint8_t*)"  ");
+        ece391_fdputs (1, unit);
+        ece391_fdputs (1, (uint8_t*)"\n");
+        if (last)
+            break;
+    }
+    return 0;
+}
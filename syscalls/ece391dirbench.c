@@ -0,0 +1,69 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define MAX_ENTRIES 64      /* a boot block holds at most 63 names */
+#define ROUNDS 200          /* scans of the root directory */
+
+/*
+ * dirbench           time what ls does: open the root directory, read every
+ *                    entry with getdents and close it, then the same with a
+ *                    stat of every name, the way a listing with sizes looks
+ *                    each file up
+ */
+
+static ece391_dirent_t ents[MAX_ENTRIES];
+
+/* read the whole directory, stat every name if asked; the number of entries, -1 on failure */
+static int32_t
+scan (int32_t with_stat)
+{
+    int32_t fd, cnt, i, n = 0;
+    ece391_stat_t st;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)".")))
+        return -1;
+    while (0 < (cnt = ece391_getdents (fd, ents, sizeof (ents)))) {
+        for (i = 0; i < cnt / (int32_t)sizeof (ece391_dirent_t); i++, n++) {
+            if (with_stat && -1 == ece391_stat (ents[i].name, &st))
+                n = -1;
+        }
+    }
+    (void)ece391_close (fd);
+    return (-1 == cnt || n < 0) ? -1 : n;
+}
+
+/* time ROUNDS scans and print the cycles per scan and per entry */
+static int32_t
+run (int32_t with_stat, const uint8_t* label, const uint8_t* name)
+{
+    int32_t i, n;
+    uint32_t t0, t1, per_scan;
+
+    t0 = ece391_tsc_read ();
+    for (i = 0; i < ROUNDS; i++) {
+        if (-1 == (n = scan (with_stat)))
+            return -1;
+    }
+    t1 = ece391_tsc_read ();
+    per_scan = ((t1 - t0) << ECE391_TSC_SHIFT) / ROUNDS;
+
+    ece391_fdputs (1, label);
+    ece391_fdputnum (1, (uint8_t*)": ", n);
+    ece391_fdputnum (1, (uint8_t*)" entries, cycles per scan ", per_scan);
+    ece391_fdputnum (1, (uint8_t*)", per entry ", per_scan / (n + 1));
+    ece391_fdputs (1, (uint8_t*)"\n");
+    ece391_bench_result (name, per_scan, (uint8_t*)"cycles/scan");
+    return 0;
+}
+
+int main ()
+{
+    if (-1 == run (0, (uint8_t*)"getdents", (uint8_t*)"dir_scan") ||
+        -1 == run (1, (uint8_t*)"getdents and stat", (uint8_t*)"dir_scan_stat")) {
+        ece391_fdputs (1, (uint8_t*)"directory scan failed\n");
+        return 2;
+    }
+    return 0;
+}
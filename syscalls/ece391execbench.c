@@ -0,0 +1,43 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 128
+#define ROUNDS 500          /* execute + halt round trips per run */
+
+int main ()
+{
+    int32_t i, failed;
+    uint32_t t0, t1, tsc_hz;
+    uint8_t buf[BUFSIZE];
+
+    /* the child is this program run with the "child" argument, it just halts */
+    if (0 == ece391_getargs (buf, BUFSIZE) && 0 == ece391_strcmp (buf, (uint8_t*)"child"))
+        return 0;
+
+    if (0 == (tsc_hz = ece391_tsc_hz ())) {
+        ece391_fdputs (1, (uint8_t*)"rtc open failed\n");
+        return 2;
+    }
+
+    failed = 0;
+    t0 = ece391_tsc_read ();
+    for (i = 0; i < ROUNDS; i++) {
+        if (0 != ece391_execute ((uint8_t*)"execbench child"))
+            failed++;
+    }
+    t1 = ece391_tsc_read ();
+    if (t1 == t0)
+        t1++;
+
+    ece391_fdputnum (1, (uint8_t*)"execute/halt round trips: ", ROUNDS);
+    ece391_fdputnum (1, (uint8_t*)", ", failed);
+    ece391_fdputs (1, (uint8_t*)" failed\n");
+    ece391_fdputnum (1, (uint8_t*)"round trips per second: ", ROUNDS * tsc_hz / (t1 - t0));
+    ece391_fdputnum (1, (uint8_t*)"\ncycles per round trip: ", ((t1 - t0) / ROUNDS) << ECE391_TSC_SHIFT);
+    ece391_fdputs (1, (uint8_t*)"\n");
+    ece391_bench_result ((uint8_t*)"execute_halt", ((t1 - t0) / ROUNDS) << ECE391_TSC_SHIFT,
+                         (uint8_t*)"cycles/round trip");
+    return 0;
+}
@@ -6,19 +6,60 @@
 #define BUFSIZE 1024
 #define SBUFSIZE 33
 
+/* search a file mapped with mmap in place, printing with the prepared match vector */
+void
+search_mapped (const char* s, int32_t s_len, const uint8_t* map, int32_t len,
+	       ece391_iovec_t* match)
+{
+    int32_t line_start, line_end, check, out_len;
+
+    for (line_start = 0; line_start < len; line_start = line_end + 1) {
+	line_end = line_start;
+	while (line_end < len && '\n' != map[line_end])
+	    line_end++;
+	for (check = line_start; check + s_len <= line_end; check++) {
+	    if (s[0] == map[check] && 
+		0 == ece391_strncmp ((uint8_t*)(map + check), (uint8_t*)s, s_len)) {
+		/* print up to a NUL, as the copying path does */
+		for (out_len = 0; out_len < line_end - line_start &&
+		     '\0' != map[line_start + out_len]; out_len++);
+		match[2].base = (void*)(map + line_start);
+		match[2].len = out_len;
+		ece391_writev (1, match, 4);
+		break;
+	    }
+	}
+    }
+}
+
 int32_t
 do_one_file (const char* s, const char* fname) 
 {
     int32_t fd, cnt, last, line_start, line_end, check, s_len;
     uint8_t data[BUFSIZE+1];
+    uint8_t* map;
+    ece391_iovec_t match[4];
+
+    /* a match is printed as "fname:line\n" with one writev */
+    match[0].base = (void*)fname;
+    match[0].len = ece391_strlen ((uint8_t*)fname);
+    match[1].base = ":";
+    match[1].len = 1;
+    match[3].base = "\n";
+    match[3].len = 1;
 
     s_len = ece391_strlen ((uint8_t*)s);
     if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
         ece391_fdputs (1, (uint8_t*)"file open failed\n");
         return -1;
     }
+    /* a mapped file is searched without copying it */
+    if (-1 != (cnt = ece391_mmap (fd, &map))) {
+        search_mapped (s, s_len, map, cnt, match);
+        cnt = 0;
+    }
     last = 0;
-    while (1) {
+    while (0 != cnt) {
         cnt = ece391_read (fd, data + last, BUFSIZE - last);
 	if (-1 == cnt) {
             ece391_fdputs (1, (uint8_t*)"file read failed\n");
@@ -42,10 +83,9 @@ do_one_file (const char* s, const char* fname)
 	    for (check = line_start; check < line_end; check++) {
 		if (s[0] == data[check] && 
 		    0 == ece391_strncmp ((uint8_t*)(data + check), (uint8_t*)s, s_len)) {
-		    ece391_fdputs (1, (uint8_t*)fname);
-		    ece391_fdputs (1, (uint8_t*)":");
-		    ece391_fdputs (1, data + line_start);
-		    ece391_fdputs (1, (uint8_t*)"\n");
+		    match[2].base = data + line_start;
+		    match[2].len = ece391_strlen (data + line_start);
+		    ece391_writev (1, match, 4);
 		    break;
 		}
 	    }
@@ -70,6 +110,7 @@ int main ()
     int32_t fd, cnt;
     uint8_t buf[SBUFSIZE];
     uint8_t search[BUFSIZE];
+    ece391_stat_t st;
 
     if (0 != ece391_getargs (search, BUFSIZE)) {
         ece391_fdputs (1, (uint8_t*)"could not read argument\n");
@@ -89,6 +130,9 @@ int main ()
 	if ('.' == buf[0]) /* a directory... */
 	    continue;
 	buf[cnt] = '\0';
+	/* only regular files have lines to search */
+	if (0 == ece391_stat (buf, &st) && ECE391_TYPE_FILE != st.type)
+	    continue;
 	if (0 != do_one_file ((char*)search, (char*)buf))
 	    return 3;
     }
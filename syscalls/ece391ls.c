@@ -3,25 +3,46 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
-#define SBUFSIZE 33
+#define MAX_ENTRIES 64      /* a boot block holds at most 63 names */
+#define NAME_LEN 32
+#define NAME_COL 34         /* column where the type starts */
+#define LINE_LEN 64         /* name, type and size of one entry */
 
 int main ()
 {
-    int32_t fd, cnt;
-    uint8_t buf[SBUFSIZE];
+    int32_t fd, cnt, i, n, out;
+    ece391_dirent_t ents[MAX_ENTRIES];
+    uint8_t text[MAX_ENTRIES * LINE_LEN];
+    uint8_t num[12];
 
     if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
         return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+    /* the whole root fits in ents, so this is normally a single call */
+    while (0 != (cnt = ece391_getdents (fd, ents, sizeof (ents)))) {
         if (-1 == cnt) {
 	        ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	        return 3;
 	    }
-	    buf[cnt] = '\n';
-	    if (-1 == ece391_write (1, buf, cnt + 1))
+	    out = 0;
+	    for (i = 0; i < cnt / (int32_t)sizeof (ece391_dirent_t); i++) {
+	        /* names use all 32 bytes when they are that long */
+	        for (n = 0; n < NAME_LEN && '\0' != ents[i].name[n]; n++)
+	            text[out++] = ents[i].name[n];
+	        for (; n < NAME_COL; n++)
+	            text[out++] = ' ';
+	        ece391_itoa (ents[i].type, num, 10);
+	        for (n = 0; '\0' != num[n]; n++)
+	            text[out++] = num[n];
+	        text[out++] = ' ';
+	        ece391_itoa (ents[i].length, num, 10);
+	        for (n = 0; '\0' != num[n]; n++)
+	            text[out++] = num[n];
+	        text[out++] = '\n';
+	    }
+	    if (-1 == ece391_write (1, text, out))
 	        return 3;
     }
 
@@ -0,0 +1,43 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define CALLS 100000        /* null system calls timed per entry path */
+
+/* time CALLS null system calls through the current entry path */
+static uint32_t
+time_null_calls (void)
+{
+    int32_t i;
+    uint32_t t0, t1;
+
+    t0 = ece391_tsc_read ();
+    for (i = 0; i < CALLS; i++)
+        ece391_null ();
+    t1 = ece391_tsc_read ();
+    return ((t1 - t0) << ECE391_TSC_SHIFT) / CALLS;
+}
+
+int main ()
+{
+    int32_t has_sysenter = ece391_use_sysenter;
+    uint32_t cycles;
+
+    ece391_use_sysenter = 0;
+    cycles = time_null_calls ();
+    ece391_fdputnum (1, (uint8_t*)"int $0x80 cycles per call: ", cycles);
+    ece391_fdputs (1, (uint8_t*)"\n");
+    ece391_bench_result ((uint8_t*)"null_int80", cycles, (uint8_t*)"cycles/call");
+
+    if (!has_sysenter) {
+        ece391_fdputs (1, (uint8_t*)"sysenter not supported\n");
+        return 0;
+    }
+    ece391_use_sysenter = 1;
+    cycles = time_null_calls ();
+    ece391_fdputnum (1, (uint8_t*)"sysenter cycles per call: ", cycles);
+    ece391_fdputs (1, (uint8_t*)"\n");
+    ece391_bench_result ((uint8_t*)"null_sysenter", cycles, (uint8_t*)"cycles/call");
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 128
+#define TOTAL_PROCS 500     /* processes spawned and reaped per run */
+#define BATCH 8             /* children alive at the same time */
+
+int main ()
+{
+    int32_t status, started, reaped, failed;
+    uint32_t t0, t1, tsc_hz;
+    uint8_t buf[BUFSIZE];
+
+    /* children are this program run with the "child" argument, they just halt */
+    if (0 == ece391_getargs (buf, BUFSIZE) && 0 == ece391_strcmp (buf, (uint8_t*)"child"))
+        return 0;
+
+    if (0 == (tsc_hz = ece391_tsc_hz ())) {
+        ece391_fdputs (1, (uint8_t*)"rtc open failed\n");
+        return 2;
+    }
+
+    started = reaped = failed = 0;
+    t0 = ece391_tsc_read ();
+    while (reaped < TOTAL_PROCS) {
+        while (started < TOTAL_PROCS && started - reaped < BATCH) {
+            if (-1 == ece391_spawn ((uint8_t*)"pidstress child"))
+                break;      /* out of pids, reap before trying again */
+            started++;
+        }
+        if (started == reaped) {
+            ece391_fdputs (1, (uint8_t*)"spawn failed\n");
+            return 3;
+        }
+        if (-1 == ece391_waitpid (WAIT_ANY_CHILD, &status, 0)) {
+            ece391_fdputs (1, (uint8_t*)"waitpid failed\n");
+            return 3;
+        }
+        if (0 != status)
+            failed++;
+        reaped++;
+    }
+    t1 = ece391_tsc_read ();
+    if (t1 == t0)
+        t1++;
+
+    ece391_fdputnum (1, (uint8_t*)"spawned and reaped ", reaped);
+    ece391_fdputnum (1, (uint8_t*)" processes, ", failed);
+    ece391_fdputs (1, (uint8_t*)" failed\n");
+    ece391_fdputnum (1, (uint8_t*)"processes per second: ", TOTAL_PROCS * tsc_hz / (t1 - t0));
+    ece391_fdputnum (1, (uint8_t*)"\ncycles per process: ", ((t1 - t0) / TOTAL_PROCS) << ECE391_TSC_SHIFT);
+    ece391_fdputs (1, (uint8_t*)"\n");
+    return 0;
+}
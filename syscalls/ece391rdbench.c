@@ -0,0 +1,41 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define CHUNK 1024          /* the read size of cat's loop */
+#define ROUNDS 50           /* passes over the file */
+
+int main ()
+{
+    int32_t fd, cnt, i;
+    uint32_t t0, t1, bytes, per_kb;
+    uint8_t buf[CHUNK];
+    uint8_t fname[CHUNK];
+
+    /* fish is the largest file in fsdir */
+    if (0 != ece391_getargs (fname, CHUNK) || '\0' == fname[0])
+        ece391_strcpy (fname, (uint8_t*)"fish");
+
+    bytes = 0;
+    t0 = ece391_tsc_read ();
+    for (i = 0; i < ROUNDS; i++) {
+        if (-1 == (fd = ece391_open (fname))) {
+	    ece391_fdputs (1, (uint8_t*)"file not found\n");
+	    return 2;
+	}
+	while (0 < (cnt = ece391_read (fd, buf, CHUNK)))
+	    bytes += cnt;
+	(void)ece391_close (fd);
+    }
+    t1 = ece391_tsc_read ();
+    if (0 == bytes)
+        return 3;
+
+    per_kb = ((t1 - t0) << ECE391_TSC_SHIFT) / (bytes / 1024 + 1);
+    ece391_fdputnum (1, (uint8_t*)"bytes read: ", bytes);
+    ece391_fdputnum (1, (uint8_t*)"\ncycles per KB: ", per_kb);
+    ece391_fdputs (1, (uint8_t*)"\n");
+    ece391_bench_result ((uint8_t*)"file_read", per_kb, (uint8_t*)"cycles/KB");
+    return 0;
+}
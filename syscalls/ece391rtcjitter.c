@@ -0,0 +1,83 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define RATE 1024           /* the fastest rate the rtc driver takes */
+#define TICKS 1024          /* intervals measured, one second */
+#define US_PER_S 1000000
+
+/*
+ * rtcjitter          read the rtc at RATE Hz for a second and show how far
+ *                    the time between wakeups strays from 1/RATE: the mean,
+ *                    shortest and longest interval, the mean deviation from
+ *                    the mean, and how many ticks were missed outright
+ */
+
+static uint32_t gap[TICKS];
+
+/* scaled cycles to microseconds, without overflowing for intervals below a second */
+static uint32_t
+to_us (uint32_t scaled, uint32_t tsc_hz)
+{
+    return scaled * (US_PER_S / 1000) / (tsc_hz / 1000 + 1);
+}
+
+int main ()
+{
+    int32_t fd, rate, garbage, i;
+    uint32_t tsc_hz, t, prev, sum, least, most, mean, dev, missed;
+
+    if (0 == (tsc_hz = ece391_tsc_hz ()) || -1 == (fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"rtc open failed\n");
+        return 2;
+    }
+    rate = RATE;
+    if (-1 == ece391_write (fd, &rate, 4)) {
+        ece391_fdputs (1, (uint8_t*)"rtc rate refused\n");
+        return 2;
+    }
+
+    /* start on a tick so the first interval is a whole one */
+    ece391_read (fd, &garbage, 4);
+    prev = ece391_tsc_read ();
+    for (i = 0; i < TICKS; i++) {
+        ece391_read (fd, &garbage, 4);
+        t = ece391_tsc_read ();
+        gap[i] = t - prev;
+        prev = t;
+    }
+    ece391_close (fd);
+
+    sum = 0;
+    least = 0xFFFFFFFF;
+    most = 0;
+    missed = 0;
+    for (i = 0; i < TICKS; i++) {
+        sum += gap[i];
+        if (gap[i] < least)
+            least = gap[i];
+        if (gap[i] > most)
+            most = gap[i];
+        /* more than one and a half periods means a tick went by unseen */
+        if (gap[i] * RATE * 2 > tsc_hz * 3)
+            missed++;
+    }
+    mean = sum / TICKS;
+    dev = 0;
+    for (i = 0; i < TICKS; i++)
+        dev += (gap[i] > mean) ? gap[i] - mean : mean - gap[i];
+    dev /= TICKS;
+
+    ece391_fdputnum (1, (uint8_t*)"rtc at ", RATE);
+    ece391_fdputnum (1, (uint8_t*)" Hz, period us: expected ", US_PER_S / RATE);
+    ece391_fdputnum (1, (uint8_t*)", mean ", to_us (mean, tsc_hz));
+    ece391_fdputnum (1, (uint8_t*)", min ", to_us (least, tsc_hz));
+    ece391_fdputnum (1, (uint8_t*)", max ", to_us (most, tsc_hz));
+    ece391_fdputnum (1, (uint8_t*)"\njitter (mean deviation) us: ", to_us (dev, tsc_hz));
+    ece391_fdputnum (1, (uint8_t*)", missed ticks: ", missed);
+    ece391_fdputs (1, (uint8_t*)"\n");
+    ece391_bench_result ((uint8_t*)"rtc_jitter", to_us (dev, tsc_hz), (uint8_t*)"us");
+    ece391_bench_result ((uint8_t*)"rtc_max_period", to_us (most, tsc_hz), (uint8_t*)"us");
+    return 0;
+}
@@ -4,14 +4,62 @@
 #include "ece391syscall.h"
 
 #define BUFSIZE 1024
+#define NUMBUFSIZE 12
+#define NAMEBUFSIZE 33
+
+/* Print "[pid] " followed by msg. */
+void
+report_job (int32_t pid, const char* msg)
+{
+    uint8_t num[NUMBUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)"[");
+    ece391_fdputs (1, ece391_itoa (pid, num, 10));
+    ece391_fdputs (1, (uint8_t*)"] ");
+    ece391_fdputs (1, (uint8_t*)msg);
+}
+
+/* Reap every background job that has halted since the last prompt. */
+void
+reap_jobs ()
+{
+    int32_t pid, status;
+
+    while (0 < (pid = ece391_waitpid (WAIT_ANY_CHILD, &status, WAIT_NOHANG))) {
+	if (0 == status)
+	    report_job (pid, "done\n");
+	else
+	    report_job (pid, "exited abnormally\n");
+    }
+}
+
+/* Check that the first word of cmd names a regular file before running it. */
+int32_t
+is_program (const uint8_t* cmd)
+{
+    uint8_t name[NAMEBUFSIZE];
+    ece391_stat_t st;
+    int32_t i;
+
+    while (' ' == *cmd)
+	cmd++;
+    for (i = 0; '\0' != cmd[i] && ' ' != cmd[i]; i++) {
+	if (NAMEBUFSIZE - 1 == i)
+	    return 0;
+	name[i] = cmd[i];
+    }
+    name[i] = '\0';
+    return (0 == ece391_stat (name, &st) && ECE391_TYPE_FILE == st.type);
+}
 
 int main ()
 {
-    int32_t cnt, rval;
+    int32_t cnt, rval, bg;
     uint8_t buf[BUFSIZE];
     ece391_fdputs (1, (uint8_t*)"Starting 391 Shell\n");
 
     while (1) {
+	reap_jobs ();
         ece391_fdputs (1, (uint8_t*)"391OS> ");
 	if (-1 == (cnt = ece391_read (0, buf, BUFSIZE-1))) {
 	    ece391_fdputs (1, (uint8_t*)"read from keyboard failed\n");
@@ -22,8 +70,29 @@ int main ()
 	buf[cnt] = '\0';
 	if (0 == ece391_strcmp (buf, (uint8_t*)"exit"))
 	    return 0;
+	/* a trailing '&' runs the command in the background */
+	bg = 0;
+	while (cnt > 0 && ' ' == buf[cnt - 1])
+	    buf[--cnt] = '\0';
+	if (cnt > 0 && '&' == buf[cnt - 1]) {
+	    bg = 1;
+	    buf[--cnt] = '\0';
+	    while (cnt > 0 && ' ' == buf[cnt - 1])
+		buf[--cnt] = '\0';
+	}
 	if ('\0' == buf[0])
 	    continue;
+	if (!is_program (buf)) {
+	    ece391_fdputs (1, (uint8_t*)"no such command\n");
+	    continue;
+	}
+	if (bg) {
+	    if (-1 == (rval = ece391_spawn (buf)))
+		ece391_fdputs (1, (uint8_t*)"no such command\n");
+	    else
+		report_job (rval, "started\n");
+	    continue;
+	}
 	rval = ece391_execute (buf);
 	if (-1 == rval)
 	    ece391_fdputs (1, (uint8_t*)"no such command\n");
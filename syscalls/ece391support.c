@@ -102,3 +102,74 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+
+/* Read the time stamp counter, scaled down by ECE391_TSC_SHIFT. */
+uint32_t ece391_tsc_read(void)
+{
+    uint32_t lo, hi;
+
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    return (hi << (32 - ECE391_TSC_SHIFT)) | (lo >> ECE391_TSC_SHIFT);
+}
+
+/* Count scaled cycles over one second of RTC ticks. */
+#define TSC_CAL_HZ 16
+uint32_t ece391_tsc_hz(void)
+{
+    int32_t rtc_fd, rate, garbage, i;
+    uint32_t t0, t1;
+
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc")))
+        return 0;
+    rate = TSC_CAL_HZ;
+    ece391_write (rtc_fd, &rate, 4);
+    ece391_read (rtc_fd, &garbage, 4);
+    t0 = ece391_tsc_read ();
+    for (i = 0; i < TSC_CAL_HZ; i++)
+        ece391_read (rtc_fd, &garbage, 4);
+    t1 = ece391_tsc_read ();
+    ece391_close (rtc_fd);
+    return t1 - t0;
+}
+
+/* Print a label followed by a decimal number. */
+void ece391_fdputnum(int32_t fd, const uint8_t* label, uint32_t value)
+{
+    uint8_t num[12];
+
+    ece391_fdputs (fd, label);
+    ece391_fdputs (fd, ece391_itoa (value, num, 10));
+}
+
+/* Append one benchmark figure to ECE391_BENCH_FILE if benchrun started it. */
+#define BENCH_LINE_LEN 128
+void ece391_bench_result(const uint8_t* name, uint32_t value, const uint8_t* unit)
+{
+    int32_t fd, len;
+    ece391_stat_t st;
+    uint8_t line[BENCH_LINE_LEN];
+    uint8_t num[12];
+
+    if (-1 == (fd = ece391_open ((uint8_t*)ECE391_BENCH_FILE)))
+        return;
+    if (-1 == ece391_fstat (fd, &st) || ECE391_TYPE_FILE != st.type || 0 == st.length) {
+        ece391_close (fd);
+        return;
+    }
+    /* there is no seek, reading to the end leaves the position there */
+    while (0 < ece391_read (fd, line, BENCH_LINE_LEN));
+    len = ece391_strlen (name) + ece391_strlen (unit) + 2 * 12;
+    if (len < BENCH_LINE_LEN) {
+        ece391_strcpy (line, name);
+        len = ece391_strlen (line);
+        line[len++] = ' ';
+        ece391_strcpy (line + len, ece391_itoa (value, num, 10));
+        len += ece391_strlen (line + len);
+        line[len++] = ' ';
+        ece391_strcpy (line + len, unit);
+        len += ece391_strlen (line + len);
+        line[len++] = '\n';
+        ece391_write (fd, line, len);
+    }
+    ece391_close (fd);
+}
@@ -9,5 +9,27 @@ extern int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
 extern uint8_t *ece391_strrev(uint8_t* s);
 
+/*
+ * Cycle counter helpers for the benchmark programs.  Counts are shifted
+ * right by ECE391_TSC_SHIFT so that intervals of a few seconds still fit
+ * in 32 bits without pulling in 64-bit division.  ece391_tsc_hz returns
+ * the scaled counts per second, measured against the RTC, or 0 if the RTC
+ * cannot be opened.
+ */
+#define ECE391_TSC_SHIFT 10
+extern uint32_t ece391_tsc_read(void);
+extern uint32_t ece391_tsc_hz(void);
+extern void ece391_fdputnum(int32_t fd, const uint8_t* label, uint32_t value);
+
+/*
+ * Benchmark programs hand their headline figure to ece391_bench_result,
+ * which appends "<name> <value> <unit>" to ECE391_BENCH_FILE.  benchrun
+ * starts that file with a header line and reads it back for its summary
+ * table; while the file is empty or missing nothing is recorded, so the
+ * programs can still be run on their own.
+ */
+#define ECE391_BENCH_FILE "benchres"
+extern void ece391_bench_result(const uint8_t* name, uint32_t value, const uint8_t* unit);
+
 #endif /* ECE391SUPPORT_H */
 
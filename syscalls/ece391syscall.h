@@ -22,6 +22,95 @@ extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 
+/*
+ * spawn starts a program in the background and returns its pid right
+ * away.  waitpid reaps a halted background child (pid -1 for any child)
+ * and returns its pid, 0 if WAIT_NOHANG is given and none has halted yet,
+ * or -1 if the caller has no such child.
+ */
+extern int32_t ece391_spawn (const uint8_t* command);
+extern int32_t ece391_waitpid (int32_t pid, int32_t* status, int32_t options);
+
+#define WAIT_ANY_CHILD -1
+#define WAIT_NOHANG 1
+
+/* null does no work and returns 0, for timing the system call path. */
+extern int32_t ece391_null (void);
+
+/*
+ * readv and writev move several buffers through one file descriptor
+ * with a single system call, and return the total number of bytes.
+ * At most ECE391_IOV_MAX entries are accepted.
+ */
+typedef struct ece391_iovec_t {
+    void* base;
+    int32_t len;
+} ece391_iovec_t;
+
+#define ECE391_IOV_MAX 16
+
+extern int32_t ece391_readv (int32_t fd, const ece391_iovec_t* iov, int32_t iovcnt);
+extern int32_t ece391_writev (int32_t fd, const ece391_iovec_t* iov, int32_t iovcnt);
+
+/*
+ * mmap maps an open regular file read-only into the program's address
+ * space, stores its address in *start and returns its length.  The
+ * mapping stays until the program halts.
+ */
+extern int32_t ece391_mmap (int32_t fd, uint8_t** start);
+
+/*
+ * getdents fills buf with as many directory entries as fit and returns
+ * the number of bytes used, 0 once the directory has been read through.
+ * The length is 0 for entries that are not regular files.
+ */
+typedef struct ece391_dirent_t {
+    uint8_t name[32];
+    uint32_t type;
+    uint32_t inode;
+    uint32_t length;
+} ece391_dirent_t;
+
+extern int32_t ece391_getdents (int32_t fd, void* buf, int32_t nbytes);
+
+/*
+ * stat and fstat report a file's length, type (0 device, 1 directory,
+ * 2 regular file, 3 kernel statistics) and inode, by name or by open
+ * descriptor.  Only regular files have a nonzero length.  The inode of a
+ * device picks it: 0 is rtc, 1 the serial port.
+ */
+typedef struct ece391_stat_t {
+    uint32_t length;
+    uint32_t type;
+    uint32_t inode;
+} ece391_stat_t;
+
+#define ECE391_TYPE_RTC 0
+#define ECE391_TYPE_DEVICE 0
+#define ECE391_DEV_SERIAL 1
+#define ECE391_TYPE_DIR 1
+#define ECE391_TYPE_FILE 2
+#define ECE391_TYPE_PROC 3
+
+extern int32_t ece391_stat (const uint8_t* fname, ece391_stat_t* st);
+extern int32_t ece391_fstat (int32_t fd, ece391_stat_t* st);
+
+/*
+ * create makes an empty regular file.  write on a regular file writes
+ * at the current position and grows the file past its end.  truncate
+ * sets the length of an open file, and fsync writes every changed
+ * block of the filesystem back.
+ */
+extern int32_t ece391_create (const uint8_t* fname);
+extern int32_t ece391_truncate (int32_t fd, int32_t length);
+extern int32_t ece391_fsync (int32_t fd);
+
+/*
+ * Nonzero when the wrappers enter the kernel with SYSENTER rather than
+ * INT $0x80.  Set at startup from CPUID; clear it to force INT $0x80.
+ */
+extern int32_t ece391_use_sysenter;
+
 enum signums {
 	DIV_ZERO = 0,
 	SEGFAULT,
@@ -11,5 +11,17 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_SPAWN   11
+#define SYS_WAITPID 12
+#define SYS_NULL    13
+#define SYS_READV   14
+#define SYS_WRITEV  15
+#define SYS_MMAP    16
+#define SYS_GETDENTS 17
+#define SYS_STAT    18
+#define SYS_FSTAT   19
+#define SYS_CREATE  20
+#define SYS_TRUNCATE 21
+#define SYS_FSYNC   22
 
 #endif /* ECE391SYSNUM_H */
@@ -0,0 +1,121 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 16384       /* the largest report the kernel makes */
+#define BAR_WIDTH 50        /* columns of the longest histogram bar */
+
+/*
+ * sysstat            show the calls, mean and longest latency of every
+ *                    system call, in cycles, from the "syscalls" file
+ * sysstat <call>     draw the latency histogram of one system call
+ * sysstat reset      clear the figures
+ */
+
+static uint8_t report[BUFSIZE + 1];
+
+/* skip to the next token of a line, 0 at the end of the line */
+static uint8_t*
+next_token (uint8_t* s)
+{
+    while (*s != ' ' && *s != '\n' && *s != '\0')
+        s++;
+    while (*s == ' ')
+        s++;
+    return (*s == '\n' || *s == '\0') ? 0 : s;
+}
+
+/* parse a decimal number, stopping at the first other character */
+static uint32_t
+parse_num (uint8_t** s)
+{
+    uint32_t value = 0;
+
+    while (**s >= '0' && **s <= '9') {
+        value = value * 10 + (**s - '0');
+        (*s)++;
+    }
+    return value;
+}
+
+/* draw one line of the report as a histogram */
+static void
+histogram (uint8_t* line)
+{
+    uint8_t *tok, *p;
+    uint8_t bar[BAR_WIDTH + 2];
+    uint32_t i, b, count, most = 0;
+
+    /* the name, calls, mean and max come before the buckets */
+    for (i = 0, tok = line; i < 4 && tok != 0; i++)
+        tok = next_token (tok);
+    for (p = tok; p != 0; p = next_token (p)) {
+        parse_num (&p);
+        p++;
+        count = parse_num (&p);
+        if (count > most)
+            most = count;
+    }
+    if (most == 0) {
+        ece391_fdputs (1, (uint8_t*)"no returned calls\n");
+        return;
+    }
+    for (p = tok; p != 0; p = next_token (p)) {
+        b = parse_num (&p);
+        p++;
+        count = parse_num (&p);
+        ece391_fdputnum (1, (uint8_t*)"2^", b);
+        ece391_fdputs (1, (uint8_t*)(b < 10 ? "  " : " "));
+        for (i = 0; i < (count * BAR_WIDTH + most - 1) / most; i++)
+            bar[i] = '#';
+        bar[i++] = ' ';
+        bar[i] = '\0';
+        ece391_fdputs (1, bar);
+        ece391_fdputnum (1, (uint8_t*)"", count);
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+}
+
+int main ()
+{
+    int32_t fd, cnt, len = 0;
+    uint8_t arg[1024];
+    uint8_t *line, *end;
+    uint32_t n;
+
+    if (0 != ece391_getargs (arg, 1024))
+        arg[0] = '\0';
+    if (-1 == (fd = ece391_open ((uint8_t*)"syscalls"))) {
+        ece391_fdputs (1, (uint8_t*)"no syscalls file\n");
+        return 2;
+    }
+    if (0 == ece391_strcmp (arg, (uint8_t*)"reset")) {
+        ece391_write (fd, "", 0);
+        ece391_close (fd);
+        return 0;
+    }
+
+    /* one read takes a consistent report, keep going in case it is short */
+    while (len < BUFSIZE && 0 < (cnt = ece391_read (fd, report + len, BUFSIZE - len)))
+        len += cnt;
+    ece391_close (fd);
+    report[len] = '\0';
+
+    if (arg[0] == '\0') {
+        ece391_write (1, report, len);
+        return 0;
+    }
+    n = ece391_strlen (arg);
+    for (line = report; *line != '\0'; line = end + 1) {
+        for (end = line; *end != '\n' && *end != '\0'; end++);
+        if (0 == ece391_strncmp (line, arg, n) && line[n] == ' ') {
+            histogram (line);
+            return 0;
+        }
+        if (*end == '\0')
+            break;
+    }
+    ece391_fdputs (1, (uint8_t*)"no such system call\n");
+    return 1;
+}
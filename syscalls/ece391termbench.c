@@ -0,0 +1,43 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define TOTAL (64 * 1024)   /* bytes written to the terminal */
+#define CHUNK 1024          /* bytes per write */
+#define LINE 64             /* characters per line, the newline included */
+
+/*
+ * termbench          write TOTAL bytes of text to the terminal, CHUNK at a
+ *                    time, and show the throughput, scrolling included
+ */
+
+int main ()
+{
+    int32_t i, done;
+    uint32_t tsc_hz, t0, t1, per_kb;
+    uint8_t text[CHUNK];
+
+    if (0 == (tsc_hz = ece391_tsc_hz ())) {
+        ece391_fdputs (1, (uint8_t*)"rtc open failed\n");
+        return 2;
+    }
+    for (i = 0; i < CHUNK; i++)
+        text[i] = ((i + 1) % LINE == 0) ? '\n' : 'a' + i % 26;
+
+    t0 = ece391_tsc_read ();
+    for (done = 0; done < TOTAL; done += CHUNK) {
+        if (CHUNK != ece391_write (1, text, CHUNK))
+            return 3;
+    }
+    t1 = ece391_tsc_read ();
+    if (t1 == t0)
+        t1++;
+    per_kb = ((t1 - t0) << ECE391_TSC_SHIFT) / (TOTAL / 1024);
+
+    ece391_fdputnum (1, (uint8_t*)"terminal KB per second: ", (TOTAL / 1024) * tsc_hz / (t1 - t0));
+    ece391_fdputnum (1, (uint8_t*)", cycles per KB: ", per_kb);
+    ece391_fdputs (1, (uint8_t*)"\n");
+    ece391_bench_result ((uint8_t*)"term_write", per_kb, (uint8_t*)"cycles/KB");
+    return 0;
+}
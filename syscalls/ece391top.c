@@ -0,0 +1,218 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 8192        /* the sched report */
+#define MAX_PIDS 64         /* the kernel's process table ceiling */
+#define NAME_LEN 10
+#define RTC_HZ 2            /* rtc rate, two reads make a one second refresh */
+#define REFRESHES 10        /* refreshes without an argument */
+
+/*
+ * top                show the share of the cpu each process used and spent
+ *                    waiting for it, once a second for REFRESHES seconds
+ * top <n>            refresh n times
+ *
+ * The figures come from the "sched" file; writing to it clears them.
+ */
+
+typedef struct proc_t {
+    int32_t seen;                   /* in the last report */
+    uint8_t name[NAME_LEN];
+    uint32_t tty, switches;
+    uint8_t state[8];
+    uint64_t run, wait, maxlat;
+} proc_t;
+
+static uint8_t report[BUFSIZE + 1];
+static proc_t procs[MAX_PIDS], last[MAX_PIDS];
+static uint64_t now, last_now;
+
+/* skip spaces, then parse a decimal number */
+static uint64_t
+parse_num (uint8_t** s)
+{
+    uint64_t value = 0;
+
+    while (**s == ' ')
+        (*s)++;
+    while (**s >= '0' && **s <= '9') {
+        value = value * 10 + (**s - '0');
+        (*s)++;
+    }
+    return value;
+}
+
+/* skip spaces, then copy a word of at most n - 1 characters */
+static void
+parse_word (uint8_t** s, uint8_t* word, uint32_t n)
+{
+    uint32_t i = 0;
+
+    while (**s == ' ')
+        (*s)++;
+    while (**s != ' ' && **s != '\n' && **s != '\0') {
+        if (i < n - 1)
+            word[i++] = **s;
+        (*s)++;
+    }
+    word[i] = '\0';
+}
+
+/* the next line of the report, 0 after the last one */
+static uint8_t*
+next_line (uint8_t* s)
+{
+    while (*s != '\n' && *s != '\0')
+        s++;
+    return (*s == '\n' && s[1] != '\0') ? s + 1 : 0;
+}
+
+/* read the sched file into procs and now; the report itself, 0 on failure */
+static uint8_t*
+sample (void)
+{
+    int32_t fd, cnt, len = 0;
+    uint32_t pid;
+    uint8_t *line, *p;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"sched")))
+        return 0;
+    while (len < BUFSIZE && 0 < (cnt = ece391_read (fd, report + len, BUFSIZE - len)))
+        len += cnt;
+    ece391_close (fd);
+    report[len] = '\0';
+
+    /* "now <tsc> cpu <pid>", two summary lines, the column names, then a line per process */
+    p = report + 3;
+    now = parse_num (&p);
+    for (pid = 0; pid < MAX_PIDS; pid++)
+        procs[pid].seen = 0;
+    line = next_line (report);
+    line = line ? next_line (line) : 0;
+    line = line ? next_line (line) : 0;
+    for (line = line ? next_line (line) : 0; line != 0; line = next_line (line)) {
+        p = line;
+        pid = parse_num (&p);
+        if (pid >= MAX_PIDS)
+            continue;
+        procs[pid].seen = 1;
+        parse_word (&p, procs[pid].name, NAME_LEN);
+        procs[pid].tty = parse_num (&p);
+        parse_word (&p, procs[pid].state, sizeof (procs[pid].state));
+        procs[pid].switches = parse_num (&p);
+        procs[pid].run = parse_num (&p);
+        procs[pid].wait = parse_num (&p);
+        procs[pid].maxlat = parse_num (&p);
+    }
+    return report;
+}
+
+/* part of whole in percent, whole not 0 and part at most whole */
+static uint32_t
+percent (uint64_t part, uint64_t whole)
+{
+    while (whole >> 24) {
+        whole >>= 1;
+        part >>= 1;
+    }
+    return (whole == 0) ? 0 : (uint32_t)part * 100 / (uint32_t)whole;
+}
+
+/* print a number right aligned in width columns */
+static void
+put_num (uint64_t value, uint32_t width)
+{
+    uint8_t num[12];
+    uint32_t n;
+
+    ece391_itoa ((value >> 32) ? 0xFFFFFFFF : (uint32_t)value, num, 10);
+    for (n = ece391_strlen (num); n < width; n++)
+        ece391_fdputs (1, (uint8_t*)" ");
+    ece391_fdputs (1, num);
+}
+
+/* print a word left aligned in width columns */
+static void
+put_word (const uint8_t* s, uint32_t width)
+{
+    uint32_t n;
+
+    ece391_fdputs (1, s);
+    for (n = ece391_strlen (s); n < width; n++)
+        ece391_fdputs (1, (uint8_t*)" ");
+}
+
+/* one screen: the summary lines of the report, then the changes since the last sample */
+static void
+show (uint8_t* text)
+{
+    uint32_t pid;
+    uint64_t interval = now - last_now;
+    uint8_t *line, *end;
+
+    ece391_fdputs (1, (uint8_t*)"\n");
+    line = next_line (text);
+    end = line ? next_line (line) : 0;
+    end = end ? next_line (end) : 0;
+    if (line != 0 && end != 0)
+        ece391_write (1, line, end - line);
+    ece391_fdputs (1, (uint8_t*)"pid name      tty state    cpu%  wait%  switches      maxlat\n");
+    for (pid = 0; pid < MAX_PIDS; pid++) {
+        if (!procs[pid].seen)
+            continue;
+        put_num (pid, 3);
+        ece391_fdputs (1, (uint8_t*)" ");
+        put_word (procs[pid].name, NAME_LEN);
+        put_num (procs[pid].tty, 3);
+        ece391_fdputs (1, (uint8_t*)" ");
+        put_word (procs[pid].state, 7);
+        /* a pid reused by another program starts again from zero */
+        if (!last[pid].seen || 0 != ece391_strcmp (last[pid].name, procs[pid].name) ||
+            procs[pid].run < last[pid].run || procs[pid].switches < last[pid].switches) {
+            last[pid].run = last[pid].wait = 0;
+            last[pid].switches = 0;
+        }
+        put_num (percent (procs[pid].run - last[pid].run, interval), 5);
+        put_num (percent (procs[pid].wait - last[pid].wait, interval), 7);
+        put_num (procs[pid].switches - last[pid].switches, 10);
+        put_num (procs[pid].maxlat, 12);
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+}
+
+int main ()
+{
+    int32_t rtc_fd, rate, garbage, i, refreshes;
+    uint8_t arg[16];
+    uint8_t *text, *p;
+
+    refreshes = REFRESHES;
+    if (0 == ece391_getargs (arg, 16) && arg[0] != '\0') {
+        p = arg;
+        refreshes = parse_num (&p);
+    }
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"rtc open failed\n");
+        return 2;
+    }
+    rate = RTC_HZ;
+    ece391_write (rtc_fd, &rate, 4);
+    if (0 == sample ()) {
+        ece391_fdputs (1, (uint8_t*)"no sched file\n");
+        return 2;
+    }
+    for (; refreshes > 0; refreshes--) {
+        for (i = 0; i < MAX_PIDS; i++)
+            last[i] = procs[i];
+        last_now = now;
+        for (i = 0; i < RTC_HZ; i++)
+            ece391_read (rtc_fd, &garbage, 4);
+        if (0 == (text = sample ()))
+            return 3;
+        show (text);
+    }
+    ece391_close (rtc_fd);
+    return 0;
+}
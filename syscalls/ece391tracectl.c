@@ -0,0 +1,38 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+
+/*
+ * tracectl           show whether kernel events are recorded and how many
+ * tracectl on|off    start or stop recording
+ * tracectl clear     forget the recorded events
+ * tracectl dump      send the events on COM1, for tracedecode.py
+ */
+
+int main ()
+{
+    int32_t fd, cnt;
+    uint8_t arg[BUFSIZE];
+    uint8_t buf[BUFSIZE];
+
+    if (0 != ece391_getargs (arg, BUFSIZE))
+        arg[0] = '\0';
+    if (-1 == (fd = ece391_open ((uint8_t*)"trace"))) {
+        ece391_fdputs (1, (uint8_t*)"no trace file\n");
+        return 2;
+    }
+    if (arg[0] != '\0') {
+        if (-1 == ece391_write (fd, arg, ece391_strlen (arg))) {
+            ece391_fdputs (1, (uint8_t*)"usage: tracectl [on|off|clear|dump]\n");
+            ece391_close (fd);
+            return 1;
+        }
+    }
+    while (0 < (cnt = ece391_read (fd, buf, BUFSIZE)))
+        ece391_write (1, buf, cnt);
+    ece391_close (fd);
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define FNAME "wrbench.dat"
+#define TOTAL (256 * 1024)  /* bytes written per chunk size */
+#define MAX_CHUNK 4096
+
+/* write TOTAL bytes to a fresh copy of the file in chunks of chunk bytes, then fsync */
+int32_t
+run (int32_t chunk, uint32_t tsc_hz, const uint8_t* data, const uint8_t* name)
+{
+    int32_t fd, done;
+    uint32_t t0, t1, per_kb;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)FNAME)))
+        return -1;
+    if (-1 == ece391_truncate (fd, 0))
+        return -1;
+    t0 = ece391_tsc_read ();
+    for (done = 0; done < TOTAL; done += chunk) {
+        if (chunk != ece391_write (fd, data, chunk)) {
+	    ece391_fdputs (1, (uint8_t*)"write failed, filesystem full?\n");
+	    (void)ece391_close (fd);
+	    return -1;
+	}
+    }
+    if (-1 == ece391_fsync (fd))
+        return -1;
+    t1 = ece391_tsc_read ();
+    if (t1 == t0)
+        t1++;
+    (void)ece391_close (fd);
+
+    per_kb = ((t1 - t0) << ECE391_TSC_SHIFT) / (TOTAL / 1024);
+    ece391_fdputnum (1, (uint8_t*)"chunk ", chunk);
+    ece391_fdputnum (1, (uint8_t*)": KB per second ", (TOTAL / 1024) * tsc_hz / (t1 - t0));
+    ece391_fdputnum (1, (uint8_t*)", cycles per KB ", per_kb);
+    ece391_fdputs (1, (uint8_t*)"\n");
+    ece391_bench_result (name, per_kb, (uint8_t*)"cycles/KB");
+    return 0;
+}
+
+int main ()
+{
+    int32_t i, fd;
+    uint32_t tsc_hz;
+    uint8_t data[MAX_CHUNK];
+
+    if (0 == (tsc_hz = ece391_tsc_hz ())) {
+        ece391_fdputs (1, (uint8_t*)"rtc open failed\n");
+        return 2;
+    }
+    for (i = 0; i < MAX_CHUNK; i++)
+        data[i] = 'a' + i % 26;
+
+    /* the file stays between runs, so create may fail because it exists */
+    (void)ece391_create ((uint8_t*)FNAME);
+    if (-1 == run (64, tsc_hz, data, (uint8_t*)"file_write_64") ||
+        -1 == run (512, tsc_hz, data, (uint8_t*)"file_write_512") ||
+        -1 == run (MAX_CHUNK, tsc_hz, data, (uint8_t*)"file_write_4096")) {
+        ece391_fdputs (1, (uint8_t*)"benchmark failed\n");
+        return 3;
+    }
+
+    /* leave the file empty so its blocks go back to the free map */
+    if (-1 != (fd = ece391_open ((uint8_t*)FNAME))) {
+        (void)ece391_truncate (fd, 0);
+        (void)ece391_fsync (fd);
+        (void)ece391_close (fd);
+    }
+    return 0;
+}
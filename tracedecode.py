@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""Turn a kernel trace dump into a timeline.
+
+The kernel sends its event rings on COM1 when "dump" is written to the trace
+file (tracectl dump) and when it stops on an exception. Capture the port, for
+example with qemu -serial file:com1.log, and give the log to this script. The
+dump is a block of text lines between "TRACE BEGIN" and "TRACE END", anything
+else in the log is skipped; see trace_dump in student-distrib/trace.c.
+"""
+
+import getopt
+import sys
+
+# event types of trace.h
+TRACE_SWITCH = 1
+TRACE_EXECUTE = 2
+TRACE_HALT = 3
+TRACE_IRQ = 4
+TRACE_EXCEPTION = 5
+TRACE_PAGE_FAULT = 6
+TRACE_TERMINAL = 7
+
+TYPE_NAMES = {TRACE_SWITCH: "switch", TRACE_EXECUTE: "execute", TRACE_HALT: "halt",
+              TRACE_IRQ: "irq", TRACE_EXCEPTION: "exception", TRACE_PAGE_FAULT: "page fault",
+              TRACE_TERMINAL: "terminal"}
+IRQ_NAMES = {0: "pit", 1: "keyboard", 4: "com1", 8: "rtc", 14: "ata"}
+
+
+def usage(out):
+    out.write("usage: tracedecode.py [options] <serial log, - for stdin>\n"
+              "  -h, --help         show this message\n"
+              "  -m, --mhz N        cpu clock in MHz, times are shown in microseconds\n"
+              "                     instead of cycles\n"
+              "  -p, --pid N        show only the events made while pid N ran\n"
+              "  -d, --dump N       which dump of the log to decode, 0 for the first,\n"
+              "                     -1 (the default) for the last\n"
+              "  -s, --summary      leave out the timeline, show only the summary\n")
+
+
+def parse_dumps(lines):
+    """Return every dump of the log as (records ever made by cpu, events)."""
+    dumps = []
+    current = None
+    for line in lines:
+        words = line.strip().split()
+        if words[:2] == ["TRACE", "BEGIN"]:
+            current = ({}, [])
+        elif current is None:
+            continue
+        elif words[:2] == ["TRACE", "END"]:
+            dumps.append(current)
+            current = None
+        elif words[:2] == ["TRACE", "CPU"] and len(words) == 4:
+            current[0][int(words[2])] = int(words[3])
+        elif len(words) == 6 and words[0] == "E":
+            try:
+                current[1].append((int(words[2], 16), int(words[1]), int(words[3]),
+                                   int(words[4]), int(words[5], 16)))
+            except ValueError:
+                pass        # a line garbled on the wire
+    return dumps
+
+
+def describe(etype, arg):
+    if etype == TRACE_SWITCH:
+        return "switch to pid %d" % arg
+    if etype == TRACE_EXECUTE:
+        return "execute, new pid %d" % arg
+    if etype == TRACE_HALT:
+        return "halt, status %d" % arg
+    if etype == TRACE_IRQ:
+        return "irq %d (%s)" % (arg, IRQ_NAMES.get(arg, "?"))
+    if etype == TRACE_EXCEPTION:
+        return "exception %d" % arg
+    if etype == TRACE_PAGE_FAULT:
+        return "page fault at 0x%08x" % arg
+    if etype == TRACE_TERMINAL:
+        return "terminal %d" % arg
+    return "type %d, arg 0x%08x" % (etype, arg)
+
+
+def main(argv):
+    mhz = None
+    only_pid = None
+    which = -1
+    summary_only = False
+    try:
+        opts, args = getopt.getopt(argv, "hm:p:d:s", ["help", "mhz=", "pid=", "dump=", "summary"])
+        for opt, val in opts:
+            if opt in ("-h", "--help"):
+                usage(sys.stdout)
+                return 0
+            elif opt in ("-m", "--mhz"):
+                mhz = float(val)
+            elif opt in ("-p", "--pid"):
+                only_pid = int(val)
+            elif opt in ("-d", "--dump"):
+                which = int(val)
+            elif opt in ("-s", "--summary"):
+                summary_only = True
+    except (getopt.GetoptError, ValueError) as err:
+        sys.stderr.write("tracedecode: %s\n" % err)
+        usage(sys.stderr)
+        return 2
+    if len(args) != 1:
+        usage(sys.stderr)
+        return 2
+
+    if args[0] == "-":
+        dumps = parse_dumps(sys.stdin.read().splitlines())
+    else:
+        with open(args[0], errors="replace") as f:
+            dumps = parse_dumps(f.read().splitlines())
+    if not dumps:
+        sys.stderr.write("tracedecode: no complete trace dump in %s\n" % args[0])
+        return 1
+    try:
+        made, events = dumps[which]
+    except IndexError:
+        sys.stderr.write("tracedecode: the log holds %d dumps\n" % len(dumps))
+        return 1
+    events.sort()
+
+    def show(cycles):
+        if mhz:
+            return "%.3f" % (cycles / mhz)
+        return "%d" % cycles
+
+    unit = "us" if mhz else "cycles"
+    out = sys.stdout
+    for cpu in sorted(made):
+        kept = sum(1 for e in events if e[1] == cpu)
+        out.write("cpu %d: %d events recorded, %d in the dump\n" % (cpu, made[cpu], kept))
+    if not events:
+        return 0
+    start = events[0][0]
+
+    if not summary_only:
+        out.write("\n%14s %12s %3s %4s  event  (times in %s)\n" % ("time", "delta", "cpu", "pid", unit))
+        last = {}
+        for tsc, cpu, etype, pid, arg in events:
+            delta = tsc - last.get(cpu, tsc)
+            last[cpu] = tsc
+            if only_pid is not None and pid != only_pid:
+                continue
+            out.write("%14s %12s %3d %4d  %s\n" % (show(tsc - start), show(delta), cpu, pid,
+                                                  describe(etype, arg)))
+
+    # how often each event happened, and how long each pid held a cpu between switches
+    counts = {}
+    running = {}
+    since = {}
+    for tsc, cpu, etype, pid, arg in events:
+        key = TYPE_NAMES.get(etype, "type %d" % etype)
+        if etype == TRACE_IRQ:
+            key = "irq %d (%s)" % (arg, IRQ_NAMES.get(arg, "?"))
+        counts[key] = counts.get(key, 0) + 1
+        if etype == TRACE_SWITCH:
+            if cpu in since:
+                running[pid] = running.get(pid, 0) + tsc - since[cpu]
+            since[cpu] = tsc
+    out.write("\n%-20s %10s\n" % ("event", "count"))
+    for key in sorted(counts):
+        out.write("%-20s %10d\n" % (key, counts[key]))
+    if running:
+        total = sum(running.values())
+        out.write("\n%4s %14s %7s  (time between switches, in %s)\n" % ("pid", "running", "share", unit))
+        for pid in sorted(running):
+            out.write("%4d %14s %6.1f%%\n" % (pid, show(running[pid]), 100.0 * running[pid] / total))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))